@@ -0,0 +1,406 @@
+#include "allocation_accounting.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <sstream>
+#include <vector>
+
+std::atomic<bool> AllocationAccounting::enabled = false;
+
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+//Counters updated from operator new and delete, so they can never allocate themselves.
+struct AtomicAllocationCounters {
+	std::atomic<std::uint64_t> allocations = 0;
+	std::atomic<std::uint64_t> bytes = 0;
+	std::atomic<std::uint64_t> frees = 0;
+	std::atomic<std::int64_t> liveBytes = 0;
+	std::atomic<std::int64_t> peakLiveBytes = 0;
+};
+
+//Written in front of every block, so a free is counted towards where the block was allocated.
+struct BlockHeader {
+	std::uint64_t size;
+	std::uint32_t stage;
+	std::uint32_t extensionId;
+};
+
+struct FileAllocations {
+	std::string assetPath;
+	AllocationCounters counters;
+};
+
+static const int maxExtensionCount = 64;
+static const std::size_t headerSize = std::max(sizeof(BlockHeader), alignof(std::max_align_t));
+static const std::size_t reportedFileCount = 10;
+
+static AtomicAllocationCounters totalCounters;
+//The last slot counts allocations outside every stage.
+static AtomicAllocationCounters allStageCounters[counterStageCount + 1];
+//The first slot counts allocations outside every file.
+static AtomicAllocationCounters allExtensionCounters[maxExtensionCount];
+
+static std::mutex accountingMutex;
+static std::vector<std::string> allExtensionNames;
+//Highest peak first.
+static std::vector<FileAllocations> allTopFiles;
+
+thread_local int localAllocationStage = counterStageCount;
+thread_local int localExtensionId = 0;
+thread_local bool localInFile = false;
+//Net bytes the thread allocated since its file scope began.
+thread_local std::int64_t localFileLiveBytes = 0;
+thread_local std::int64_t localFilePeakBytes = 0;
+thread_local std::uint64_t localFileAllocations = 0;
+thread_local std::uint64_t localFileBytes = 0;
+thread_local std::uint64_t localFileFrees = 0;
+
+static void raisePeak(std::atomic<std::int64_t> & peakLiveBytes, std::int64_t liveBytes) {
+	std::int64_t peak = peakLiveBytes.load(std::memory_order_relaxed);
+	while (liveBytes > peak && !peakLiveBytes.compare_exchange_weak(peak, liveBytes, std::memory_order_relaxed));
+}
+
+static void countAllocation(AtomicAllocationCounters & counters, std::size_t size) {
+	counters.allocations.fetch_add(1, std::memory_order_relaxed);
+	counters.bytes.fetch_add(size, std::memory_order_relaxed);
+	raisePeak(counters.peakLiveBytes, counters.liveBytes.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+static void countFree(AtomicAllocationCounters & counters, std::size_t size) {
+	counters.frees.fetch_add(1, std::memory_order_relaxed);
+	counters.liveBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+static AllocationCounters loadCounters(const AtomicAllocationCounters & counters) {
+	AllocationCounters loaded;
+	loaded.allocations = counters.allocations.load(std::memory_order_relaxed);
+	loaded.bytes = counters.bytes.load(std::memory_order_relaxed);
+	loaded.frees = counters.frees.load(std::memory_order_relaxed);
+	loaded.peakLiveBytes = std::max<std::int64_t>(counters.peakLiveBytes.load(std::memory_order_relaxed), 0);
+	return loaded;
+}
+
+/**
+ * Allocates a block with a header in front of it and counts it towards the current stage, file extension and file.
+ * 
+ * @param size The size asked for.
+ * @param alignment The alignment asked for.
+ * @return The block, or null if there is no memory left.
+ */
+static void * allocateCounted(std::size_t size, std::size_t alignment) {
+	const std::size_t offset = std::max(headerSize, alignment);
+	void * block = nullptr;
+	if (alignment > alignof(std::max_align_t)) {
+#ifdef _WIN32
+		block = _aligned_malloc(offset + size, alignment);
+#else
+		block = std::aligned_alloc(alignment, (offset + size + alignment - 1) / alignment * alignment);
+#endif
+	} else {
+		block = std::malloc(offset + size);
+	}
+	if (block == nullptr) return nullptr;
+
+	BlockHeader * header = reinterpret_cast<BlockHeader *>(static_cast<char *>(block) + offset - sizeof(BlockHeader));
+	header->size = size;
+	header->stage = localAllocationStage;
+	header->extensionId = localExtensionId;
+	countAllocation(totalCounters, size);
+	countAllocation(allStageCounters[localAllocationStage], size);
+	countAllocation(allExtensionCounters[localExtensionId], size);
+	if (localInFile) {
+		localFileAllocations++;
+		localFileBytes += size;
+		localFileLiveBytes += size;
+		localFilePeakBytes = std::max(localFilePeakBytes, localFileLiveBytes);
+	}
+	return static_cast<char *>(block) + offset;
+}
+
+static void freeCounted(void * pointer, std::size_t alignment) {
+	if (pointer == nullptr) return;
+	const std::size_t offset = std::max(headerSize, alignment);
+	const BlockHeader * header = reinterpret_cast<const BlockHeader *>(static_cast<char *>(pointer) - sizeof(BlockHeader));
+	countFree(totalCounters, header->size);
+	countFree(allStageCounters[header->stage], header->size);
+	countFree(allExtensionCounters[header->extensionId], header->size);
+	if (localInFile) {
+		localFileFrees++;
+		localFileLiveBytes -= header->size;
+	}
+	void * block = static_cast<char *>(pointer) - offset;
+#ifdef _WIN32
+	if (alignment > alignof(std::max_align_t)) {
+		_aligned_free(block);
+		return;
+	}
+#endif
+	std::free(block);
+}
+
+static void * allocateOrThrow(std::size_t size, std::size_t alignment) {
+	while (true) {
+		void * pointer = allocateCounted(size, alignment);
+		if (pointer != nullptr) return pointer;
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr) throw std::bad_alloc();
+		handler();
+	}
+}
+
+void * operator new(std::size_t size) {
+	return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void * operator new[](std::size_t size) {
+	return allocateOrThrow(size, alignof(std::max_align_t));
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment) {
+	return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment) {
+	return allocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept {
+	return allocateCounted(size, alignof(std::max_align_t));
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+	return allocateCounted(size, alignof(std::max_align_t));
+}
+
+void * operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return allocateCounted(size, static_cast<std::size_t>(alignment));
+}
+
+void * operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	return allocateCounted(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void * pointer) noexcept {
+	freeCounted(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void * pointer) noexcept {
+	freeCounted(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void * pointer, std::size_t) noexcept {
+	freeCounted(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void * pointer, std::size_t) noexcept {
+	freeCounted(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void * pointer, std::align_val_t alignment) noexcept {
+	freeCounted(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void * pointer, std::align_val_t alignment) noexcept {
+	freeCounted(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void * pointer, std::size_t, std::align_val_t alignment) noexcept {
+	freeCounted(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void * pointer, std::size_t, std::align_val_t alignment) noexcept {
+	freeCounted(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void * pointer, const std::nothrow_t &) noexcept {
+	freeCounted(pointer, alignof(std::max_align_t));
+}
+
+void operator delete[](void * pointer, const std::nothrow_t &) noexcept {
+	freeCounted(pointer, alignof(std::max_align_t));
+}
+
+void operator delete(void * pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	freeCounted(pointer, static_cast<std::size_t>(alignment));
+}
+
+void operator delete[](void * pointer, std::align_val_t alignment, const std::nothrow_t &) noexcept {
+	freeCounted(pointer, static_cast<std::size_t>(alignment));
+}
+#endif
+
+/**
+ * @return If this build counts allocations.
+ */
+const bool AllocationAccounting::isAvailable() {
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * Enables counting allocations by file and writing the report. Stages and extensions are always counted in builds with allocation accounting.
+ */
+void AllocationAccounting::enable() {
+	enabled = true;
+}
+
+/**
+ * @return If the report will be written.
+ */
+const bool AllocationAccounting::isEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Counts allocations of the current thread towards a stage until leaveStage is called.
+ * 
+ * @param stage The stage being entered.
+ * @return The stage allocations were counted towards before, to be given to leaveStage.
+ */
+int AllocationAccounting::enterStage([[maybe_unused]] counterStage stage) {
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+	const int previousStage = localAllocationStage;
+	localAllocationStage = stage;
+	return previousStage;
+#else
+	return counterStageCount;
+#endif
+}
+
+/**
+ * @param previousStage The stage returned by enterStage.
+ */
+void AllocationAccounting::leaveStage([[maybe_unused]] int previousStage) {
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+	localAllocationStage = previousStage;
+#endif
+}
+
+/**
+ * Writes the allocations of every stage and file extension, and the files that needed the most memory at once.
+ * 
+ * @param reportStream The stream the report will be written to. Its formatting is left as it was.
+ */
+void AllocationAccounting::writeReport(std::ostream & reportStream) {
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+	//Copied first, so the report's own allocations are not in it.
+	AllocationCounters total = loadCounters(totalCounters);
+	std::vector<AllocationCounters> allStages;
+	std::vector<AllocationCounters> allExtensions;
+	std::vector<std::string> allNames;
+	std::vector<FileAllocations> allFiles;
+	allStages.reserve(counterStageCount + 1);
+	allExtensions.reserve(maxExtensionCount);
+	for (int stage = 0; stage <= counterStageCount; stage++) allStages.push_back(loadCounters(allStageCounters[stage]));
+	for (int extensionId = 0; extensionId < maxExtensionCount; extensionId++) allExtensions.push_back(loadCounters(allExtensionCounters[extensionId]));
+	{
+		std::lock_guard<std::mutex> lock(accountingMutex);
+		allNames = allExtensionNames;
+		allFiles = allTopFiles;
+	}
+
+	//Formatted on its own stream, so the caller's keeps its flags.
+	std::stringstream reportText;
+	auto toKilobytes = [](std::uint64_t bytes) {
+		return bytes / 1024.0;
+	};
+	auto writeRow = [&](const std::string & name, const AllocationCounters & counters) {
+		reportText << std::left << std::setw(20) << name << std::right << std::setw(14) << counters.allocations
+			<< std::setw(14) << std::fixed << std::setprecision(1) << toKilobytes(counters.bytes)
+			<< std::setw(14) << counters.frees << std::setw(16) << toKilobytes(counters.peakLiveBytes) << '\n';
+	};
+	auto writeHeader = [&](const std::string & name) {
+		reportText << std::left << std::setw(20) << name << std::right << std::setw(14) << "Allocations" << std::setw(14) << "KB"
+			<< std::setw(14) << "Frees" << std::setw(16) << "Peak live KB" << '\n';
+	};
+
+	reportText << "Allocations, counted towards the innermost stage and the file being processed when they were made:\n";
+	writeHeader("Stage");
+	for (int stage = 0; stage <= counterStageCount; stage++) {
+		if (allStages[stage].allocations > 0) writeRow(getCounterStageName(stage), allStages[stage]);
+	}
+	writeRow("total", total);
+
+	writeHeader("File extension");
+	for (int extensionId = 0; extensionId < maxExtensionCount; extensionId++) {
+		if (allExtensions[extensionId].allocations == 0) continue;
+		writeRow(extensionId == 0 ? "no file" : allNames[extensionId - 1], allExtensions[extensionId]);
+	}
+
+	if (!allFiles.empty()) {
+		reportText << "Files with the highest peak memory, net bytes allocated by the thread processing them:\n";
+		reportText << std::setw(16) << "Peak live KB" << std::setw(14) << "Allocations" << std::setw(14) << "KB" << std::setw(14) << "Frees" << "  Asset\n";
+		for (const FileAllocations & file : allFiles) {
+			reportText << std::setw(16) << std::fixed << std::setprecision(1) << toKilobytes(file.counters.peakLiveBytes)
+				<< std::setw(14) << file.counters.allocations << std::setw(14) << toKilobytes(file.counters.bytes)
+				<< std::setw(14) << file.counters.frees << "  " << file.assetPath << '\n';
+		}
+	}
+	reportStream << reportText.str();
+#else
+	reportStream << "Allocations are not counted in this build, build with SBPH_ALLOCATION_ACCOUNTING enabled to count them.\n";
+#endif
+}
+
+AllocationFileScope::AllocationFileScope([[maybe_unused]] const std::string & assetPath) {
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+	if (!AllocationAccounting::isEnabled() || localInFile) return;
+	this->assetPath = assetPath;
+	const std::size_t extensionStart = assetPath.find_last_of("./");
+	const std::string extension = extensionStart != std::string::npos && assetPath[extensionStart] == '.' ? assetPath.substr(extensionStart) : "";
+
+	//Extensions are numbered as they are first seen, once there are too many the rest share an other slot.
+	int extensionId = 0;
+	{
+		std::lock_guard<std::mutex> lock(accountingMutex);
+		auto foundName = std::find(allExtensionNames.begin(), allExtensionNames.end(), extension);
+		if (foundName == allExtensionNames.end()) {
+			const std::string name = allExtensionNames.size() + 2 < maxExtensionCount ? extension : "other";
+			foundName = std::find(allExtensionNames.begin(), allExtensionNames.end(), name);
+			if (foundName == allExtensionNames.end()) {
+				allExtensionNames.push_back(name);
+				foundName = allExtensionNames.end() - 1;
+			}
+		}
+		extensionId = static_cast<int>(foundName - allExtensionNames.begin()) + 1;
+	}
+
+	active = true;
+	previousExtensionId = localExtensionId;
+	localExtensionId = extensionId;
+	localInFile = true;
+	localFileLiveBytes = 0;
+	localFilePeakBytes = 0;
+	localFileAllocations = 0;
+	localFileBytes = 0;
+	localFileFrees = 0;
+#endif
+}
+
+AllocationFileScope::~AllocationFileScope() {
+#ifdef SBPH_ALLOCATION_ACCOUNTING
+	if (!active) return;
+	localInFile = false;
+	localExtensionId = previousExtensionId;
+	FileAllocations file;
+	file.counters.allocations = localFileAllocations;
+	file.counters.bytes = localFileBytes;
+	file.counters.frees = localFileFrees;
+	file.counters.peakLiveBytes = static_cast<std::uint64_t>(localFilePeakBytes);
+
+	std::lock_guard<std::mutex> lock(accountingMutex);
+	if (allTopFiles.size() == reportedFileCount && allTopFiles.back().counters.peakLiveBytes >= file.counters.peakLiveBytes) return;
+	file.assetPath = std::move(assetPath);
+	auto position = std::upper_bound(allTopFiles.begin(), allTopFiles.end(), file, [](const FileAllocations & first, const FileAllocations & second) {
+		return first.counters.peakLiveBytes > second.counters.peakLiveBytes;
+	});
+	allTopFiles.insert(position, std::move(file));
+	if (allTopFiles.size() > reportedFileCount) allTopFiles.pop_back();
+#endif
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include "perf_counters.h"
+
+struct AllocationCounters {
+	std::uint64_t allocations = 0;
+	std::uint64_t bytes = 0;
+	std::uint64_t frees = 0;
+	std::uint64_t peakLiveBytes = 0;
+};
+
+//Counts every allocation made through operator new by pipeline stage, file extension and file, in builds with SBPH_ALLOCATION_ACCOUNTING.
+class AllocationAccounting {
+private:
+	static std::atomic<bool> enabled;
+public:
+	static const bool isAvailable();
+	static void enable();
+	static const bool isEnabled();
+	static int enterStage(counterStage stage);
+	static void leaveStage(int previousStage);
+	static void writeReport(std::ostream & reportStream);
+};
+
+//Counts allocations of the current thread towards a file and its extension from construction to destruction.
+class AllocationFileScope {
+private:
+	std::string assetPath;
+	bool active = false;
+	int previousExtensionId = 0;
+public:
+	AllocationFileScope(const std::string & assetPath);
+	~AllocationFileScope();
+	AllocationFileScope(const AllocationFileScope &) = delete;
+	AllocationFileScope & operator=(const AllocationFileScope &) = delete;
+};
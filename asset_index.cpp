@@ -0,0 +1,136 @@
+#include "asset_index.h"
+
+#include <atomic>
+#include <filesystem>
+#include <iostream>
+#include <unordered_set>
+#include "asset_scheduler.h"
+#include "user_interaction_helper.h"
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+/**
+ * Looks up assets other assets refer to. Assets are loaded the first time they are asked for and kept for the rest of the run.
+ * Safe to use from several threads at once.
+ * 
+ * @param sourceLayers The source layers assets are loaded from.
+ * @param threadCount How many threads item names are indexed with.
+ */
+AssetIndex::AssetIndex(SourceLayers * sourceLayers, int threadCount) : sourceLayers(sourceLayers), threadCount(threadCount > 0 ? threadCount : 1) { }
+
+/**
+ * @param assetPath The asset path, starting with a forward slash.
+ * @return The effective JSON of the asset, null if it does not exist or is not JSON.
+ */
+std::shared_ptr<const json> AssetIndex::fetchAsset(const std::string & assetPath) {
+	{
+		std::lock_guard<std::mutex> lock(documentMutex);
+		auto found = cachedDocuments.find(assetPath);
+		if (found != cachedDocuments.end()) return found->second;
+	}
+
+	//Loaded outside the lock, if two threads load the same asset the first one kept wins.
+	std::shared_ptr<const json> document;
+	try {
+		document = sourceLayers->fetchSourceJson(assetPath, false);
+	} catch (const json::exception & exception) {
+		std::lock_guard<std::mutex> lock(consoleMutex);
+		std::cout << "Referenced asset \"" << assetPath << "\" could not be parsed:\n"
+			<< exception.what() << std::endl;
+	}
+	std::lock_guard<std::mutex> lock(documentMutex);
+	return cachedDocuments.emplace(assetPath, document).first->second;
+}
+
+/**
+ * Resolves a reference the way Starbound does. Absolute asset paths start with a forward slash,
+ * relative ones are relative to the folder of the referring asset and anything else is an item or object name.
+ * Frame and directive suffixes such as ":default" or "?hueshift=10" are ignored.
+ * 
+ * @param reference The reference value.
+ * @param fromAssetPath The asset path of the referring asset.
+ * @return The effective JSON of the referenced asset, null if it could not be found.
+ */
+std::shared_ptr<const json> AssetIndex::resolveReference(const std::string & reference, const std::string & fromAssetPath) {
+	std::string assetPath = reference.substr(0, reference.find_first_of(":?"));
+	if (assetPath.empty()) return nullptr;
+	if (!assetPath.starts_with('/')) {
+		if (fs::path(assetPath).has_extension()) {
+			assetPath = fs::path(fromAssetPath).parent_path().generic_string() + '/' + assetPath;
+		} else {
+			assetPath = findItemAssetPath(assetPath);
+			if (assetPath.empty()) return nullptr;
+		}
+	}
+	return fetchAsset(assetPath);
+}
+
+/**
+ * @param itemName An item or object name.
+ * @return The asset path of the item, empty if there is no such item.
+ */
+std::string AssetIndex::findItemAssetPath(const std::string & itemName) {
+	std::call_once(itemNamesIndexed, &AssetIndex::indexItemNames, this);
+	auto found = assetPathsByItemName.find(itemName);
+	return found != assetPathsByItemName.end() ? found->second : "";
+}
+
+/**
+ * Reads the name of every item and object. Only done once, the first time a name is looked up.
+ */
+void AssetIndex::indexItemNames() {
+	static const std::unordered_set<std::string> allItemExtensions = {
+		".activeitem", ".augment", ".back", ".beamaxe", ".chest", ".codex", ".consumable", ".currency",
+		".flashlight", ".harvestingtool", ".head", ".inspectiontool", ".instrument", ".item", ".legs",
+		".liqitem", ".matitem", ".miningtool", ".object", ".painttool", ".thrownitem", ".tillingtool", ".unlock", ".wiretool"
+	};
+
+	std::mutex indexMutex;
+	AssetScheduler scheduler = AssetScheduler(threadCount, 0);
+	sourceLayers->forEachAsset(threadCount, allItemExtensions, nullptr, [&](const std::string & assetPath) {
+		scheduler.submit(0, [&, assetPath]() {
+			std::shared_ptr<const json> document;
+			try {
+				document = sourceLayers->fetchSourceJson(assetPath, false);
+			} catch (const json::exception &) {
+				return;
+			}
+			if (!document || !document->is_object()) return;
+			for (const std::string nameKey : {"itemName", "objectName"}) {
+				auto name = document->find(nameKey);
+				if (name != document->end() && name->is_string()) {
+					std::lock_guard<std::mutex> lock(indexMutex);
+					auto [indexed, added] = assetPathsByItemName.emplace(name->get<std::string>(), assetPath);
+					//Names defined more than once resolve to the highest priority layer, then the first asset path, however the threads were scheduled.
+					if (!added) {
+						const int indexedLayer = sourceLayers->findAssetLayer(indexed->second);
+						const int assetLayer = sourceLayers->findAssetLayer(assetPath);
+						if (assetLayer > indexedLayer || (assetLayer == indexedLayer && assetPath < indexed->second)) indexed->second = assetPath;
+					}
+					return;
+				}
+			}
+		});
+	});
+	scheduler.finish();
+}
+
+/**
+ * Forgets a loaded asset so it is loaded again when next referenced. Item names stay indexed.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ */
+void AssetIndex::invalidate(const std::string & assetPath) {
+	std::lock_guard<std::mutex> lock(documentMutex);
+	cachedDocuments.erase(assetPath);
+}
+
+/**
+ * Forgets every loaded asset.
+ */
+void AssetIndex::invalidateAll() {
+	std::lock_guard<std::mutex> lock(documentMutex);
+	cachedDocuments.clear();
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+#include "source_layers.h"
+
+class AssetIndex {
+private:
+	SourceLayers * sourceLayers = nullptr;
+	int threadCount = 1;
+	std::unordered_map<std::string, std::shared_ptr<const nlohmann::json>> cachedDocuments;
+	std::mutex documentMutex;
+	std::unordered_map<std::string, std::string> assetPathsByItemName;
+	std::once_flag itemNamesIndexed;
+
+	void indexItemNames();
+public:
+	AssetIndex(SourceLayers * sourceLayers, int threadCount);
+	std::shared_ptr<const nlohmann::json> fetchAsset(const std::string & assetPath);
+	std::shared_ptr<const nlohmann::json> resolveReference(const std::string & reference, const std::string & fromAssetPath);
+	std::string findItemAssetPath(const std::string & itemName);
+	void invalidate(const std::string & assetPath);
+	void invalidateAll();
+};
@@ -0,0 +1,145 @@
+#include "asset_path_filter.h"
+#include "shard_summary.h"
+
+AssetPathFilter::AssetPathFilter() { }
+
+/**
+ * Compiles glob patterns matched against asset paths, such as "/objects/wired" or "*.object".
+ * "*" and "?" match within a single folder name and "**" matches any number of folders.
+ * Patterns not starting with a forward slash match at any depth. Matching a folder matches everything in it.
+ * 
+ * @param includePatterns Only assets matching one of these are used. Empty to use every asset.
+ * @param excludePatterns Assets matching any of these are never used.
+ */
+AssetPathFilter::AssetPathFilter(const std::vector<std::string> & includePatterns, const std::vector<std::string> & excludePatterns) {
+	for (const std::string & pattern : includePatterns) allIncludePatterns.push_back(compilePattern(pattern));
+	for (const std::string & pattern : excludePatterns) allExcludePatterns.push_back(compilePattern(pattern));
+}
+
+/**
+ * @return If every asset is used.
+ */
+const bool AssetPathFilter::isEmpty() {
+	return allIncludePatterns.empty() && allExcludePatterns.empty() && shardCount <= 1;
+}
+
+/**
+ * @param assetPath The asset path of a file, starting with a forward slash.
+ * @return If the file should be used.
+ */
+const bool AssetPathFilter::matchesFile(const std::string & assetPath) {
+	if (isEmpty()) return true;
+	if (shardCount > 1 && getAssetShard(assetPath, shardCount) != shardIndex) return false;
+	const std::vector<std::string> path = splitAssetPath(assetPath);
+	for (const std::vector<std::string> & pattern : allExcludePatterns) {
+		if (matchesPathOrParent(pattern, 0, path, 0)) return false;
+	}
+	if (allIncludePatterns.empty()) return true;
+	for (const std::vector<std::string> & pattern : allIncludePatterns) {
+		if (matchesPathOrParent(pattern, 0, path, 0)) return true;
+	}
+	return false;
+}
+
+/**
+ * Checks if a folder could contain any file that should be used, so folders that can not are never read.
+ * 
+ * @param assetPath The asset path of a folder, starting with a forward slash.
+ * @return If the folder should be read.
+ */
+const bool AssetPathFilter::mayMatchFolder(const std::string & assetPath) {
+	if (isEmpty()) return true;
+	const std::vector<std::string> path = splitAssetPath(assetPath);
+	for (const std::vector<std::string> & pattern : allExcludePatterns) {
+		if (matchesPathOrParent(pattern, 0, path, 0)) return false;
+	}
+	if (allIncludePatterns.empty()) return true;
+	for (const std::vector<std::string> & pattern : allIncludePatterns) {
+		if (mayMatchBelow(pattern, 0, path, 0)) return true;
+	}
+	return false;
+}
+
+std::vector<std::string> AssetPathFilter::compilePattern(std::string pattern) {
+	for (char & character : pattern) {
+		if (character == '\\') character = '/';
+	}
+	if (!pattern.starts_with('/')) pattern = "/**/" + pattern;
+	return splitAssetPath(pattern);
+}
+
+std::vector<std::string> AssetPathFilter::splitAssetPath(const std::string & assetPath) {
+	std::vector<std::string> allSegments;
+	std::size_t segmentStart = 0;
+	while (segmentStart <= assetPath.length()) {
+		std::size_t segmentEnd = assetPath.find('/', segmentStart);
+		if (segmentEnd == std::string::npos) segmentEnd = assetPath.length();
+		if (segmentEnd > segmentStart) allSegments.push_back(assetPath.substr(segmentStart, segmentEnd - segmentStart));
+		segmentStart = segmentEnd + 1;
+	}
+	return allSegments;
+}
+
+/**
+ * @param patternSegment A folder or file name that may contain "*" and "?".
+ * @param pathSegment A folder or file name.
+ * @return If the name matches.
+ */
+bool AssetPathFilter::matchesSegment(const std::string & patternSegment, const std::string & pathSegment) {
+	std::size_t patternIndex = 0, pathIndex = 0;
+	std::size_t starIndex = std::string::npos, starPathIndex = 0;
+	while (pathIndex < pathSegment.length()) {
+		if (patternIndex < patternSegment.length() && (patternSegment[patternIndex] == '?' || patternSegment[patternIndex] == pathSegment[pathIndex])) {
+			patternIndex++;
+			pathIndex++;
+		} else if (patternIndex < patternSegment.length() && patternSegment[patternIndex] == '*') {
+			//Remember the star and let it match nothing for now.
+			starIndex = patternIndex++;
+			starPathIndex = pathIndex;
+		} else if (starIndex != std::string::npos) {
+			//Let the last star match one more character.
+			patternIndex = starIndex + 1;
+			pathIndex = ++starPathIndex;
+		} else {
+			return false;
+		}
+	}
+	while (patternIndex < patternSegment.length() && patternSegment[patternIndex] == '*') patternIndex++;
+	return patternIndex == patternSegment.length();
+}
+
+/**
+ * @return If the pattern matches the path or one of the folders it is in.
+ */
+bool AssetPathFilter::matchesPathOrParent(const std::vector<std::string> & pattern, std::size_t patternIndex, const std::vector<std::string> & path, std::size_t pathIndex) {
+	if (patternIndex == pattern.size()) return true;
+	if (pattern[patternIndex] == "**") {
+		return matchesPathOrParent(pattern, patternIndex + 1, path, pathIndex) || (pathIndex < path.size() && matchesPathOrParent(pattern, patternIndex, path, pathIndex + 1));
+	}
+	if (pathIndex == path.size()) return false;
+	return matchesSegment(pattern[patternIndex], path[pathIndex]) && matchesPathOrParent(pattern, patternIndex + 1, path, pathIndex + 1);
+}
+
+/**
+ * @return If the pattern could match the folder, something in it or one of the folders it is in.
+ */
+bool AssetPathFilter::mayMatchBelow(const std::vector<std::string> & pattern, std::size_t patternIndex, const std::vector<std::string> & path, std::size_t pathIndex) {
+	if (patternIndex == pattern.size() || pathIndex == path.size()) return true;
+	if (pattern[patternIndex] == "**") {
+		return mayMatchBelow(pattern, patternIndex + 1, path, pathIndex) || mayMatchBelow(pattern, patternIndex, path, pathIndex + 1);
+	}
+	return matchesSegment(pattern[patternIndex], path[pathIndex]) && mayMatchBelow(pattern, patternIndex + 1, path, pathIndex + 1);
+}
+
+//Setters
+
+/**
+ * Only uses the files of one shard, found from a hash of their asset path. Folders are never ruled out by the shard.
+ * 
+ * @param index Which shard to use, from 1 to the shard count.
+ * @param count How many shards the files are split into, 1 to use every file.
+ */
+void AssetPathFilter::setShard(int index, int count) {
+	shardIndex = index;
+	shardCount = count;
+}
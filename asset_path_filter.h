@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+class AssetPathFilter {
+private:
+	std::vector<std::vector<std::string>> allIncludePatterns;
+	std::vector<std::vector<std::string>> allExcludePatterns;
+	int shardIndex = 1;
+	int shardCount = 1;
+
+	static std::vector<std::string> compilePattern(std::string pattern);
+	static std::vector<std::string> splitAssetPath(const std::string & assetPath);
+	static bool matchesSegment(const std::string & patternSegment, const std::string & pathSegment);
+	static bool matchesPathOrParent(const std::vector<std::string> & pattern, std::size_t patternIndex, const std::vector<std::string> & path, std::size_t pathIndex);
+	static bool mayMatchBelow(const std::vector<std::string> & pattern, std::size_t patternIndex, const std::vector<std::string> & path, std::size_t pathIndex);
+public:
+	AssetPathFilter();
+	AssetPathFilter(const std::vector<std::string> & includePatterns, const std::vector<std::string> & excludePatterns);
+	const bool isEmpty();
+	const bool matchesFile(const std::string & assetPath);
+	const bool mayMatchFolder(const std::string & assetPath);
+	//Setters
+	void setShard(int index, int count);
+};
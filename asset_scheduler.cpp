@@ -0,0 +1,181 @@
+#include "asset_scheduler.h"
+
+#include <string>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+/**
+ * @param workerCount How many assets may be processed at once, 0 or less to use every hardware thread.
+ * @param memoryBudget How many estimated bytes may be in flight at once, 0 for no limit.
+ */
+AssetScheduler::AssetScheduler(int workerCount, std::uint64_t memoryBudget) : memoryBudget(memoryBudget) {
+	workerCount = resolveWorkerCount(workerCount);
+	//Keep enough work queued to stay busy without holding the whole asset tree.
+	maxPendingTasks = workerCount * 64;
+	for (int i = 0; i < workerCount; i++) {
+		workers.emplace_back(&AssetScheduler::runWorker, this);
+	}
+}
+
+AssetScheduler::~AssetScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(schedulerMutex);
+		finishing = true;
+	}
+	stateChanged.notify_all();
+	for (std::thread & worker : workers) {
+		if (worker.joinable()) worker.join();
+	}
+}
+
+/**
+ * Queues an asset to be processed. Blocks while the queue is full.
+ * 
+ * @param estimatedBytes The estimated peak memory use of the work.
+ * @param work The work to do.
+ */
+void AssetScheduler::submit(std::uint64_t estimatedBytes, std::function<void()> work) {
+	std::unique_lock<std::mutex> lock(schedulerMutex);
+	stateChanged.wait(lock, [this] { return pendingTasks.size() < maxPendingTasks; });
+	pendingTasks.push_back({estimatedBytes, std::move(work)});
+	lock.unlock();
+	stateChanged.notify_all();
+}
+
+/**
+ * Waits for every queued asset to be processed and stops the workers.
+ * Rethrows the first exception thrown by any work.
+ */
+void AssetScheduler::finish() {
+	{
+		std::lock_guard<std::mutex> lock(schedulerMutex);
+		finishing = true;
+	}
+	stateChanged.notify_all();
+	for (std::thread & worker : workers) {
+		if (worker.joinable()) worker.join();
+	}
+	if (firstException) std::rethrow_exception(firstException);
+}
+
+void AssetScheduler::runWorker() {
+	while (true) {
+		ScheduledTask task;
+		{
+			std::unique_lock<std::mutex> lock(schedulerMutex);
+			stateChanged.wait(lock, [this, &task] {
+				return takeAdmissibleTask(task) || (finishing && pendingTasks.empty());
+			});
+			if (!task.work) return;
+		}
+		stateChanged.notify_all();
+
+		try {
+			task.work();
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(schedulerMutex);
+			if (!firstException) firstException = std::current_exception();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(schedulerMutex);
+			inFlightTasks--;
+			if (isOversized(task.estimatedBytes)) {
+				exclusiveTaskRunning = false;
+			} else {
+				inFlightBytes -= task.estimatedBytes;
+			}
+		}
+		stateChanged.notify_all();
+	}
+}
+
+/**
+ * Takes the first pending task that fits in the memory budget. Must be called with the lock held.
+ * Oversized tasks wait for every other task to finish and then run alone.
+ * Smaller tasks may skip ahead of tasks that do not fit yet, but never ahead of an oversized task.
+ * 
+ * @param task Set to the admitted task.
+ * @return If a task was admitted.
+ */
+bool AssetScheduler::takeAdmissibleTask(ScheduledTask & task) {
+	if (exclusiveTaskRunning) return false;
+	for (auto pending = pendingTasks.begin(); pending != pendingTasks.end(); ++pending) {
+		if (isOversized(pending->estimatedBytes)) {
+			if (inFlightTasks > 0) return false;
+			exclusiveTaskRunning = true;
+		} else if (memoryBudget > 0 && inFlightBytes + pending->estimatedBytes > memoryBudget) {
+			continue;
+		} else {
+			inFlightBytes += pending->estimatedBytes;
+		}
+		inFlightTasks++;
+		task = std::move(*pending);
+		pendingTasks.erase(pending);
+		return true;
+	}
+	return false;
+}
+
+/**
+ * @param estimatedBytes The estimated peak memory use of a task.
+ * @return If the task can not fit in the budget alongside anything else.
+ */
+const bool AssetScheduler::isOversized(std::uint64_t estimatedBytes) {
+	return memoryBudget > 0 && estimatedBytes > memoryBudget;
+}
+
+/**
+ * Estimates the peak memory used while processing an asset. Without a memory budget the estimate is
+ * never used, so the file is not stat'ed and 0 is returned.
+ * 
+ * @param filePath The path of the asset.
+ * @return The estimated peak memory use in bytes.
+ */
+std::uint64_t AssetScheduler::estimateFootprint(const fs::path & filePath) {
+	if (memoryBudget == 0) return 0;
+	std::error_code error;
+	const std::uintmax_t fileSize = fs::file_size(filePath, error);
+	return error ? 0 : estimateFootprint(filePath, fileSize);
+}
+
+/**
+ * Estimates the peak memory used while processing an asset. The raw text and its stripped copy
+ * are held alongside the parsed document, which is several times larger than the text.
+ * 
+ * @param filePath The path of the asset.
+ * @param fileSize The size of the asset on disk in bytes.
+ * @return The estimated peak memory use in bytes.
+ */
+std::uint64_t AssetScheduler::estimateFootprint(const fs::path & filePath, std::uintmax_t fileSize) {
+	//Parsed size relative to text size. Number heavy assets such as dungeon maps expand the most.
+	static const std::unordered_map<std::string, std::uint64_t> expansionByExtension = {
+		{".dungeon", 24},
+		{".json", 24},
+		{".biome", 16},
+		{".treasurepools", 16},
+		{".terrain", 16},
+		{".config", 12},
+		{".codex", 8},
+		{".patch", 8}
+	};
+	const std::uint64_t defaultExpansion = 12;
+	//Raw text and comment stripped copy.
+	const std::uint64_t textCopies = 2;
+
+	std::uint64_t expansion = defaultExpansion;
+	auto found = expansionByExtension.find(filePath.extension().string());
+	if (found != expansionByExtension.end()) expansion = found->second;
+	return fileSize * (expansion + textCopies);
+}
+
+/**
+ * @param workerCount A configured worker count, 0 or less for automatic.
+ * @return How many workers should be used.
+ */
+int AssetScheduler::resolveWorkerCount(int workerCount) {
+	if (workerCount > 0) return workerCount;
+	const int hardwareThreads = std::thread::hardware_concurrency();
+	return hardwareThreads > 0 ? hardwareThreads : 1;
+}
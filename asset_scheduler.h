@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct ScheduledTask {
+	std::uint64_t estimatedBytes = 0;
+	std::function<void()> work;
+};
+
+class AssetScheduler {
+private:
+	std::uint64_t memoryBudget = 0;
+	std::size_t maxPendingTasks = 0;
+	std::vector<std::thread> workers;
+	std::deque<ScheduledTask> pendingTasks;
+	std::mutex schedulerMutex;
+	std::condition_variable stateChanged;
+	std::uint64_t inFlightBytes = 0;
+	int inFlightTasks = 0;
+	bool exclusiveTaskRunning = false;
+	bool finishing = false;
+	std::exception_ptr firstException;
+
+	void runWorker();
+	bool takeAdmissibleTask(ScheduledTask & task);
+	const bool isOversized(std::uint64_t estimatedBytes);
+public:
+	AssetScheduler(int workerCount, std::uint64_t memoryBudget);
+	AssetScheduler(const AssetScheduler &) = delete;
+	AssetScheduler & operator=(const AssetScheduler &) = delete;
+	~AssetScheduler();
+	void submit(std::uint64_t estimatedBytes, std::function<void()> work);
+	void finish();
+	std::uint64_t estimateFootprint(const std::filesystem::path & filePath);
+	static std::uint64_t estimateFootprint(const std::filesystem::path & filePath, std::uintmax_t fileSize);
+	static int resolveWorkerCount(int workerCount);
+};
@@ -0,0 +1,156 @@
+#include "config_profiler.h"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+//Counters are kept per thread and only merged when the report is written.
+struct ThreadProfile {
+	std::vector<PointerProfile> allPointerProfiles[profileStageCount];
+};
+
+struct RegisteredPointer {
+	std::string configName;
+	std::string path;
+};
+
+std::atomic<bool> ConfigProfiler::enabled = false;
+
+static std::mutex profilerMutex;
+static std::vector<RegisteredPointer> allRegisteredPointers;
+static std::vector<std::unique_ptr<ThreadProfile>> allThreadProfiles;
+thread_local ThreadProfile * localThreadProfile = nullptr;
+
+/**
+ * Enables profiling for the rest of the run.
+ */
+void ConfigProfiler::enable() {
+	enabled = true;
+}
+
+/**
+ * @return If profiling is enabled.
+ */
+const bool ConfigProfiler::isEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Registers a configured pointer so its counters can be reported. Should be called before any work starts.
+ * 
+ * @param configName The parse target config the pointer is from.
+ * @param path The configured path of the pointer, before iterator markers are replaced.
+ * @return The id counters for the pointer are recorded under.
+ */
+int ConfigProfiler::registerPointer(const std::string configName, const std::string path) {
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	allRegisteredPointers.push_back({configName, path});
+	return allRegisteredPointers.size() - 1;
+}
+
+PointerProfile & ConfigProfiler::fetchLocalProfile(profileStage stage, int profileId) {
+	if (localThreadProfile == nullptr) {
+		std::unique_ptr<ThreadProfile> threadProfile = std::make_unique<ThreadProfile>();
+		localThreadProfile = threadProfile.get();
+		std::lock_guard<std::mutex> lock(profilerMutex);
+		allThreadProfiles.push_back(std::move(threadProfile));
+	}
+	std::vector<PointerProfile> & allPointerProfiles = localThreadProfile->allPointerProfiles[stage];
+	if (static_cast<std::size_t>(profileId) >= allPointerProfiles.size()) allPointerProfiles.resize(profileId + 1);
+	return allPointerProfiles[profileId];
+}
+
+/**
+ * Records a pointer being evaluated against one file.
+ * 
+ * @param stage The stage the file was processed in.
+ * @param profileId The id of the configured pointer.
+ * @param duration How long evaluating the pointer took, including iterator expansions.
+ */
+void ConfigProfiler::recordVisit(profileStage stage, int profileId, std::chrono::steady_clock::duration duration) {
+	if (profileId < 0) return;
+	PointerProfile & profile = fetchLocalProfile(stage, profileId);
+	profile.filesVisited++;
+	profile.nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+}
+
+/**
+ * Records a single pointer lookup.
+ * 
+ * @param stage The stage the lookup happened in.
+ * @param profileId The id of the configured pointer.
+ * @param hit If the pointer matched a value.
+ */
+void ConfigProfiler::recordLookup(profileStage stage, int profileId, bool hit) {
+	if (profileId < 0) return;
+	PointerProfile & profile = fetchLocalProfile(stage, profileId);
+	if (hit) {
+		profile.hits++;
+	} else {
+		profile.misses++;
+	}
+}
+
+/**
+ * Records a numeric iterator marker being replaced with an index.
+ * 
+ * @param stage The stage the expansion happened in.
+ * @param profileId The id of the configured pointer.
+ */
+void ConfigProfiler::recordExpansion(profileStage stage, int profileId) {
+	if (profileId < 0) return;
+	fetchLocalProfile(stage, profileId).iteratorExpansions++;
+}
+
+/**
+ * Merges the counters of every thread and writes them as a table grouped by config.
+ * 
+ * @param reportStream The stream the report will be written to. Its formatting is left as it was.
+ */
+void ConfigProfiler::writeReport(std::ostream & reportStream) {
+	std::lock_guard<std::mutex> lock(profilerMutex);
+	//Numbers are formatted in a stream of the report's own.
+	std::stringstream reportText;
+	const std::string stageNames[profileStageCount] = {"parse", "makepatches"};
+
+	for (int stage = 0; stage < profileStageCount; stage++) {
+		//Merge every thread.
+		std::vector<PointerProfile> mergedProfiles(allRegisteredPointers.size());
+		bool anyVisits = false;
+		for (const std::unique_ptr<ThreadProfile> & threadProfile : allThreadProfiles) {
+			const std::vector<PointerProfile> & allPointerProfiles = threadProfile->allPointerProfiles[stage];
+			for (std::size_t id = 0; id < allPointerProfiles.size(); id++) {
+				mergedProfiles[id].filesVisited += allPointerProfiles[id].filesVisited;
+				mergedProfiles[id].hits += allPointerProfiles[id].hits;
+				mergedProfiles[id].misses += allPointerProfiles[id].misses;
+				mergedProfiles[id].iteratorExpansions += allPointerProfiles[id].iteratorExpansions;
+				mergedProfiles[id].nanoseconds += allPointerProfiles[id].nanoseconds;
+				if (allPointerProfiles[id].filesVisited > 0) anyVisits = true;
+			}
+		}
+		if (!anyVisits) continue;
+
+		reportText << "Config profile for " << stageNames[stage] << ":\n";
+		std::string currentConfigName;
+		for (std::size_t id = 0; id < allRegisteredPointers.size(); id++) {
+			const PointerProfile & profile = mergedProfiles[id];
+			if (profile.filesVisited == 0) continue;
+			if (allRegisteredPointers[id].configName != currentConfigName) {
+				currentConfigName = allRegisteredPointers[id].configName;
+				reportText << currentConfigName << '\n'
+					<< std::setw(10) << "Files" << std::setw(10) << "Hits" << std::setw(10) << "Misses"
+					<< std::setw(8) << "Hit %" << std::setw(12) << "Expansions" << std::setw(12) << "Time ms" << "  Path\n";
+			}
+			const std::uint64_t lookups = profile.hits + profile.misses;
+			const double hitRate = lookups > 0 ? 100.0 * profile.hits / lookups : 0.0;
+			reportText << std::setw(10) << profile.filesVisited << std::setw(10) << profile.hits << std::setw(10) << profile.misses
+				<< std::setw(8) << std::fixed << std::setprecision(1) << hitRate
+				<< std::setw(12) << profile.iteratorExpansions
+				<< std::setw(12) << std::setprecision(3) << profile.nanoseconds / 1000000.0
+				<< "  " << allRegisteredPointers[id].path << '\n';
+		}
+	}
+	reportStream << reportText.str();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum profileStage {
+	parseStage,
+	patchStage,
+	profileStageCount
+};
+
+struct PointerProfile {
+	std::uint64_t filesVisited = 0;
+	std::uint64_t hits = 0;
+	std::uint64_t misses = 0;
+	std::uint64_t iteratorExpansions = 0;
+	std::uint64_t nanoseconds = 0;
+};
+
+class ConfigProfiler {
+private:
+	static std::atomic<bool> enabled;
+	static PointerProfile & fetchLocalProfile(profileStage stage, int profileId);
+public:
+	static void enable();
+	static const bool isEnabled();
+	static int registerPointer(const std::string configName, const std::string path);
+	static void recordVisit(profileStage stage, int profileId, std::chrono::steady_clock::duration duration);
+	static void recordLookup(profileStage stage, int profileId, bool hit);
+	static void recordExpansion(profileStage stage, int profileId);
+	static void writeReport(std::ostream & reportStream);
+};
@@ -0,0 +1,120 @@
+#include "content_hash_memo.h"
+
+ContentHashMemo::ContentHashMemo() { }
+
+namespace {
+	//Results of content seen only once are kept up to this size, in case a copy follows soon, as colour variants in the same folder do.
+	const std::uint64_t maxCandidateBytes = 64ULL << 20;
+
+	std::uint64_t getResultBytes(const MemoResult & result) {
+		std::uint64_t resultBytes = sizeof(MemoResult) + result.text.size() + result.internedIds.size() * sizeof(int);
+		for (const ExtractedValue & value : result.allExtractedValues) resultBytes += sizeof(ExtractedValue) + value.fieldPath.size() + value.path.size() + value.text.size();
+		return resultBytes;
+	}
+}
+
+/**
+ * Makes the result for some content once and hands the same result to later requests for identical content.
+ * Results are kept for the whole run only once their content has been seen twice. Results of content seen once are kept
+ * within a fixed budget and dropped oldest first, so memory grows with the repeated content rather than every asset.
+ * If another thread is already making the result it is waited for. Safe to call from several threads.
+ * 
+ * @param contentKey Identifies the content and anything else the result depends on, such as the parse target config.
+ * @param contentLength The length of the content, checked before a result is reused in case two contents share a hash.
+ * @param makeResult Makes the result if it can not be reused.
+ * @return The result for the content.
+ */
+MemoResult ContentHashMemo::fetchOrMake(const std::string & contentKey, std::uint64_t contentLength, const std::function<MemoResult()> & makeResult) {
+	std::promise<MemoResult> resultPromise;
+	std::unique_lock<std::mutex> lock(memoMutex);
+	auto found = allEntries.find(contentKey);
+	if (found == allEntries.end()) {
+		//First sighting, kept as a candidate once made.
+		MemoEntry & entry = allEntries[contentKey];
+		entry.contentLength = contentLength;
+		entry.result = resultPromise.get_future().share();
+		lock.unlock();
+		MemoResult result;
+		try {
+			result = makeResult();
+		} catch (...) {
+			resultPromise.set_exception(std::current_exception());
+			throw;
+		}
+		resultPromise.set_value(result);
+
+		lock.lock();
+		MemoEntry & madeEntry = allEntries[contentKey];
+		if (!madeEntry.repeated) {
+			madeEntry.resultBytes = getResultBytes(result);
+			madeEntry.candidatePosition = candidateOrder.insert(candidateOrder.begin(), contentKey);
+			madeEntry.candidate = true;
+			candidateBytes += madeEntry.resultBytes;
+			dropCandidates();
+		}
+		return result;
+	}
+
+	MemoEntry & entry = found->second;
+	//Different content with the same hash.
+	if (entry.contentLength != contentLength) {
+		lock.unlock();
+		return makeResult();
+	}
+	//Seen again, so the result is kept for the rest of the run.
+	entry.repeated = true;
+	if (entry.candidate) {
+		candidateOrder.erase(entry.candidatePosition);
+		candidateBytes -= entry.resultBytes;
+		entry.candidate = false;
+	}
+	if (!entry.result.valid()) {
+		//The first result was already dropped, so this copy makes the one kept.
+		entry.result = resultPromise.get_future().share();
+		lock.unlock();
+		try {
+			MemoResult result = makeResult();
+			resultPromise.set_value(result);
+			return result;
+		} catch (...) {
+			resultPromise.set_exception(std::current_exception());
+			throw;
+		}
+	}
+	std::shared_future<MemoResult> result = entry.result;
+	//Wait outside the lock in case the result is still being made.
+	lock.unlock();
+	totalReused++;
+	return result.get();
+}
+
+/**
+ * Drops the oldest results of content seen once until the rest fit the candidate budget. The content is still remembered,
+ * so a later copy makes a result that is kept. Called with the memo locked.
+ */
+void ContentHashMemo::dropCandidates() {
+	while (candidateBytes > maxCandidateBytes && !candidateOrder.empty()) {
+		MemoEntry & entry = allEntries[candidateOrder.back()];
+		candidateBytes -= entry.resultBytes;
+		entry.result = std::shared_future<MemoResult>();
+		entry.candidate = false;
+		candidateOrder.pop_back();
+	}
+}
+
+const int ContentHashMemo::getReusedCount() { return totalReused; }
+
+/**
+ * 64 bit FNV-1a hash. Can be chained by passing the previous hash.
+ * 
+ * @param content The bytes to hash.
+ * @param hash The hash to continue from.
+ * @return The hash of the content.
+ */
+std::uint64_t hashContent(std::string_view content, std::uint64_t hash) {
+	for (const unsigned char byte : content) {
+		hash ^= byte;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
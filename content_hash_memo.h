@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "value_index.h"
+
+struct MemoResult {
+	int count = 0;
+	std::string text;
+	std::vector<int> internedIds;
+	std::vector<ExtractedValue> allExtractedValues;
+};
+
+struct MemoEntry {
+	//Length of the content, so a hash collision between different content is never reused.
+	std::uint64_t contentLength = 0;
+	//Empty once a result seen only once has been dropped.
+	std::shared_future<MemoResult> result;
+	//If the content has been seen more than once, which keeps its result for the rest of the run.
+	bool repeated = false;
+	std::uint64_t resultBytes = 0;
+	std::list<std::string>::iterator candidatePosition;
+	bool candidate = false;
+};
+
+class ContentHashMemo {
+private:
+	std::unordered_map<std::string, MemoEntry> allEntries;
+	//Results of content seen once, most recent first, dropped oldest first beyond the candidate budget.
+	std::list<std::string> candidateOrder;
+	std::uint64_t candidateBytes = 0;
+	std::atomic<int> totalReused = 0;
+	std::mutex memoMutex;
+
+	void dropCandidates();
+public:
+	ContentHashMemo();
+	MemoResult fetchOrMake(const std::string & contentKey, std::uint64_t contentLength, const std::function<MemoResult()> & makeResult);
+	//Getters
+	const int getReusedCount();
+};
+
+std::uint64_t hashContent(std::string_view content, std::uint64_t hash = 14695981039346656037ULL);
@@ -0,0 +1,165 @@
+#include "directory_walker.h"
+
+#include <thread>
+#ifndef _WIN32
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace fs = std::filesystem;
+
+/**
+ * @param threadCount How many folders may be read at once.
+ * @param allExtensions Only files with these extensions are reported, such as ".object". Empty to report every file.
+ */
+DirectoryWalker::DirectoryWalker(int threadCount, std::unordered_set<std::string> allExtensions) : threadCount(threadCount > 0 ? threadCount : 1), allExtensions(allExtensions) { }
+
+/**
+ * @param threadCount How many folders may be read at once.
+ * @param allExtensions Only files with these extensions are reported, such as ".object". Empty to report every file.
+ * @param pathFilter Folders it rules out are never read and files it rules out are never reported, null to not filter.
+ */
+DirectoryWalker::DirectoryWalker(int threadCount, std::unordered_set<std::string> allExtensions, AssetPathFilter * pathFilter) : threadCount(threadCount > 0 ? threadCount : 1), allExtensions(allExtensions), pathFilter(pathFilter) { }
+
+/**
+ * Recursively walks a folder on several threads, reporting matching files as they are found.
+ * Links to folders are not followed. The order files are reported in is not stable.
+ * 
+ * @param rootPath The folder to walk.
+ * @param onFile Called with the path of every matching file. Called from several threads at once.
+ */
+void DirectoryWalker::walk(const fs::path & rootPath, const std::function<void(const fs::path &)> & onFile) {
+	pendingDirectories.clear();
+	pendingDirectories.push_back(rootPath);
+	rootPathLength = rootPath.generic_string().length();
+	activeThreads = 0;
+
+	std::vector<std::thread> allThreads;
+	for (int i = 1; i < threadCount; i++) {
+		allThreads.emplace_back(&DirectoryWalker::runThread, this, std::cref(onFile));
+	}
+	runThread(onFile);
+	for (std::thread & thread : allThreads) {
+		thread.join();
+	}
+}
+
+void DirectoryWalker::runThread(const std::function<void(const fs::path &)> & onFile) {
+	std::vector<fs::path> subdirectories;
+	while (true) {
+		fs::path directoryPath;
+		{
+			std::unique_lock<std::mutex> lock(walkerMutex);
+			//Wait for more folders unless every thread is idle, which means the walk is done.
+			directoriesChanged.wait(lock, [this] { return !pendingDirectories.empty() || activeThreads == 0; });
+			if (pendingDirectories.empty()) return;
+			directoryPath = std::move(pendingDirectories.back());
+			pendingDirectories.pop_back();
+			activeThreads++;
+		}
+
+		subdirectories.clear();
+		readDirectory(directoryPath, subdirectories, onFile);
+
+		{
+			std::lock_guard<std::mutex> lock(walkerMutex);
+			for (fs::path & subdirectory : subdirectories) {
+				pendingDirectories.push_back(std::move(subdirectory));
+			}
+			activeThreads--;
+		}
+		directoriesChanged.notify_all();
+	}
+}
+
+/**
+ * Reads the entries of a single folder. Entry types are taken from the folder listing where possible so most entries are never stat'ed.
+ * 
+ * @param directoryPath The folder to read.
+ * @param subdirectories Folders found are added to this.
+ * @param onFile Called with the path of every matching file.
+ */
+void DirectoryWalker::readDirectory(const fs::path & directoryPath, std::vector<fs::path> & subdirectories, const std::function<void(const fs::path &)> & onFile) {
+	//Only needed to filter paths.
+	const std::string directoryAssetPath = pathFilter != nullptr ? directoryPath.generic_string().substr(rootPathLength) : "";
+#ifdef _WIN32
+	//The folder listing already includes the entry type on Windows.
+	std::error_code error;
+	for (const auto & directory : fs::directory_iterator(directoryPath, error)) {
+		const std::string name = directory.path().filename().string();
+		if (directory.is_directory(error) && !directory.is_symlink(error)) {
+			if (isWantedFolder(directoryAssetPath, name)) subdirectories.push_back(directory.path());
+		} else if (isWantedFile(directoryAssetPath, name) && directory.is_regular_file(error)) {
+			onFile(directory.path());
+		}
+	}
+#else
+	DIR * directory = opendir(directoryPath.c_str());
+	if (directory == nullptr) return;
+	while (dirent * entry = readdir(directory)) {
+		const char * name = entry->d_name;
+		if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+
+		unsigned char type = entry->d_type;
+		//Files without a wanted extension never need their type.
+		if (type == DT_REG) {
+			if (isWantedFile(directoryAssetPath, name)) onFile(directoryPath / name);
+			continue;
+		}
+		//Folders the filter rules out are never read.
+		if (type == DT_DIR) {
+			if (isWantedFolder(directoryAssetPath, name)) subdirectories.push_back(directoryPath / name);
+			continue;
+		}
+		//Unknown types and links need a stat, but only if they could be wanted.
+		if (type == DT_UNKNOWN || type == DT_LNK) {
+			const bool wantedFile = isWantedFile(directoryAssetPath, name);
+			const fs::path entryPath = directoryPath / name;
+			struct stat entryStat;
+			if (type == DT_UNKNOWN) {
+				if (!wantedFile && !isWantedFolder(directoryAssetPath, name)) continue;
+				if (lstat(entryPath.c_str(), &entryStat) != 0) continue;
+				if (S_ISDIR(entryStat.st_mode)) {
+					if (isWantedFolder(directoryAssetPath, name)) subdirectories.push_back(entryPath);
+					continue;
+				}
+			}
+			if (!wantedFile) continue;
+			//Links to files are followed, links to folders are not.
+			if (stat(entryPath.c_str(), &entryStat) == 0 && S_ISREG(entryStat.st_mode)) onFile(entryPath);
+		}
+	}
+	closedir(directory);
+#endif
+}
+
+/**
+ * @param fileName The name of a file, without its folder.
+ * @return If the file has one of the wanted extensions.
+ */
+const bool DirectoryWalker::hasWantedExtension(const std::string & fileName) {
+	if (allExtensions.empty()) return true;
+	const std::size_t dotPosition = fileName.rfind('.');
+	//Names starting with their only dot, such as ".gitignore", have no extension.
+	if (dotPosition == std::string::npos || dotPosition == 0) return false;
+	return allExtensions.contains(fileName.substr(dotPosition));
+}
+
+/**
+ * @param directoryAssetPath The asset path of the folder the file is in.
+ * @param fileName The name of the file.
+ * @return If the file has a wanted extension and is not filtered out.
+ */
+const bool DirectoryWalker::isWantedFile(const std::string & directoryAssetPath, const std::string & fileName) {
+	if (!hasWantedExtension(fileName)) return false;
+	return pathFilter == nullptr || pathFilter->matchesFile(directoryAssetPath + '/' + fileName);
+}
+
+/**
+ * @param directoryAssetPath The asset path of the folder the folder is in.
+ * @param folderName The name of the folder.
+ * @return If the folder could contain wanted files.
+ */
+const bool DirectoryWalker::isWantedFolder(const std::string & directoryAssetPath, const std::string & folderName) {
+	return pathFilter == nullptr || pathFilter->mayMatchFolder(directoryAssetPath + '/' + folderName);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "asset_path_filter.h"
+
+class DirectoryWalker {
+private:
+	int threadCount;
+	std::unordered_set<std::string> allExtensions;
+	AssetPathFilter * pathFilter = nullptr;
+	std::size_t rootPathLength = 0;
+	std::vector<std::filesystem::path> pendingDirectories;
+	std::mutex walkerMutex;
+	std::condition_variable directoriesChanged;
+	int activeThreads = 0;
+
+	void runThread(const std::function<void(const std::filesystem::path &)> & onFile);
+	void readDirectory(const std::filesystem::path & directoryPath, std::vector<std::filesystem::path> & subdirectories, const std::function<void(const std::filesystem::path &)> & onFile);
+	const bool hasWantedExtension(const std::string & fileName);
+	const bool isWantedFile(const std::string & directoryAssetPath, const std::string & fileName);
+	const bool isWantedFolder(const std::string & directoryAssetPath, const std::string & folderName);
+public:
+	DirectoryWalker(int threadCount, std::unordered_set<std::string> allExtensions);
+	DirectoryWalker(int threadCount, std::unordered_set<std::string> allExtensions, AssetPathFilter * pathFilter);
+	void walk(const std::filesystem::path & rootPath, const std::function<void(const std::filesystem::path &)> & onFile);
+};
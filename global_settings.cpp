@@ -1,6 +1,7 @@
 #include "global_settings.h"
 
 #include "utilities.h"
+#include "shard_summary.h"
 
 using json = nlohmann::json;
 
@@ -15,6 +16,16 @@ MasterSettings::MasterSettings(fs::path settingsPath) {
 	postLoad();
 }
 
+/**
+ * Loads settings without touching the file system. Missing settings keep their defaults.
+ * 
+ * @param settingsJson The settings JSON, laid out like settings.json.
+ * @param patchStyle The patch style to use.
+ */
+MasterSettings::MasterSettings(json settingsJson, PatchStyleSettings patchStyle) : baselinePatchStyle(patchStyle) {
+	loadSettings(settingsJson);
+}
+
 bool MasterSettings::loadSettings(json settingsJson) {
 	//TODO: Handle invalid types more gracefully.
 	bool missingSettings = false;
@@ -38,6 +49,76 @@ bool MasterSettings::loadSettings(json settingsJson) {
 	} else {
 		missingSettings = true;
 	}
+	if (settingsJson.contains("bundleIntermediaryFiles")) {
+		bundleIntermediaryFiles = settingsJson["bundleIntermediaryFiles"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("internIntermediaryValues")) {
+		internIntermediaryValues = settingsJson["internIntermediaryValues"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("optimisePatchOperations")) {
+		optimisePatchOperations = settingsJson["optimisePatchOperations"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("workerThreads")) {
+		workerThreads = settingsJson["workerThreads"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("maxMemory")) {
+		maxMemory = settingsJson["maxMemory"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("sourceLayers")) {
+		sourceLayers = settingsJson["sourceLayers"].get<std::vector<std::string>>();
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("deduplicateIdenticalAssets")) {
+		deduplicateIdenticalAssets = settingsJson["deduplicateIdenticalAssets"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("includePaths")) {
+		includePaths = settingsJson["includePaths"].get<std::vector<std::string>>();
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("excludePaths")) {
+		excludePaths = settingsJson["excludePaths"].get<std::vector<std::string>>();
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("writeChangedFilesOnly")) {
+		writeChangedFilesOnly = settingsJson["writeChangedFilesOnly"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("jsonParser")) {
+		jsonParser = settingsJson["jsonParser"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("patchTrees")) {
+		patchTrees = settingsJson["patchTrees"].get<std::vector<std::pair<std::string, std::string>>>();
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("buildValueIndex")) {
+		buildValueIndex = settingsJson["buildValueIndex"];
+	} else {
+		missingSettings = true;
+	}
+	if (settingsJson.contains("parallelParseSize")) {
+		parallelParseSize = settingsJson["parallelParseSize"];
+	} else {
+		missingSettings = true;
+	}
 	return missingSettings;
 }
 
@@ -51,7 +132,36 @@ void MasterSettings::writeSettings(std::stringstream & settingsText) {
 		<< "\n  //Inverse tests are used by Starbound to see if a value is present or not, regardless of its contents."
 		<< "\n  \"useInverseTestOps\" : " << (useInverseTestOps ? "true" : "false") << ','
 		<< "\n  //Operation sets are used by Starbound to allow more than one set of operations to be applied from a patch file."
-		<< "\n  \"useOperationSets\" : " << (useOperationSets ? "true" : "false")
+		<< "\n  \"useOperationSets\" : " << (useOperationSets ? "true" : "false") << ','
+		<< "\n  //Write every intermediary file into a single indexed bundle instead of one file per asset."
+		<< "\n  \"bundleIntermediaryFiles\" : " << (bundleIntermediaryFiles ? "true" : "false") << ','
+		<< "\n  //Write identical string values once to a shared table that intermediary files reference by id."
+		<< "\n  \"internIntermediaryValues\" : " << (internIntermediaryValues ? "true" : "false") << ','
+		<< "\n  //Merge operation sets and drop redundant tests where it does not change how patches apply."
+		<< "\n  \"optimisePatchOperations\" : " << (optimisePatchOperations ? "true" : "false") << ','
+		<< "\n  //How many assets are processed at once. 0 uses every hardware thread."
+		<< "\n  \"workerThreads\" : " << workerThreads << ','
+		<< "\n  //Estimated memory assets being processed at once may use, such as \"512M\" or \"1G\". Empty for no limit."
+		<< "\n  \"maxMemory\" : \"" << maxMemory << "\","
+		<< "\n  //Asset folders or .pak files to layer like Starbound mods, lowest first. Their .patch files are applied before parsing. Empty uses \\source_assets\\."
+		<< "\n  \"sourceLayers\" : " << json(sourceLayers).dump() << ','
+		<< "\n  //Process byte identical assets once and reuse the result for every copy."
+		<< "\n  \"deduplicateIdenticalAssets\" : " << (deduplicateIdenticalAssets ? "true" : "false") << ','
+		<< "\n  //Only assets matching one of these globs are processed, such as \"/objects/wired\" or \"*.object\". Empty processes every asset."
+		<< "\n  \"includePaths\" : " << json(includePaths).dump() << ','
+		<< "\n  //Assets matching any of these globs are never processed."
+		<< "\n  \"excludePaths\" : " << json(excludePaths).dump() << ','
+		<< "\n  //Keep an existing patch output folder, only writing patches whose contents changed and removing ones no longer made."
+		<< "\n  \"writeChangedFilesOnly\" : " << (writeChangedFilesOnly ? "true" : "false") << ','
+		<< "\n  //The JSON parser assets are read with, \"nlohmann\" or \"simdjson\" if built with SBPH_USE_SIMDJSON. Output is identical."
+		<< "\n  \"jsonParser\" : \"" << jsonParser << "\","
+		<< "\n  //Pairs of intermediary asset folder and patch output folder, such as one per language, made in one run that parses each source asset once."
+		<< "\n  //For example [[\"intermediary_assets_de\", \"patch_output_de\"]]. Empty uses \\intermediary_assets\\ and \\patch_output\\."
+		<< "\n  \"patchTrees\" : " << json(patchTrees).dump() << ','
+		<< "\n  //Record every extracted value in a word index next to the intermediary assets when parsing, searched with the query command."
+		<< "\n  \"buildValueIndex\" : " << (buildValueIndex ? "true" : "false") << ','
+		<< "\n  //Assets at least this large, such as \"4M\", are split into parts parsed on several threads at once. Empty to always parse on one thread."
+		<< "\n  \"parallelParseSize\" : \"" << parallelParseSize << "\""
 		<< "\n}\n";
 }
 
@@ -66,3 +176,56 @@ std::string MasterSettings::getBaselinePatchStyleName() { return baselinePatchSt
 const bool MasterSettings::getOverwriteFiles() { return overwriteFiles; }
 const bool MasterSettings::getUseInverseTestOps() { return useInverseTestOps; }
 const bool MasterSettings::getUseOperationSets() { return useOperationSets; }
+const bool MasterSettings::getBundleIntermediaryFiles() { return bundleIntermediaryFiles; }
+const bool MasterSettings::getInternIntermediaryValues() { return internIntermediaryValues; }
+const bool MasterSettings::getOptimisePatchOperations() { return optimisePatchOperations; }
+const int MasterSettings::getWorkerThreads() { return workerThreads; }
+const std::uint64_t MasterSettings::getMaxMemoryBytes() {
+	std::uint64_t bytes = 0;
+	parseByteSize(maxMemory, bytes);
+	return bytes;
+}
+std::vector<std::string> MasterSettings::getSourceLayers() { return sourceLayers; }
+const bool MasterSettings::getDeduplicateIdenticalAssets() { return deduplicateIdenticalAssets; }
+std::vector<std::string> MasterSettings::getIncludePaths() { return includePaths; }
+std::vector<std::string> MasterSettings::getExcludePaths() { return excludePaths; }
+const bool MasterSettings::getWriteChangedFilesOnly() { return writeChangedFilesOnly; }
+std::string MasterSettings::getJsonParser() { return jsonParser; }
+std::vector<std::pair<std::string, std::string>> MasterSettings::getPatchTrees() { return patchTrees; }
+const bool MasterSettings::getBuildValueIndex() { return buildValueIndex; }
+const std::uint64_t MasterSettings::getParallelParseBytes() {
+	std::uint64_t bytes = 0;
+	parseByteSize(parallelParseSize, bytes);
+	return bytes;
+}
+const int MasterSettings::getShardIndex() { return shardIndex; }
+const int MasterSettings::getShardCount() { return shardCount; }
+
+//Setters
+
+void MasterSettings::setOverwriteFiles(bool overwrite) { overwriteFiles = overwrite; }
+void MasterSettings::setWorkerThreads(int threads) { workerThreads = threads; }
+
+/**
+ * @param size A byte size such as "512M" or "1G", empty for no limit.
+ * @return If the size was valid.
+ */
+bool MasterSettings::setMaxMemory(std::string size) {
+	std::uint64_t bytes = 0;
+	if (!parseByteSize(size, bytes)) return false;
+	maxMemory = size;
+	return true;
+}
+
+void MasterSettings::setSourceLayers(std::vector<std::string> layers) { sourceLayers = layers; }
+void MasterSettings::setIncludePaths(std::vector<std::string> patterns) { includePaths = patterns; }
+void MasterSettings::setExcludePaths(std::vector<std::string> patterns) { excludePaths = patterns; }
+void MasterSettings::setPatchTrees(std::vector<std::pair<std::string, std::string>> trees) { patchTrees = trees; }
+
+/**
+ * @param shard The shard of the assets this run uses, such as "2/4" for the second of four.
+ * @return If the shard was valid.
+ */
+bool MasterSettings::setShard(std::string shard) {
+	return parseShard(shard, shardIndex, shardCount);
+}
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
 #include <nlohmann/json.hpp>
 #include "patch_style_settings.h"
 
@@ -10,16 +14,59 @@ private:
 	bool overwriteFiles = false;
 	bool useInverseTestOps = true;
 	bool useOperationSets = true;
+	bool bundleIntermediaryFiles = false;
+	bool internIntermediaryValues = false;
+	bool optimisePatchOperations = false;
+	int workerThreads = 0;
+	std::string maxMemory = "";
+	std::vector<std::string> sourceLayers;
+	bool deduplicateIdenticalAssets = true;
+	std::vector<std::string> includePaths;
+	std::vector<std::string> excludePaths;
+	bool writeChangedFilesOnly = true;
+	std::string jsonParser = "nlohmann";
+	std::vector<std::pair<std::string, std::string>> patchTrees;
+	bool buildValueIndex = true;
+	std::string parallelParseSize = "4M";
+	//Only set for a single run, never saved.
+	int shardIndex = 1;
+	int shardCount = 1;
 
 	bool loadSettings(nlohmann::json settingsJson);
 	void writeSettings(std::stringstream & settingsText);
 	void postLoad();
 public:
 	MasterSettings(std::filesystem::path settingsPath);
+	MasterSettings(nlohmann::json settingsJson, PatchStyleSettings patchStyle);
 	PatchStyleSettings baselinePatchStyle;
 	//Getters
 	std::string getBaselinePatchStyleName();
 	const bool getOverwriteFiles();
 	const bool getUseInverseTestOps();
 	const bool getUseOperationSets();
+	const bool getBundleIntermediaryFiles();
+	const bool getInternIntermediaryValues();
+	const bool getOptimisePatchOperations();
+	const int getWorkerThreads();
+	const std::uint64_t getMaxMemoryBytes();
+	std::vector<std::string> getSourceLayers();
+	const bool getDeduplicateIdenticalAssets();
+	std::vector<std::string> getIncludePaths();
+	std::vector<std::string> getExcludePaths();
+	const bool getWriteChangedFilesOnly();
+	std::string getJsonParser();
+	std::vector<std::pair<std::string, std::string>> getPatchTrees();
+	const bool getBuildValueIndex();
+	const std::uint64_t getParallelParseBytes();
+	const int getShardIndex();
+	const int getShardCount();
+	//Setters
+	void setOverwriteFiles(bool overwrite);
+	void setWorkerThreads(int threads);
+	bool setMaxMemory(std::string size);
+	void setSourceLayers(std::vector<std::string> layers);
+	void setIncludePaths(std::vector<std::string> patterns);
+	void setExcludePaths(std::vector<std::string> patterns);
+	void setPatchTrees(std::vector<std::pair<std::string, std::string>> trees);
+	bool setShard(std::string shard);
 };
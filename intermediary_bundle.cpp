@@ -0,0 +1,220 @@
+#include "intermediary_bundle.h"
+
+#include <charconv>
+#include <cstdio>
+#include <sstream>
+#include <nlohmann/json.hpp>
+#include "perf_counters.h"
+#include "utilities.h"
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+//Bundle layout:
+//  header
+//  intermediary text of every asset, back to back, in the order they were appended
+//  index, a JSON array of [asset path, byte offset, byte length]
+//  trailer, the zero padded byte offset of the index followed by the trailer magic
+const std::string bundleHeader = "//Starbound Patch Helper intermediary bundle v1\n";
+const std::string bundleTrailerMagic = "SBPHIDX\n";
+const std::size_t bundleTrailerOffsetDigits = 20;
+
+IntermediaryBundleWriter::IntermediaryBundleWriter() { }
+
+IntermediaryBundleWriter::~IntermediaryBundleWriter() {
+	if (bundleFile.is_open()) close();
+}
+
+/**
+ * Creates a new bundle file, replacing any existing one.
+ * 
+ * @param bundlePath The path the bundle should be written to.
+ * @return If the bundle file was created.
+ */
+bool IntermediaryBundleWriter::open(fs::path bundlePath) {
+	if (!bundlePath.parent_path().empty() && !fs::exists(bundlePath.parent_path()) && !fs::create_directories(bundlePath.parent_path())) {
+		return false;
+	}
+	bundleFile.open(bundlePath, std::ios::binary | std::ios::trunc);
+	if (!bundleFile.is_open()) return false;
+	bundleFile << bundleHeader;
+	currentOffset = bundleHeader.length();
+	allEntries.clear();
+	return true;
+}
+
+/**
+ * Appends the intermediary text of one asset to the bundle. Safe to call from several threads.
+ * 
+ * @param assetPath The asset path relative to the asset folder, using forward slashes.
+ * @param intermediaryText The intermediary text of the asset.
+ */
+void IntermediaryBundleWriter::append(const std::string assetPath, const std::string & intermediaryText) {
+	CounterScope counterScope = CounterScope(writeCounterStage);
+	std::lock_guard<std::mutex> lock(appendMutex);
+	bundleFile.write(intermediaryText.data(), intermediaryText.length());
+	allEntries.push_back({assetPath, currentOffset, intermediaryText.length()});
+	currentOffset += intermediaryText.length();
+}
+
+/**
+ * Writes the index and trailer, then closes the bundle.
+ * 
+ * @return If the bundle was written without errors.
+ */
+bool IntermediaryBundleWriter::close() {
+	json indexJson = json::array();
+	for (const BundleEntry & entry : allEntries) {
+		indexJson.push_back({entry.assetPath, entry.offset, entry.length});
+	}
+	const std::uint64_t indexOffset = currentOffset;
+	bundleFile << indexJson.dump() << '\n';
+
+	char offsetText[bundleTrailerOffsetDigits + 1];
+	std::snprintf(offsetText, sizeof(offsetText), "%020llu", static_cast<unsigned long long>(indexOffset));
+	bundleFile << offsetText << bundleTrailerMagic;
+
+	const bool written = bundleFile.good();
+	bundleFile.close();
+	return written;
+}
+
+const std::size_t IntermediaryBundleWriter::getEntryCount() { return allEntries.size(); }
+
+IntermediaryBundleReader::IntermediaryBundleReader() { }
+
+/**
+ * Maps a bundle into memory and loads its index.
+ * 
+ * @param bundlePath The path of the bundle to read.
+ * @return If the bundle was valid and could be read.
+ */
+bool IntermediaryBundleReader::open(fs::path bundlePath) {
+	allEntries.clear();
+	entryIndices.clear();
+	if (!bundleFile.open(bundlePath)) return false;
+
+	const std::size_t trailerLength = bundleTrailerOffsetDigits + bundleTrailerMagic.length();
+	const std::size_t bundleSize = bundleFile.getSize();
+	if (bundleSize < bundleHeader.length() + trailerLength) return false;
+	if (bundleFile.getView(0, bundleHeader.length()) != bundleHeader) return false;
+
+	std::string_view trailer = bundleFile.getView(bundleSize - trailerLength, trailerLength);
+	if (trailer.substr(bundleTrailerOffsetDigits) != bundleTrailerMagic) return false;
+	std::uint64_t indexOffset = 0;
+	const char * offsetEnd = trailer.data() + bundleTrailerOffsetDigits;
+	auto [parsedEnd, parseError] = std::from_chars(trailer.data(), offsetEnd, indexOffset);
+	if (parseError != std::errc() || parsedEnd != offsetEnd) return false;
+	if (indexOffset > bundleSize - trailerLength) return false;
+
+	std::string_view indexText = bundleFile.getView(indexOffset, bundleSize - trailerLength - indexOffset);
+	const json indexJson = json::parse(indexText, nullptr, false);
+	if (!indexJson.is_array()) return false;
+
+	//Every entry has to lie within the texts before the index, or the bundle is corrupt and the reader is left empty.
+	for (const json & entryJson : indexJson) {
+		if (!entryJson.is_array() || entryJson.size() != 3 || !entryJson[0].is_string() || !entryJson[1].is_number_unsigned() || !entryJson[2].is_number_unsigned()) {
+			allEntries.clear();
+			entryIndices.clear();
+			return false;
+		}
+		BundleEntry entry;
+		entry.assetPath = entryJson[0];
+		entry.offset = entryJson[1];
+		entry.length = entryJson[2];
+		if (entry.offset > indexOffset || entry.length > indexOffset - entry.offset) {
+			allEntries.clear();
+			entryIndices.clear();
+			return false;
+		}
+		entryIndices[entry.assetPath] = allEntries.size();
+		allEntries.push_back(entry);
+	}
+	return true;
+}
+
+/**
+ * @param assetPath The asset path relative to the asset folder, using forward slashes.
+ * @return If the bundle has an entry for the asset.
+ */
+const bool IntermediaryBundleReader::contains(const std::string & assetPath) {
+	return entryIndices.contains(assetPath);
+}
+
+/**
+ * Gets the intermediary text of an asset without copying it.
+ * 
+ * @param assetPath The asset path relative to the asset folder, using forward slashes.
+ * @return The intermediary text, empty if the asset is not in the bundle.
+ */
+std::string_view IntermediaryBundleReader::fetchText(const std::string & assetPath) {
+	auto found = entryIndices.find(assetPath);
+	if (found == entryIndices.end()) return std::string_view();
+	return fetchText(allEntries[found->second]);
+}
+
+/**
+ * Gets the intermediary text of a bundle entry without copying it.
+ * 
+ * @param entry The entry to get the text of.
+ * @return The intermediary text.
+ */
+std::string_view IntermediaryBundleReader::fetchText(const BundleEntry & entry) {
+	return bundleFile.getView(entry.offset, entry.length);
+}
+
+const std::vector<BundleEntry> & IntermediaryBundleReader::getAllEntries() { return allEntries; }
+
+/**
+ * @param intermediaryAssetPath The intermediary asset folder.
+ * @return The path of the bundle that stands in for the intermediary asset folder.
+ */
+fs::path getIntermediaryBundlePath(fs::path intermediaryAssetPath) {
+	fs::path bundlePath = intermediaryAssetPath;
+	bundlePath += ".bundle";
+	return bundlePath;
+}
+
+/**
+ * Packs every file in an intermediary asset folder into a bundle.
+ * 
+ * @param intermediaryAssetPath The intermediary asset folder to read from.
+ * @param bundlePath The path the bundle should be written to.
+ * @return How many files were packed, -1 if the bundle could not be written.
+ */
+int packIntermediaryBundle(fs::path intermediaryAssetPath, fs::path bundlePath) {
+	IntermediaryBundleWriter bundleWriter;
+	if (!bundleWriter.open(bundlePath)) return -1;
+	for (const auto & directory : fs::recursive_directory_iterator(intermediaryAssetPath)) {
+		if (directory.is_regular_file()) {
+			const std::string assetPath = '/' + directory.path().lexically_relative(intermediaryAssetPath).generic_string();
+			bundleWriter.append(assetPath, fetchText(directory));
+		}
+	}
+	const int totalPacked = bundleWriter.getEntryCount();
+	return bundleWriter.close() ? totalPacked : -1;
+}
+
+/**
+ * Unpacks every entry in a bundle into an intermediary asset folder.
+ * 
+ * @param bundlePath The bundle to read from.
+ * @param intermediaryAssetPath The intermediary asset folder to write to.
+ * @return How many files were unpacked, -1 if the bundle could not be read.
+ */
+int unpackIntermediaryBundle(fs::path bundlePath, fs::path intermediaryAssetPath) {
+	IntermediaryBundleReader bundleReader;
+	if (!bundleReader.open(bundlePath)) return -1;
+	int totalUnpacked = 0;
+	for (const BundleEntry & entry : bundleReader.getAllEntries()) {
+		std::stringstream intermediaryText;
+		intermediaryText << bundleReader.fetchText(entry);
+		fs::path intermediaryPath = intermediaryAssetPath;
+		intermediaryPath += fs::path(entry.assetPath).make_preferred();
+		if (writeStringStreamToPath(intermediaryText, intermediaryPath)) {
+			totalUnpacked++;
+		}
+	}
+	return totalUnpacked;
+}
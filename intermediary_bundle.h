@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "mapped_file.h"
+
+struct BundleEntry {
+	std::string assetPath;
+	std::uint64_t offset = 0;
+	std::uint64_t length = 0;
+};
+
+class IntermediaryBundleWriter {
+private:
+	std::ofstream bundleFile;
+	std::uint64_t currentOffset = 0;
+	std::vector<BundleEntry> allEntries;
+	std::mutex appendMutex;
+public:
+	IntermediaryBundleWriter();
+	~IntermediaryBundleWriter();
+	bool open(std::filesystem::path bundlePath);
+	void append(const std::string assetPath, const std::string & intermediaryText);
+	bool close();
+	//Getters
+	const std::size_t getEntryCount();
+};
+
+class IntermediaryBundleReader {
+private:
+	MappedFile bundleFile;
+	std::vector<BundleEntry> allEntries;
+	std::unordered_map<std::string, std::size_t> entryIndices;
+public:
+	IntermediaryBundleReader();
+	bool open(std::filesystem::path bundlePath);
+	const bool contains(const std::string & assetPath);
+	std::string_view fetchText(const std::string & assetPath);
+	std::string_view fetchText(const BundleEntry & entry);
+	//Getters
+	const std::vector<BundleEntry> & getAllEntries();
+};
+
+std::filesystem::path getIntermediaryBundlePath(std::filesystem::path intermediaryAssetPath);
+
+int packIntermediaryBundle(std::filesystem::path intermediaryAssetPath, std::filesystem::path bundlePath);
+
+int unpackIntermediaryBundle(std::filesystem::path bundlePath, std::filesystem::path intermediaryAssetPath);
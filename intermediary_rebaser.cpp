@@ -0,0 +1,211 @@
+#include "intermediary_rebaser.h"
+
+#include <algorithm>
+#include <cctype>
+#include "json_intermediary_writer.h"
+#include "utilities.h"
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+//Key intermediary files use for the comment added to the top of patches.
+const std::string patchMakerCommentKey = "patchMakerComment";
+
+/**
+ * @param fileSettings The file extension specific settings.
+ * @param path An intermediary value path, with any iterator markers replaced by indexes.
+ * @return If the value is taken from another asset.
+ */
+bool isResolvedPath(FileSettings & fileSettings, const std::string & path) {
+	for (const PointerSettings & pointerSettings : fileSettings.getAllPointerSettings()) {
+		if (pointerSettings.resolvedPath == "") continue;
+		const std::string & marker = pointerSettings.numericIteratorMarker;
+		//Match the path with every iterator marker standing in for an index.
+		std::size_t patternIndex = 0, pathIndex = 0;
+		bool matches = true;
+		while (matches && patternIndex < pointerSettings.path.length()) {
+			if (marker != "" && pointerSettings.path.compare(patternIndex, marker.length(), marker) == 0) {
+				const std::size_t digitsStart = pathIndex;
+				while (pathIndex < path.length() && std::isdigit(static_cast<unsigned char>(path[pathIndex]))) pathIndex++;
+				matches = pathIndex > digitsStart;
+				patternIndex += marker.length();
+			} else {
+				matches = pathIndex < path.length() && path[pathIndex++] == pointerSettings.path[patternIndex++];
+			}
+		}
+		if (matches && pathIndex == path.length()) return true;
+	}
+	return false;
+}
+
+IntermediaryRebaser::IntermediaryRebaser() { }
+
+/**
+ * @param internTable The table string values of rebased intermediary files are interned into, null to write values in place.
+ */
+IntermediaryRebaser::IntermediaryRebaser(ValueInternTable * internTable) : internTable(internTable) { }
+
+/**
+ * @param internTable The table string values of rebased intermediary files are interned into, null to write values in place.
+ * @param oldAssetIndex The index values from other old source assets are resolved through.
+ * @param newAssetIndex The index values from other new source assets are resolved through.
+ */
+IntermediaryRebaser::IntermediaryRebaser(ValueInternTable * internTable, AssetIndex * oldAssetIndex, AssetIndex * newAssetIndex) : internTable(internTable), oldAssetIndex(oldAssetIndex), newAssetIndex(newAssetIndex) { }
+
+/**
+ * Writes the intermediary file of the new source with edits from the old intermediary file merged in.
+ * Every value is merged on its own. Edited values are kept where the source value did not change,
+ * source updates are taken where the value was not edited, and values where both changed keep the edit and are reported as conflicts.
+ * 
+ * @param rebasedText The string stream the rebased intermediary JSON will be written to.
+ * @param fileSettings The file extension specific settings to use when parsing.
+ * @param assetPath The asset path, used when reporting conflicts.
+ * @param oldSourceJson The source JSON the edited intermediary file was parsed from.
+ * @param newSourceJson The source JSON to rebase onto.
+ * @param editedJson The edited intermediary JSON, with interned values resolved.
+ * @return How many values the rebased intermediary JSON contains.
+ */
+int IntermediaryRebaser::rebaseIntermediaryFile(std::stringstream & rebasedText, FileSettings & fileSettings, const std::string & assetPath, const json & oldSourceJson, const json & newSourceJson, const json & editedJson) {
+	const bool valuesHaveNewlines = fileSettings.getValuesContainNewlines();
+	//Intermediary values both sources would have produced, in the same form as the edited values.
+	std::stringstream oldIntermediaryText;
+	JsonIntermediaryWriter(nullptr, oldAssetIndex, assetPath).writeIntermediaryFile(oldIntermediaryText, fileSettings, oldSourceJson);
+	const json oldJson = parseJsonText(oldIntermediaryText.str(), valuesHaveNewlines);
+	std::stringstream newIntermediaryText;
+	JsonIntermediaryWriter(nullptr, newAssetIndex, assetPath).writeIntermediaryFile(newIntermediaryText, fileSettings, newSourceJson);
+	const json newJson = parseJsonText(newIntermediaryText.str(), valuesHaveNewlines);
+
+	//Kept edits are written into a copy of the new source so the intermediary writer lays them out as usual.
+	json mergedSourceJson = newSourceJson;
+	for (const auto & [path, newValue] : newJson.items()) {
+		if (path == patchMakerCommentKey || !editedJson.contains(path)) continue;
+		//Values from other assets are always taken from the new source.
+		if (isResolvedPath(fileSettings, path)) continue;
+		const json & editedValue = editedJson[path];
+		//Unedited or edited to what the source now has.
+		if (editedValue == newValue || (oldJson.contains(path) && editedValue == oldJson[path])) {
+			if (oldJson.contains(path) && oldJson[path] != newValue) totalValuesUpdated++;
+			continue;
+		}
+		mergedSourceJson[json::json_pointer(path)] = editedValue;
+		if (oldJson.contains(path) && oldJson[path] == newValue) {
+			totalEditsKept++;
+		} else {
+			//The edit wins but it was made against a value that has since changed.
+			RebaseConflict conflict;
+			conflict.assetPath = assetPath;
+			conflict.path = path;
+			conflict.reason = bothChanged;
+			conflict.oldValue = oldJson.contains(path) ? oldJson[path] : json();
+			conflict.editedValue = editedValue;
+			conflict.newValue = newValue;
+			addConflict(std::move(conflict));
+		}
+	}
+
+	//Edits to values the new source no longer has can not be kept.
+	for (const auto & [path, editedValue] : editedJson.items()) {
+		if (path == patchMakerCommentKey || newJson.contains(path) || isResolvedPath(fileSettings, path)) continue;
+		if (oldJson.contains(path) && oldJson[path] == editedValue) continue;
+		RebaseConflict conflict;
+		conflict.assetPath = assetPath;
+		conflict.path = path;
+		conflict.reason = sourceValueRemoved;
+		conflict.oldValue = oldJson.contains(path) ? oldJson[path] : json();
+		conflict.editedValue = editedValue;
+		addConflict(std::move(conflict));
+	}
+
+	std::stringstream mergedText;
+	JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter(internTable, newAssetIndex, assetPath);
+	const int totalValues = intermediaryWriter.writeIntermediaryFile(mergedText, fileSettings, mergedSourceJson);
+	std::string rebasedIntermediaryText = mergedText.str();
+
+	//Carry over the patch maker comment.
+	if (editedJson.contains(patchMakerCommentKey) && editedJson[patchMakerCommentKey] != "") {
+		const std::string blankComment = '"' + patchMakerCommentKey + "\" : \"\"";
+		const std::size_t commentPosition = rebasedIntermediaryText.find(blankComment);
+		if (commentPosition != std::string::npos) {
+			rebasedIntermediaryText.replace(commentPosition, blankComment.length(), '"' + patchMakerCommentKey + "\" : " + editedJson[patchMakerCommentKey].dump());
+		}
+	}
+	rebasedText << rebasedIntermediaryText;
+
+	return totalValues;
+}
+
+/**
+ * Reports every edit in an intermediary file whose source asset no longer exists.
+ * 
+ * @param assetPath The asset path.
+ * @param editedJson The edited intermediary JSON.
+ */
+void IntermediaryRebaser::addRemovedAsset(const std::string & assetPath, const json & editedJson) {
+	RebaseConflict conflict;
+	conflict.assetPath = assetPath;
+	conflict.reason = sourceAssetRemoved;
+	conflict.editedValue = editedJson;
+	addConflict(std::move(conflict));
+}
+
+void IntermediaryRebaser::addConflict(RebaseConflict conflict) {
+	std::lock_guard<std::mutex> lock(conflictMutex);
+	allConflicts.push_back(std::move(conflict));
+}
+
+/**
+ * Writes every conflict found so far, ordered by asset path.
+ * 
+ * @param reportText The string stream the report will be written to.
+ */
+void IntermediaryRebaser::writeConflictReport(std::stringstream & reportText) {
+	std::lock_guard<std::mutex> lock(conflictMutex);
+	std::stable_sort(allConflicts.begin(), allConflicts.end(), [](const RebaseConflict & first, const RebaseConflict & second) {
+		return first.assetPath < second.assetPath;
+	});
+
+	json report = json::array();
+	for (const RebaseConflict & conflict : allConflicts) {
+		json entry = json::object();
+		entry["asset"] = conflict.assetPath;
+		switch (conflict.reason) {
+		case bothChanged:
+			entry["path"] = conflict.path;
+			entry["reason"] = "Edited value changed in the new source, the edit was kept.";
+			entry["oldValue"] = conflict.oldValue;
+			entry["editedValue"] = conflict.editedValue;
+			entry["newValue"] = conflict.newValue;
+			break;
+		case sourceValueRemoved:
+			entry["path"] = conflict.path;
+			entry["reason"] = "Edited value is not in the new source, the edit was dropped.";
+			entry["oldValue"] = conflict.oldValue;
+			entry["editedValue"] = conflict.editedValue;
+			break;
+		case sourceAssetRemoved:
+			entry["reason"] = "Asset is not in the new source, the intermediary file was dropped.";
+			entry["editedValues"] = conflict.editedValue;
+			break;
+		}
+		report.push_back(std::move(entry));
+	}
+	reportText << report.dump(2) << '\n';
+}
+
+//Getters
+
+const int IntermediaryRebaser::getEditsKept() { return totalEditsKept; }
+const int IntermediaryRebaser::getValuesUpdated() { return totalValuesUpdated; }
+const std::size_t IntermediaryRebaser::getConflictCount() {
+	std::lock_guard<std::mutex> lock(conflictMutex);
+	return allConflicts.size();
+}
+
+/**
+ * @param rebasedAssetPath The rebased intermediary asset folder.
+ * @return The path of the conflict report written next to it.
+ */
+fs::path getRebaseConflictsPath(fs::path rebasedAssetPath) {
+	return rebasedAssetPath += ".conflicts.json";
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "asset_index.h"
+#include "parse_settings.h"
+#include "value_intern_table.h"
+
+enum rebaseConflictReason {
+	bothChanged,
+	sourceValueRemoved,
+	sourceAssetRemoved
+};
+
+struct RebaseConflict {
+	std::string assetPath;
+	std::string path;
+	rebaseConflictReason reason = bothChanged;
+	nlohmann::json oldValue;
+	nlohmann::json editedValue;
+	nlohmann::json newValue;
+};
+
+class IntermediaryRebaser {
+private:
+	ValueInternTable * internTable = nullptr;
+	AssetIndex * oldAssetIndex = nullptr;
+	AssetIndex * newAssetIndex = nullptr;
+	std::vector<RebaseConflict> allConflicts;
+	std::mutex conflictMutex;
+	std::atomic<int> totalEditsKept = 0;
+	std::atomic<int> totalValuesUpdated = 0;
+
+	void addConflict(RebaseConflict conflict);
+public:
+	IntermediaryRebaser();
+	IntermediaryRebaser(ValueInternTable * internTable);
+	IntermediaryRebaser(ValueInternTable * internTable, AssetIndex * oldAssetIndex, AssetIndex * newAssetIndex);
+	int rebaseIntermediaryFile(std::stringstream & rebasedText, FileSettings & fileSettings, const std::string & assetPath, const nlohmann::json & oldSourceJson, const nlohmann::json & newSourceJson, const nlohmann::json & editedJson);
+	void addRemovedAsset(const std::string & assetPath, const nlohmann::json & editedJson);
+	void writeConflictReport(std::stringstream & reportText);
+	//Getters
+	const int getEditsKept();
+	const int getValuesUpdated();
+	const std::size_t getConflictCount();
+};
+
+std::filesystem::path getRebaseConflictsPath(std::filesystem::path rebasedAssetPath);
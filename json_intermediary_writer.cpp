@@ -1,6 +1,8 @@
 #include "json_intermediary_writer.h"
 
 #include <string>
+#include "config_profiler.h"
+#include "perf_counters.h"
 #include "utilities.h"
 
 using json = nlohmann::json;
@@ -9,6 +11,22 @@ JsonIntermediaryWriter::JsonIntermediaryWriter(){
 	
 }
 
+/**
+ * @param internTable The table string values are interned into, null to write values in place.
+ */
+JsonIntermediaryWriter::JsonIntermediaryWriter(ValueInternTable * internTable) : internTable(internTable) {
+
+}
+
+/**
+ * @param internTable The table string values are interned into, null to write values in place.
+ * @param assetIndex The index values from other assets are resolved through, null to skip them.
+ * @param assetPath The asset path of the source JSON, relative references are resolved from it.
+ */
+JsonIntermediaryWriter::JsonIntermediaryWriter(ValueInternTable * internTable, AssetIndex * assetIndex, std::string assetPath) : internTable(internTable), assetIndex(assetIndex), assetPath(assetPath) {
+
+}
+
 /**
  * Writes an intermediary file. Some configurations will not comply with official JSON standards.
  * 
@@ -18,6 +36,7 @@ JsonIntermediaryWriter::JsonIntermediaryWriter(){
  * @return How many values the resulting intermediary JSON contains.
  */
 int JsonIntermediaryWriter::writeIntermediaryFile(std::stringstream & intermediaryText, FileSettings & fileSettings, const json & sourceJson) {
+	CounterScope counterScope = CounterScope(extractCounterStage);
 	totalIntermediaryValues = 0;
 
 	intermediaryText << "{\n";
@@ -29,7 +48,14 @@ int JsonIntermediaryWriter::writeIntermediaryFile(std::stringstream & intermedia
 
 	//iterate if required
 	for (const PointerSettings & pointerSettings : fileSettings.getAllPointerSettings()) {
-		writeRecursivePointerValuePair(intermediaryText, pointerSettings, sourceJson);
+		currentFieldPath = pointerSettings.path;
+		if (ConfigProfiler::isEnabled()) {
+			auto visitStartTime = std::chrono::steady_clock::now();
+			writeRecursivePointerValuePair(intermediaryText, pointerSettings, sourceJson);
+			ConfigProfiler::recordVisit(parseStage, pointerSettings.profileId, std::chrono::steady_clock::now() - visitStartTime);
+		} else {
+			writeRecursivePointerValuePair(intermediaryText, pointerSettings, sourceJson);
+		}
 	}
 
 	intermediaryText << "\n}\n";
@@ -40,17 +66,33 @@ int JsonIntermediaryWriter::writeIntermediaryFile(std::stringstream & intermedia
 bool JsonIntermediaryWriter::writePointerValuePair(std::stringstream & intermediaryText, const PointerSettings & pointerSettings, const json & sourceJson) {
 	//Value path as JSON pointer.
 	const json::json_pointer valuePointer = json::json_pointer(pointerSettings.path);
+	const json * value = sourceJson.contains(valuePointer) ? &sourceJson[valuePointer] : nullptr;
+	//The value is in another asset the value at path refers to.
+	std::shared_ptr<const json> referencedJson;
+	if (value != nullptr && pointerSettings.resolvedPath != "") {
+		const json::json_pointer resolvedPointer = json::json_pointer(pointerSettings.resolvedPath);
+		if (assetIndex != nullptr && value->is_string()) referencedJson = assetIndex->resolveReference(value->get<std::string>(), assetPath);
+		value = referencedJson && referencedJson->contains(resolvedPointer) ? &(*referencedJson)[resolvedPointer] : nullptr;
+	}
+	const bool valuePresent = value != nullptr;
+	if (ConfigProfiler::isEnabled()) ConfigProfiler::recordLookup(parseStage, pointerSettings.profileId, valuePresent);
 	//Value present, copy.
-	if (sourceJson.contains(valuePointer)) {
+	if (valuePresent) {
 		writePointerValueStart(intermediaryText, pointerSettings);
+		if (recordValues && value->is_string()) allExtractedValues.push_back({currentFieldPath, pointerSettings.path, value->get<std::string>()});
 		intermediaryText << "  \"" << pointerSettings.path << "\" : ";
 		if(pointerSettings.convertBreakoutNewlines) {
-			std::string sourceJsonText = sourceJson[valuePointer];
+			std::string sourceJsonText = *value;
 			convertNewlineBreakoutsToNewline(sourceJsonText);
 			convertQuoteToBreakoutQuote(sourceJsonText);
 			intermediaryText << '"' << sourceJsonText << '"';
+		//Shared table reference.
+		} else if (internTable != nullptr && value->is_string()) {
+			const int internedId = internTable->intern(*value);
+			allInternedIds.push_back(internedId);
+			intermediaryText << "{\"internedValue\" : " << internedId << '}';
 		} else {
-			intermediaryText << sourceJson[valuePointer];
+			intermediaryText << *value;
 		}
 		//Continue iteration.
 		return true;
@@ -134,6 +176,7 @@ bool JsonIntermediaryWriter::writeRecursivePointerValuePair(std::stringstream &
 					modifiedPointerSettings.intermediaryLabel = modifiedIntermediaryLabel;
 				}
 
+				if (ConfigProfiler::isEnabled()) ConfigProfiler::recordExpansion(parseStage, pointerSettings.profileId);
 				index++;
 			//Recurse and get the result.
 			} while (writeRecursivePointerValuePair(intermediaryText, modifiedPointerSettings, sourceJson));
@@ -149,3 +192,15 @@ void JsonIntermediaryWriter::writePointerValueStart(std::stringstream & intermed
 	if (pointerSettings.intermediaryLabel != "") intermediaryText << "  //" + pointerSettings.intermediaryLabel + '\n';
 	totalIntermediaryValues++;
 }
+
+//Getters
+
+const std::vector<int> & JsonIntermediaryWriter::getInternedIds() { return allInternedIds; }
+const std::vector<ExtractedValue> & JsonIntermediaryWriter::getExtractedValues() { return allExtractedValues; }
+
+//Setters
+
+/**
+ * @param record If string values written should be kept for the value index.
+ */
+void JsonIntermediaryWriter::setRecordValues(bool record) { recordValues = record; }
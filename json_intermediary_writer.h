@@ -1,16 +1,34 @@
 #pragma once
 
 #include <sstream>
+#include <vector>
 #include <nlohmann/json.hpp>
+#include "asset_index.h"
 #include "parse_settings.h"
+#include "value_index.h"
+#include "value_intern_table.h"
 
 class JsonIntermediaryWriter {
 private:
 	int totalIntermediaryValues = 0;
+	ValueInternTable * internTable = nullptr;
+	AssetIndex * assetIndex = nullptr;
+	std::string assetPath;
+	std::vector<int> allInternedIds;
+	bool recordValues = false;
+	std::string currentFieldPath;
+	std::vector<ExtractedValue> allExtractedValues;
 	bool writePointerValuePair(std::stringstream & intermediaryText, const PointerSettings & pointerSettings, const nlohmann::json & sourceJson);
 	bool writeRecursivePointerValuePair(std::stringstream & intermediaryText, const PointerSettings & pointerSettings, const nlohmann::json & sourceJson);
 	void writePointerValueStart(std::stringstream & intermediaryText, const PointerSettings & pointerSettings);
 public:
 	JsonIntermediaryWriter();
+	JsonIntermediaryWriter(ValueInternTable * internTable);
+	JsonIntermediaryWriter(ValueInternTable * internTable, AssetIndex * assetIndex, std::string assetPath);
 	int writeIntermediaryFile(std::stringstream & intermediaryText, FileSettings & fileSettings, const nlohmann::json & sourceJson);
+	//Getters
+	const std::vector<int> & getInternedIds();
+	const std::vector<ExtractedValue> & getExtractedValues();
+	//Setters
+	void setRecordValues(bool record);
 };
@@ -0,0 +1,453 @@
+#include "json_parser.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "perf_counters.h"
+#ifdef SBPH_SIMDJSON
+#include <simdjson.h>
+#endif
+
+using json = nlohmann::json;
+
+std::atomic<jsonParserBackend> JsonParser::selectedBackend = nlohmannBackend;
+std::atomic<std::uint64_t> JsonParser::parallelParseBytes = 0;
+std::atomic<int> JsonParser::parallelParseThreads = 1;
+
+//Parts smaller than this are not worth a thread of their own.
+static const std::size_t minimumPartBytes = 64 * 1024;
+
+struct SplitPart;
+
+//An array or object whose elements are parsed in parts and put back together in order.
+struct SplitContainer {
+	bool isObject = false;
+	std::vector<SplitPart> allParts;
+};
+
+//A run of whole elements of a container parsed on their own, or a single large element split further.
+struct SplitPart {
+	std::size_t begin = 0;
+	std::size_t end = 0;
+	bool isSplit = false;
+	//The key of a split object member.
+	std::string key;
+	SplitContainer container;
+	json parsedJson;
+};
+
+//A document being parsed in parts, which any free helper thread may take parts of.
+struct PartsJob {
+	std::function<void()> parseParts;
+	//Helpers taking parts of it, only changed with the pool's mutex held.
+	int workingHelpers = 0;
+};
+
+//Helper threads shared by every document parsed in parts, so there are as many however many documents are parsed at once.
+class PartsHelperPool {
+private:
+	std::vector<std::thread> helpers;
+	std::deque<PartsJob *> pendingJobs;
+	std::mutex poolMutex;
+	std::condition_variable jobAdded;
+	std::condition_variable helperFinished;
+	bool stopping = false;
+
+	void runHelper();
+public:
+	~PartsHelperPool();
+	void parse(PartsJob & job, std::size_t helperCount);
+};
+
+static PartsHelperPool partsHelperPool;
+
+PartsHelperPool::~PartsHelperPool() {
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+	for (std::thread & helper : helpers) {
+		if (helper.joinable()) helper.join();
+	}
+}
+
+void PartsHelperPool::runHelper() {
+	std::unique_lock<std::mutex> lock(poolMutex);
+	while (true) {
+		jobAdded.wait(lock, [this] { return stopping || !pendingJobs.empty(); });
+		if (stopping) return;
+		//Free helpers all work on the oldest document until its parts run out.
+		PartsJob * job = pendingJobs.front();
+		job->workingHelpers++;
+		lock.unlock();
+		job->parseParts();
+		lock.lock();
+		auto jobPosition = std::find(pendingJobs.begin(), pendingJobs.end(), job);
+		if (jobPosition != pendingJobs.end()) pendingJobs.erase(jobPosition);
+		job->workingHelpers--;
+		helperFinished.notify_all();
+	}
+}
+
+/**
+ * Parses the parts of a document on the calling thread, with the help of any helpers not busy with other documents.
+ * 
+ * @param job The document, whose parts are all parsed when this returns.
+ * @param helperCount How many helpers the pool should have, started the first time they are needed.
+ */
+void PartsHelperPool::parse(PartsJob & job, std::size_t helperCount) {
+	{
+		std::lock_guard<std::mutex> lock(poolMutex);
+		while (helpers.size() < helperCount) helpers.emplace_back(&PartsHelperPool::runHelper, this);
+		pendingJobs.push_back(&job);
+	}
+	jobAdded.notify_all();
+	job.parseParts();
+
+	std::unique_lock<std::mutex> lock(poolMutex);
+	//Once out of the queue no more helpers can take it, so it is done when those already working on it are.
+	auto jobPosition = std::find(pendingJobs.begin(), pendingJobs.end(), &job);
+	if (jobPosition != pendingJobs.end()) pendingJobs.erase(jobPosition);
+	helperFinished.wait(lock, [&job] { return job.workingHelpers == 0; });
+}
+
+#ifdef SBPH_SIMDJSON
+/**
+ * Builds the nlohmann JSON value of a simdjson element. Numbers keep the types nlohmann itself would give them,
+ * so non-negative integers are unsigned, and later duplicate keys replace earlier ones.
+ */
+static json toNlohmannJson(simdjson::dom::element element) {
+	switch (element.type()) {
+		case simdjson::dom::element_type::OBJECT: {
+			json object = json::object();
+			json::object_t & members = object.get_ref<json::object_t &>();
+			for (simdjson::dom::key_value_pair field : simdjson::dom::object(element)) {
+				members.insert_or_assign(std::string(field.key), toNlohmannJson(field.value));
+			}
+			return object;
+		}
+		case simdjson::dom::element_type::ARRAY: {
+			const simdjson::dom::array elements = simdjson::dom::array(element);
+			json array = json::array();
+			json::array_t & values = array.get_ref<json::array_t &>();
+			values.reserve(elements.size());
+			for (simdjson::dom::element value : elements) {
+				values.push_back(toNlohmannJson(value));
+			}
+			return array;
+		}
+		case simdjson::dom::element_type::STRING:
+			return std::string(std::string_view(element));
+		case simdjson::dom::element_type::INT64: {
+			const std::int64_t value = int64_t(element);
+			if (value >= 0) return static_cast<std::uint64_t>(value);
+			return value;
+		}
+		case simdjson::dom::element_type::UINT64:
+			return uint64_t(element);
+		case simdjson::dom::element_type::DOUBLE:
+			return double(element);
+		case simdjson::dom::element_type::BOOL:
+			return bool(element);
+		default:
+			return nullptr;
+	}
+}
+
+/**
+ * Checks for an integer written as -0, which nlohmann keeps as a signed integer but simdjson gives no sign.
+ * Text inside strings may match too, which only costs parsing that document with nlohmann.
+ */
+static bool hasNegativeZeroInteger(const std::string & text) {
+	for (std::size_t position = text.find("-0"); position != std::string::npos; position = text.find("-0", position + 2)) {
+		const char next = position + 2 < text.size() ? text[position + 2] : ' ';
+		if (next != '.' && next != 'e' && next != 'E' && (next < '0' || next > '9')) return true;
+	}
+	return false;
+}
+#endif
+
+/**
+ * Selects the backend every JSON document is parsed with for the rest of the run. Should be called before any work starts.
+ * 
+ * @param backendName "nlohmann", or "simdjson" when built with SBPH_USE_SIMDJSON.
+ * @return If the backend is available.
+ */
+bool JsonParser::selectBackend(const std::string & backendName) {
+	if (backendName == "nlohmann") {
+		selectedBackend = nlohmannBackend;
+		return true;
+	}
+#ifdef SBPH_SIMDJSON
+	if (backendName == "simdjson") {
+		selectedBackend = simdjsonBackend;
+		return true;
+	}
+#endif
+	return false;
+}
+
+std::string JsonParser::getBackendName() {
+	return selectedBackend == simdjsonBackend ? "simdjson" : "nlohmann";
+}
+
+/**
+ * Lets large documents be split into parts parsed on several threads at once. Should be called before any work starts.
+ * 
+ * @param minimumBytes Documents at least this large are split, 0 to never split.
+ * @param threadCount How many threads may parse the parts of one document.
+ */
+void JsonParser::setParallelParse(std::uint64_t minimumBytes, int threadCount) {
+	parallelParseBytes = minimumBytes;
+	parallelParseThreads = std::max(threadCount, 1);
+}
+
+/**
+ * Parses standard JSON text with the selected backend. Comments must already be stripped.
+ * Text simdjson rejects, such as integers too large for 64 bits, and text with an integer -0 are parsed by nlohmann so results and errors match it.
+ * Large documents are parsed in parts on several threads, giving the same JSON.
+ * 
+ * @param text The JSON text.
+ * @return The parsed JSON.
+ */
+json JsonParser::parse(const std::string & text) {
+	const std::uint64_t minimumBytes = parallelParseBytes.load(std::memory_order_relaxed);
+	if (minimumBytes > 0 && text.size() >= minimumBytes && parallelParseThreads.load(std::memory_order_relaxed) > 1) {
+		json parsedJson;
+		if (parseInParts(text, parsedJson)) return parsedJson;
+	}
+	return parseWhole(text);
+}
+
+json JsonParser::parseWhole(const std::string & text) {
+#ifdef SBPH_SIMDJSON
+	if (selectedBackend == simdjsonBackend) {
+		//Parsers reuse their buffers, so one is kept per thread.
+		thread_local simdjson::dom::parser parser;
+		simdjson::dom::element root;
+		if (!hasNegativeZeroInteger(text) && parser.parse(text).get(root) == simdjson::SUCCESS) return toNlohmannJson(root);
+	}
+#endif
+	return json::parse(text);
+}
+
+
+static std::size_t skipWhitespace(const std::string & text, std::size_t position) {
+	while (position < text.size() && (text[position] == ' ' || text[position] == '\t' || text[position] == '\n' || text[position] == '\r')) position++;
+	return position;
+}
+
+/**
+ * Finds the end of a string without decoding it.
+ * 
+ * @param text The JSON text.
+ * @param quote The position of the opening quote.
+ * @return The position of the closing quote, or the text's size if there is none.
+ */
+static std::size_t findStringEnd(const std::string & text, std::size_t quote) {
+	const char * data = text.data();
+	std::size_t position = quote + 1;
+	while (position < text.size()) {
+		const char * found = static_cast<const char *>(std::memchr(data + position, '"', text.size() - position));
+		if (found == nullptr) return text.size();
+		position = found - data;
+		//A quote after an odd number of backslashes is escaped.
+		std::size_t backslashes = 0;
+		while (data[position - backslashes - 1] == '\\') backslashes++;
+		if (backslashes % 2 == 0) return position;
+		position++;
+	}
+	return text.size();
+}
+
+/**
+ * Splits an array or object into runs of whole elements about a part's size, finding where elements start and end without parsing them.
+ * Elements larger than a part that are containers themselves are split too.
+ * 
+ * @param text The JSON text.
+ * @param open The position of the opening bracket or brace.
+ * @param partBytes The size to aim for with each part.
+ * @param container Receives the parts.
+ * @param close Receives the position of the matching closing bracket or brace.
+ * @return If the container could be split, false if it is malformed and the whole text should be parsed to report the error.
+ */
+static bool splitContainer(const std::string & text, std::size_t open, std::size_t partBytes, SplitContainer & container, std::size_t & close) {
+	container.isObject = text[open] == '{';
+	const char closeCharacter = container.isObject ? '}' : ']';
+
+	//Adds the element between two separators.
+	auto addElement = [&](std::size_t elementBegin, std::size_t elementEnd) {
+		elementBegin = skipWhitespace(text, elementBegin);
+		while (elementEnd > elementBegin && (text[elementEnd - 1] == ' ' || text[elementEnd - 1] == '\t' || text[elementEnd - 1] == '\n' || text[elementEnd - 1] == '\r')) elementEnd--;
+		if (elementBegin == elementEnd) return false;
+
+		if (elementEnd - elementBegin > partBytes) {
+			//Object members are a key, a colon and the value.
+			std::size_t valueBegin = elementBegin;
+			std::size_t keyEnd = elementBegin;
+			if (container.isObject) {
+				if (text[elementBegin] != '"') return false;
+				keyEnd = findStringEnd(text, elementBegin);
+				if (keyEnd >= elementEnd) return false;
+				valueBegin = skipWhitespace(text, keyEnd + 1);
+				if (valueBegin >= elementEnd || text[valueBegin] != ':') return false;
+				valueBegin = skipWhitespace(text, valueBegin + 1);
+			}
+			if (elementEnd - valueBegin > partBytes && (text[valueBegin] == '[' || text[valueBegin] == '{')) {
+				SplitPart part;
+				part.begin = elementBegin;
+				part.end = elementEnd;
+				part.isSplit = true;
+				if (container.isObject) {
+					try {
+						part.key = json::parse(text.begin() + elementBegin, text.begin() + keyEnd + 1).get<std::string>();
+					} catch (const json::exception &) {
+						return false;
+					}
+				}
+				//The value has to end where the element does.
+				std::size_t valueClose = 0;
+				if (!splitContainer(text, valueBegin, partBytes, part.container, valueClose) || valueClose + 1 != elementEnd) return false;
+				container.allParts.push_back(std::move(part));
+				return true;
+			}
+		}
+
+		if (container.allParts.empty() || container.allParts.back().isSplit || container.allParts.back().end - container.allParts.back().begin >= partBytes) {
+			SplitPart part;
+			part.begin = elementBegin;
+			part.end = elementEnd;
+			container.allParts.push_back(std::move(part));
+		} else {
+			container.allParts.back().end = elementEnd;
+		}
+		return true;
+	};
+
+	int depth = 0;
+	std::size_t elementBegin = open + 1;
+	for (std::size_t position = open + 1; position < text.size(); position++) {
+		switch (text[position]) {
+			case '"':
+				position = findStringEnd(text, position);
+				if (position >= text.size()) return false;
+				break;
+			case '[':
+			case '{':
+				depth++;
+				break;
+			case ']':
+			case '}':
+				if (depth > 0) {
+					depth--;
+					break;
+				}
+				if (text[position] != closeCharacter) return false;
+				//Only an empty container may have nothing after the last comma.
+				if (!addElement(elementBegin, position) && (!container.allParts.empty() || skipWhitespace(text, elementBegin) != position)) return false;
+				close = position;
+				return true;
+			case ',':
+				if (depth > 0) break;
+				if (!addElement(elementBegin, position)) return false;
+				elementBegin = position + 1;
+				break;
+		}
+	}
+	return false;
+}
+
+static void findUnsplitParts(SplitContainer & container, std::vector<std::pair<SplitPart *, bool>> & allUnsplitParts) {
+	for (SplitPart & part : container.allParts) {
+		if (part.isSplit) {
+			findUnsplitParts(part.container, allUnsplitParts);
+		} else {
+			allUnsplitParts.push_back({&part, container.isObject});
+		}
+	}
+}
+
+/**
+ * Puts the parsed parts of a container back together in order. Later duplicate keys replace earlier ones, as when parsing it whole.
+ */
+static json joinContainer(SplitContainer & container) {
+	json joined = container.isObject ? json::object() : json::array();
+	for (SplitPart & part : container.allParts) {
+		if (part.isSplit) {
+			json value = joinContainer(part.container);
+			if (container.isObject) {
+				joined[part.key] = std::move(value);
+			} else {
+				joined.push_back(std::move(value));
+			}
+		} else if (joined.empty()) {
+			joined = std::move(part.parsedJson);
+		} else if (container.isObject) {
+			//Members already in the later part are kept, so moving the joined members into it keeps the last of any duplicate key.
+			part.parsedJson.get_ref<json::object_t &>().merge(joined.get_ref<json::object_t &>());
+			joined = std::move(part.parsedJson);
+		} else {
+			json::array_t & joinedArray = joined.get_ref<json::array_t &>();
+			json::array_t & partArray = part.parsedJson.get_ref<json::array_t &>();
+			joinedArray.insert(joinedArray.end(), std::make_move_iterator(partArray.begin()), std::make_move_iterator(partArray.end()));
+		}
+	}
+	return joined;
+}
+
+/**
+ * Splits a document at the boundaries of its top level elements, and those of any element too large for one part,
+ * then parses the parts on this thread and the shared helpers and joins them into the same JSON parsing it whole would give.
+ * 
+ * @param text The JSON text.
+ * @param parsedJson Receives the parsed JSON.
+ * @return If the document was parsed, false if it could not be split or a part failed so it should be parsed whole instead.
+ */
+bool JsonParser::parseInParts(const std::string & text, json & parsedJson) {
+	const std::size_t root = skipWhitespace(text, 0);
+	if (root >= text.size() || (text[root] != '[' && text[root] != '{')) return false;
+	const int threadCount = parallelParseThreads.load(std::memory_order_relaxed);
+	const std::size_t partBytes = std::max(text.size() / threadCount, minimumPartBytes);
+
+	SplitContainer rootContainer;
+	std::size_t close = 0;
+	if (!splitContainer(text, root, partBytes, rootContainer, close)) return false;
+	if (skipWhitespace(text, close + 1) != text.size()) return false;
+	std::vector<std::pair<SplitPart *, bool>> allUnsplitParts;
+	findUnsplitParts(rootContainer, allUnsplitParts);
+	if (allUnsplitParts.size() < 2) return false;
+
+	//Each part is parsed as a container of its own elements.
+	std::atomic<std::size_t> nextPart = 0;
+	std::atomic<bool> failed = false;
+	PartsJob job;
+	job.parseParts = [&]() {
+		CounterScope counterScope = CounterScope(parseJsonCounterStage);
+		for (std::size_t partIndex = nextPart++; partIndex < allUnsplitParts.size() && !failed; partIndex = nextPart++) {
+			auto & [part, isObject] = allUnsplitParts[partIndex];
+			std::string partText;
+			partText.reserve(part->end - part->begin + 2);
+			partText += isObject ? '{' : '[';
+			partText.append(text, part->begin, part->end - part->begin);
+			partText += isObject ? '}' : ']';
+			try {
+				part->parsedJson = parseWhole(partText);
+			} catch (...) {
+				failed = true;
+			}
+		}
+	};
+	partsHelperPool.parse(job, threadCount - 1);
+	if (failed) return false;
+
+	parsedJson = joinContainer(rootContainer);
+	return true;
+}
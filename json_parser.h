@@ -0,0 +1,25 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <nlohmann/json.hpp>
+
+enum jsonParserBackend {
+	nlohmannBackend,
+	simdjsonBackend
+};
+
+class JsonParser {
+private:
+	static std::atomic<jsonParserBackend> selectedBackend;
+	static std::atomic<std::uint64_t> parallelParseBytes;
+	static std::atomic<int> parallelParseThreads;
+	static nlohmann::json parseWhole(const std::string & text);
+	static bool parseInParts(const std::string & text, nlohmann::json & parsedJson);
+public:
+	static bool selectBackend(const std::string & backendName);
+	static std::string getBackendName();
+	static void setParallelParse(std::uint64_t minimumBytes, int threadCount);
+	static nlohmann::json parse(const std::string & text);
+};
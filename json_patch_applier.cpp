@@ -0,0 +1,94 @@
+#include "json_patch_applier.h"
+
+using json = nlohmann::json;
+
+//Thrown when a test operation fails. Starbound skips the operation set, or the whole patch if it has no sets.
+struct PatchTestFailure { };
+
+/**
+ * Applies a test operation the way Starbound does, including inverse tests.
+ * 
+ * @param document The JSON being patched.
+ * @param operation The test operation.
+ */
+static void applyTestOperation(const json & document, const json & operation) {
+	const json::json_pointer pointer = json::json_pointer(operation.at("path").get<std::string>());
+	const bool inverse = operation.contains("inverse") && operation["inverse"].is_boolean() && operation["inverse"].get<bool>();
+	if (!document.contains(pointer)) {
+		if (inverse) return;
+		throw PatchTestFailure();
+	}
+	if (operation.contains("value")) {
+		const bool equal = document.at(pointer) == operation["value"];
+		if (inverse ? equal : !equal) throw PatchTestFailure();
+		return;
+	}
+	if (inverse) throw PatchTestFailure();
+}
+
+/**
+ * Applies a list of operations as one unit. Nothing is changed unless every operation succeeds.
+ * 
+ * @param document The JSON being patched.
+ * @param operations The operations to apply.
+ */
+static void applyOperations(json & document, const json & operations) {
+	//Tests that come before any change can be checked in place, which avoids copying the document for typical sets.
+	std::size_t firstChange = 0;
+	while (firstChange < operations.size() && operations[firstChange].value("op", "") == "test") {
+		applyTestOperation(document, operations[firstChange]);
+		firstChange++;
+	}
+	if (firstChange == operations.size()) return;
+
+	//A single change either succeeds or throws before changing anything.
+	if (firstChange + 1 == operations.size() && operations[firstChange].value("op", "") != "move") {
+		document.patch_inplace(json::array({operations[firstChange]}));
+		return;
+	}
+
+	json patchedDocument = document;
+	for (std::size_t i = firstChange; i < operations.size(); i++) {
+		if (operations[i].value("op", "") == "test") {
+			applyTestOperation(patchedDocument, operations[i]);
+		} else {
+			patchedDocument.patch_inplace(json::array({operations[i]}));
+		}
+	}
+	document = std::move(patchedDocument);
+}
+
+/**
+ * Applies a Starbound patch file to a JSON document. Patches may be a list of operations or a list of operation sets.
+ * A failed test skips its operation set, or the whole patch if it has no sets. Any other failure stops the patch,
+ * keeping the operation sets already applied.
+ * 
+ * @param document The JSON to patch.
+ * @param patchJson The parsed patch file.
+ * @param error Set to a description of the failure if the patch could not be applied.
+ * @return How many operation sets were applied, -1 if the patch failed.
+ */
+int applyStarboundPatch(json & document, const json & patchJson, std::string & error) {
+	if (!patchJson.is_array() || patchJson.empty()) return 0;
+	const bool usesOperationSets = patchJson[0].is_array();
+	int totalApplied = 0;
+	try {
+		if (usesOperationSets) {
+			for (const json & operationSet : patchJson) {
+				try {
+					applyOperations(document, operationSet);
+					totalApplied++;
+				} catch (const PatchTestFailure &) { }
+			}
+		} else {
+			try {
+				applyOperations(document, patchJson);
+				totalApplied++;
+			} catch (const PatchTestFailure &) { }
+		}
+	} catch (const json::exception & exception) {
+		error = exception.what();
+		return -1;
+	}
+	return totalApplied;
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <string>
+#include <nlohmann/json.hpp>
+
+int applyStarboundPatch(nlohmann::json & document, const nlohmann::json & patchJson, std::string & error);
@@ -1,5 +1,8 @@
 #include "json_patch_writer.h"
 
+#include "config_profiler.h"
+#include "patch_operation_optimiser.h"
+#include "perf_counters.h"
 #include "utilities.h"
 
 using json = nlohmann::json;
@@ -8,6 +11,7 @@ JsonPatchWriter::JsonPatchWriter(MasterSettings masterSettings) {
 	baselinePatchStyle = masterSettings.baselinePatchStyle;
 	useInverseTestOps = masterSettings.getUseInverseTestOps();
 	useOperationSets = masterSettings.getUseOperationSets();
+	optimisePatchOperations = masterSettings.getOptimisePatchOperations();
 }
 
 /**
@@ -20,6 +24,7 @@ JsonPatchWriter::JsonPatchWriter(MasterSettings masterSettings) {
  * @return How many values the resulting patch will add or replace.
  */
 int JsonPatchWriter::writePatchFile(std::stringstream & patchText, FileSettings & fileSettings, const json & sourceJson, const json & intermediaryJson) {
+	CounterScope counterScope = CounterScope(makePatchCounterStage);
 	indentModifier = baselinePatchStyle.getIndentationInOuterBrackets() ? 1 : 0;
 	currentOps = 0;
 	currentOpSets = 0;
@@ -35,12 +40,35 @@ int JsonPatchWriter::writePatchFile(std::stringstream & patchText, FileSettings
 	patchText << '[';
 	if (baselinePatchStyle.getNewLineAfterOuterOpenerBracket()) patchText << std::endl;
 
-	//TODO: if only one op set in a patch skip set brackets (configurable)
-	//Write operation sets
+	//Collect operation sets
+	allOperationSets.clear();
 	for (const PointerSettings & pointerSettings : fileSettings.getAllPointerSettings()) {
 		if (!pointerSettings.reference) {
-			writeRecursiveOperationSet(patchText, pointerSettings, sourceJson, intermediaryJson);
+			if (ConfigProfiler::isEnabled()) {
+				auto visitStartTime = std::chrono::steady_clock::now();
+				writeRecursiveOperationSet(pointerSettings, sourceJson, intermediaryJson);
+				ConfigProfiler::recordVisit(patchStage, pointerSettings.profileId, std::chrono::steady_clock::now() - visitStartTime);
+			} else {
+				writeRecursiveOperationSet(pointerSettings, sourceJson, intermediaryJson);
+			}
+		}
+	}
+
+	//Merge and trim operation sets where doing so does not change how the patch applies.
+	const bool writeSetBrackets = useOperationSets;
+	if (optimisePatchOperations && useOperationSets) {
+		optimiseOperationSets(allOperationSets);
+		//A lone operation set does not need its own brackets.
+		if (allOperationSets.size() == 1) useOperationSets = false;
+	}
+
+	//Write operation sets
+	for (const OperationSet & operationSet : allOperationSets) {
+		writeOperationSetOpener(patchText);
+		for (const PatchOperation & operation : operationSet) {
+			writeOperation(patchText, operation.path, operation.value, operation.operation);
 		}
+		writeOperationSetCloser(patchText);
 	}
 
 	//New line after the last operation set closer.
@@ -50,45 +78,44 @@ int JsonPatchWriter::writePatchFile(std::stringstream & patchText, FileSettings
 	patchText << ']';
 	if (baselinePatchStyle.getNewLineAfterOuterCloserBracket()) patchText << std::endl;
 
+	useOperationSets = writeSetBrackets;
 	return currentOpSets;
 }
 
-bool JsonPatchWriter::writeOperationSet(std::stringstream & patchText, const PointerSettings & pointerSettings, const json & sourceJson, const json & intermediaryJson) {
+bool JsonPatchWriter::writeOperationSet(const PointerSettings & pointerSettings, const json & sourceJson, const json & intermediaryJson) {
 	//Value path as JSON pointer.
 	const json::json_pointer valuePointer = json::json_pointer(pointerSettings.path);
 
+	const bool intermediaryValuePresent = intermediaryJson.contains(pointerSettings.path);
+	if (ConfigProfiler::isEnabled()) ConfigProfiler::recordLookup(patchStage, pointerSettings.profileId, intermediaryValuePresent);
 	//Intermediary value found.
-	if (intermediaryJson.contains(pointerSettings.path)) {
+	if (intermediaryValuePresent) {
 		//Intermediary value is placeholder.
 		if (intermediaryJson[pointerSettings.path] == "") {
 			//Operation if placeholder is not none and source value not found.
 			if (pointerSettings.patchOperationIfPlaceholder == none || !sourceJson.contains(valuePointer)) {
 				//Patch operation if placeholder set to copy.
 				if (pointerSettings.patchOperationIfPlaceholder == copy) {
-					writeOperationSetOpener(patchText);
+					openOperationSet();
 
 					if (pointerSettings.patchTestOperation && useInverseTestOps) {
-						writeOperation(patchText, pointerSettings.from, "false", testInverse);
+						addOperation(pointerSettings.from, "false", testInverse);
 						
-						writeOperation(patchText, pointerSettings.path, "true", testInverse);
+						addOperation(pointerSettings.path, "true", testInverse);
 					}
 
-					writeOperation(patchText, pointerSettings.from, pointerSettings.path, copyValue);
-
-					writeOperationSetCloser(patchText);
+					addOperation(pointerSettings.from, pointerSettings.path, copyValue);
 				//Patch operation if placeholder set to move.
 				} else if (pointerSettings.patchOperationIfPlaceholder == move) {
-					writeOperationSetOpener(patchText);
+					openOperationSet();
 
 					if (pointerSettings.patchTestOperation && useInverseTestOps) {
-						writeOperation(patchText, pointerSettings.from, "false", testInverse);
+						addOperation(pointerSettings.from, "false", testInverse);
 
-						writeOperation(patchText, pointerSettings.path, "true", testInverse);
+						addOperation(pointerSettings.path, "true", testInverse);
 					}
 
-					writeOperation(patchText, pointerSettings.from, pointerSettings.path, moveValue);
-
-					writeOperationSetCloser(patchText);
+					addOperation(pointerSettings.from, pointerSettings.path, moveValue);
 				}
 			}
 		//Intermediary value is not placeholder
@@ -97,44 +124,38 @@ bool JsonPatchWriter::writeOperationSet(std::stringstream & patchText, const Poi
 			if (sourceJson.contains(valuePointer)) {
 				//Remove if equals is not blank and the source value matches it.
 				if (pointerSettings.patchRemoveIfEquals != "" && sourceJson[valuePointer].dump() == pointerSettings.patchRemoveIfEquals) {
-					writeOperationSetOpener(patchText);
+					openOperationSet();
 
 					if (pointerSettings.patchTestOperation) {
 						std::string sourceValueContents = sourceJson[valuePointer].dump();
 						if (pointerSettings.convertBreakoutNewlines) convertNewlineBreakoutsToNewline(sourceValueContents);
-						writeOperation(patchText, pointerSettings.path, sourceValueContents, testValue);
+						addOperation(pointerSettings.path, sourceValueContents, testValue);
 					}
 
-					writeOperation(patchText, pointerSettings.path, "", removeValue);
-
-					writeOperationSetCloser(patchText);
+					addOperation(pointerSettings.path, "", removeValue);
 				//Intermediary value different from source value.
 				} else if (intermediaryJson[pointerSettings.path] != sourceJson[valuePointer]) {
-					writeOperationSetOpener(patchText);
+					openOperationSet();
 
 					if (pointerSettings.patchTestOperation) {
 						std::string sourceValueContents = sourceJson[valuePointer].dump();
 						if (pointerSettings.convertBreakoutNewlines) convertNewlineBreakoutsToNewline(sourceValueContents);
-						writeOperation(patchText, pointerSettings.path, sourceValueContents, testValue);
+						addOperation(pointerSettings.path, sourceValueContents, testValue);
 					}
 
 					std::string intermediaryValueContents = intermediaryJson[pointerSettings.path].dump();
 					if (pointerSettings.convertBreakoutNewlines) convertNewlineBreakoutsToNewline(intermediaryValueContents);
-					writeOperation(patchText, pointerSettings.path, intermediaryValueContents, replaceValue);
-
-					writeOperationSetCloser(patchText);
+					addOperation(pointerSettings.path, intermediaryValueContents, replaceValue);
 				}
 			//Source value not found.
 			} else {
-				writeOperationSetOpener(patchText);
+				openOperationSet();
 
-				if (pointerSettings.patchTestOperation && useInverseTestOps) writeOperation(patchText, pointerSettings.path, "true", testInverse);
+				if (pointerSettings.patchTestOperation && useInverseTestOps) addOperation(pointerSettings.path, "true", testInverse);
 
 				std::string intermediaryValueContents = intermediaryJson[pointerSettings.path].dump();
 				if (pointerSettings.convertBreakoutNewlines) convertNewlineBreakoutsToNewline(intermediaryValueContents);
-				writeOperation(patchText, pointerSettings.path, intermediaryValueContents, addValue);
-
-				writeOperationSetCloser(patchText);
+				addOperation(pointerSettings.path, intermediaryValueContents, addValue);
 			}
 		}
 		//Continue iteration.
@@ -144,7 +165,7 @@ bool JsonPatchWriter::writeOperationSet(std::stringstream & patchText, const Poi
 	return false;
 }
 
-bool JsonPatchWriter::writeRecursiveOperationSet(std::stringstream & patchText, const PointerSettings & pointerSettings, const json & sourceJson, const json & intermediaryJson) {
+bool JsonPatchWriter::writeRecursiveOperationSet(const PointerSettings & pointerSettings, const json & sourceJson, const json & intermediaryJson) {
 	//Check if there is a marker configured.
 	if (pointerSettings.numericIteratorMarker != "" && (pointerSettings.intermediaryPlaceholderCondition != fromExists || pointerSettings.from != "")) {
 		//Check if there is a marker position in path.
@@ -189,14 +210,23 @@ bool JsonPatchWriter::writeRecursiveOperationSet(std::stringstream & patchText,
 					}
 				}
 
+				if (ConfigProfiler::isEnabled()) ConfigProfiler::recordExpansion(patchStage, pointerSettings.profileId);
 				index++;
 			//Recurse and get the result.
-			} while (writeRecursiveOperationSet(patchText, modifiedPointerSettings, sourceJson, intermediaryJson));
+			} while (writeRecursiveOperationSet(modifiedPointerSettings, sourceJson, intermediaryJson));
 			return true;
 		}
 	}
 	//There is no marker to replace.
-	return writeOperationSet(patchText, pointerSettings, sourceJson, intermediaryJson);
+	return writeOperationSet(pointerSettings, sourceJson, intermediaryJson);
+}
+
+void JsonPatchWriter::openOperationSet() {
+	allOperationSets.emplace_back();
+}
+
+void JsonPatchWriter::addOperation(std::string path, std::string value, patchOperation operation) {
+	allOperationSets.back().push_back({operation, path, value});
 }
 
 void JsonPatchWriter::writeOperation(std::stringstream & patchText, std::string path, std::string value, patchOperation operation) {
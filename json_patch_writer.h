@@ -1,6 +1,8 @@
 #pragma once
 
 #include <sstream>
+#include <string>
+#include <vector>
 #include "global_settings.h"
 #include "parse_settings.h"
 
@@ -14,17 +16,31 @@ enum patchOperation {
 	testInverse
 };
 
+struct PatchOperation {
+	patchOperation operation;
+	//The from path for copy and move.
+	std::string path;
+	//The destination path for copy and move.
+	std::string value;
+};
+
+typedef std::vector<PatchOperation> OperationSet;
+
 class JsonPatchWriter {
 private:
 	PatchStyleSettings baselinePatchStyle;
 	bool useInverseTestOps;
 	bool useOperationSets;
+	bool optimisePatchOperations;
 	int indentModifier;
 	int currentOps;
 	int currentOpSets;
+	std::vector<OperationSet> allOperationSets;
 	
-	bool writeOperationSet(std::stringstream & patchText, const PointerSettings & pointerSettings, const nlohmann::json & sourceJson, const nlohmann::json & intermediaryJson);
-	bool writeRecursiveOperationSet(std::stringstream & patchText, const PointerSettings & pointerSettings, const nlohmann::json & sourceJson, const nlohmann::json & intermediaryJson);
+	bool writeOperationSet(const PointerSettings & pointerSettings, const nlohmann::json & sourceJson, const nlohmann::json & intermediaryJson);
+	bool writeRecursiveOperationSet(const PointerSettings & pointerSettings, const nlohmann::json & sourceJson, const nlohmann::json & intermediaryJson);
+	void openOperationSet();
+	void addOperation(std::string path, std::string value, patchOperation operation);
 	void writeOperation(std::stringstream & patchText, std::string path, std::string value, patchOperation operation);
 	void writeOperationSetOpener(std::stringstream & patchText);
 	void writeOperationSetCloser(std::stringstream & patchText);
@@ -0,0 +1,116 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+MappedFile::MappedFile() { }
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+/**
+ * Maps a file into memory as read only.
+ * 
+ * @param filePath The path of the file to map.
+ * @return If the file was mapped.
+ */
+bool MappedFile::open(fs::path filePath) {
+	close();
+#ifdef _WIN32
+	HANDLE file = CreateFileW(filePath.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize)) {
+		CloseHandle(file);
+		return false;
+	}
+	fileHandle = file;
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+	//Empty files can not be mapped, but are still valid.
+	if (size == 0) return true;
+	mappingHandle = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr) {
+		close();
+		return false;
+	}
+	data = static_cast<const char *>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+	if (data == nullptr) {
+		close();
+		return false;
+	}
+#else
+	fileDescriptor = ::open(filePath.c_str(), O_RDONLY);
+	if (fileDescriptor < 0) return false;
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0) {
+		close();
+		return false;
+	}
+	size = static_cast<std::size_t>(fileStat.st_size);
+	//Empty files can not be mapped, but are still valid.
+	if (size == 0) return true;
+	void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (mapping == MAP_FAILED) {
+		close();
+		return false;
+	}
+	data = static_cast<const char *>(mapping);
+#endif
+	return true;
+}
+
+/**
+ * Unmaps the file if one is mapped.
+ */
+void MappedFile::close() {
+#ifdef _WIN32
+	if (data != nullptr) UnmapViewOfFile(data);
+	if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+	if (fileHandle != nullptr) CloseHandle(fileHandle);
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+#else
+	if (data != nullptr) munmap(const_cast<char *>(data), size);
+	if (fileDescriptor >= 0) ::close(fileDescriptor);
+	fileDescriptor = -1;
+#endif
+	data = nullptr;
+	size = 0;
+}
+
+/**
+ * @return If a file is currently mapped.
+ */
+const bool MappedFile::isOpen() {
+#ifdef _WIN32
+	return fileHandle != nullptr;
+#else
+	return fileDescriptor >= 0;
+#endif
+}
+
+/**
+ * Gets a view of part of the mapped file. Out of range requests are clamped.
+ * 
+ * @param offset The byte offset the view starts at.
+ * @param length The length of the view in bytes.
+ * @return A view into the mapped file.
+ */
+std::string_view MappedFile::getView(std::size_t offset, std::size_t length) {
+	if (data == nullptr || offset >= size) return std::string_view();
+	if (length > size - offset) length = size - offset;
+	return std::string_view(data + offset, length);
+}
+
+const std::size_t MappedFile::getSize() { return size; }
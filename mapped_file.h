@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string_view>
+
+class MappedFile {
+private:
+	const char * data = nullptr;
+	std::size_t size = 0;
+#ifdef _WIN32
+	void * fileHandle = nullptr;
+	void * mappingHandle = nullptr;
+#else
+	int fileDescriptor = -1;
+#endif
+public:
+	MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile & operator=(const MappedFile &) = delete;
+	~MappedFile();
+	bool open(std::filesystem::path filePath);
+	void close();
+	const bool isOpen();
+	//Getters
+	std::string_view getView(std::size_t offset, std::size_t length);
+	const std::size_t getSize();
+};
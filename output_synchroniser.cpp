@@ -0,0 +1,103 @@
+#include "output_synchroniser.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "perf_counters.h"
+#include "utilities.h"
+
+namespace fs = std::filesystem;
+
+/**
+ * Updates an existing output folder in place. Files whose contents would not change are left untouched,
+ * so their modification times stay the same for packers and syncing tools.
+ * Safe to use from several threads at once.
+ * 
+ * @param outputPath The output folder.
+ */
+OutputSynchroniser::OutputSynchroniser(fs::path outputPath) : outputPath(outputPath) { }
+
+/**
+ * Writes a file unless it already has the same contents, and keeps it from being removed as stale.
+ * 
+ * @param filePath Where to write the file, inside the output folder.
+ * @param text The file contents.
+ * @return If the file has the contents afterwards.
+ */
+bool OutputSynchroniser::writeFile(const fs::path & filePath, std::string_view text) {
+	{
+		std::lock_guard<std::mutex> lock(keptMutex);
+		keptFiles.insert(filePath.lexically_normal().string());
+	}
+	if (hasContent(filePath, text)) {
+		totalUnchanged++;
+		return true;
+	}
+	std::stringstream textStream;
+	textStream << text;
+	if (!writeStringStreamToPath(textStream, filePath)) return false;
+	totalWritten++;
+	return true;
+}
+
+/**
+ * @return If the file exists with exactly the text. The size is compared first so most changed files are never read.
+ */
+bool OutputSynchroniser::hasContent(const fs::path & filePath, std::string_view text) {
+	CounterScope counterScope = CounterScope(writeCounterStage);
+	std::error_code error;
+	const std::uintmax_t fileSize = fs::file_size(filePath, error);
+	if (error || fileSize != text.size()) return false;
+	std::ifstream file(filePath, std::ios::binary);
+	if (!file.is_open()) return false;
+	std::vector<char> buffer(65536);
+	std::size_t offset = 0;
+	while (offset < text.size()) {
+		file.read(buffer.data(), std::min(buffer.size(), text.size() - offset));
+		const std::size_t bytesRead = file.gcount();
+		if (bytesRead == 0 || std::memcmp(buffer.data(), text.data() + offset, bytesRead) != 0) return false;
+		offset += bytesRead;
+	}
+	return true;
+}
+
+/**
+ * Removes files that were not written this run, then any folders they leave empty.
+ * 
+ * @param isOwned If a file could have been written this run. Files outside of it, such as ones filtered out or not made by this tool, are kept.
+ * @return How many files were removed.
+ */
+int OutputSynchroniser::removeStaleFiles(const std::function<bool(const fs::path &)> & isOwned) {
+	if (!fs::is_directory(outputPath)) return 0;
+	std::vector<fs::path> allFolders;
+	std::vector<fs::path> staleFiles;
+	std::error_code error;
+	for (const fs::directory_entry & entry : fs::recursive_directory_iterator(outputPath, error)) {
+		if (entry.is_directory()) {
+			allFolders.push_back(entry.path());
+		} else if (!keptFiles.contains(entry.path().lexically_normal().string()) && isOwned(entry.path())) {
+			staleFiles.push_back(entry.path());
+		}
+	}
+	int totalRemoved = 0;
+	//Only folders a file was removed from, or their parents, are cleared, so empty folders kept on purpose stay.
+	std::unordered_set<std::string> allEmptiedFolders;
+	for (const fs::path & staleFile : staleFiles) {
+		if (!fs::remove(staleFile, error)) continue;
+		totalRemoved++;
+		for (fs::path folder = staleFile.parent_path(); folder != outputPath && folder.has_relative_path(); folder = folder.parent_path()) {
+			if (!allEmptiedFolders.insert(folder.lexically_normal().string()).second) break;
+		}
+	}
+	//Deepest folders come last, so remove in reverse to clear nested empty folders.
+	for (auto folder = allFolders.rbegin(); folder != allFolders.rend(); folder++) {
+		if (allEmptiedFolders.contains(folder->lexically_normal().string()) && fs::is_empty(*folder, error)) fs::remove(*folder, error);
+	}
+	return totalRemoved;
+}
+
+//Getters
+const int OutputSynchroniser::getWrittenCount() { return totalWritten; }
+const int OutputSynchroniser::getUnchangedCount() { return totalUnchanged; }
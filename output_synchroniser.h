@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+
+class OutputSynchroniser {
+private:
+	std::filesystem::path outputPath;
+	std::unordered_set<std::string> keptFiles;
+	std::mutex keptMutex;
+	std::atomic<int> totalWritten = 0;
+	std::atomic<int> totalUnchanged = 0;
+
+	static bool hasContent(const std::filesystem::path & filePath, std::string_view text);
+public:
+	OutputSynchroniser(std::filesystem::path outputPath);
+	bool writeFile(const std::filesystem::path & filePath, std::string_view text);
+	int removeStaleFiles(const std::function<bool(const std::filesystem::path &)> & isOwned);
+	//Getters
+	const int getWrittenCount();
+	const int getUnchangedCount();
+};
@@ -0,0 +1,156 @@
+#include "pak_reader.h"
+
+#include <cstring>
+#include <stdexcept>
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+//Reads the big endian values Starbound uses in asset packages.
+class PakStream {
+private:
+	std::string_view data;
+	std::size_t position = 0;
+public:
+	PakStream(std::string_view data, std::size_t position) : data(data), position(position) { }
+
+	std::string_view readBytes(std::size_t length) {
+		if (length > data.length() - position) throw std::out_of_range("Unexpected end of asset package.");
+		std::string_view bytes = data.substr(position, length);
+		position += length;
+		return bytes;
+	}
+
+	std::uint8_t readByte() {
+		return static_cast<std::uint8_t>(readBytes(1)[0]);
+	}
+
+	std::uint64_t readUint64() {
+		std::uint64_t value = 0;
+		for (char byte : readBytes(8)) value = (value << 8) | static_cast<std::uint8_t>(byte);
+		return value;
+	}
+
+	std::uint64_t readVlqU() {
+		std::uint64_t value = 0;
+		for (int i = 0; i < 10; i++) {
+			const std::uint8_t byte = readByte();
+			value = (value << 7) | (byte & 0x7f);
+			if ((byte & 0x80) == 0) return value;
+		}
+		throw std::out_of_range("Invalid variable length number in asset package.");
+	}
+
+	std::int64_t readVlqI() {
+		const std::uint64_t value = readVlqU();
+		if (value & 1) return -static_cast<std::int64_t>(value >> 1) - 1;
+		return static_cast<std::int64_t>(value >> 1);
+	}
+
+	std::string readString() {
+		return std::string(readBytes(readVlqU()));
+	}
+
+	json readJson() {
+		switch (readByte()) {
+		case 1:
+			return nullptr;
+		case 2: {
+			const std::uint64_t bits = readUint64();
+			double value;
+			static_assert(sizeof(value) == sizeof(bits));
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		case 3:
+			return readByte() != 0;
+		case 4:
+			return readVlqI();
+		case 5:
+			return readString();
+		case 6: {
+			json arrayJson = json::array();
+			for (std::uint64_t count = readVlqU(); count > 0; count--) arrayJson.push_back(readJson());
+			return arrayJson;
+		}
+		case 7: {
+			json objectJson = json::object();
+			for (std::uint64_t count = readVlqU(); count > 0; count--) {
+				std::string key = readString();
+				objectJson[key] = readJson();
+			}
+			return objectJson;
+		}
+		default:
+			throw std::out_of_range("Invalid JSON type in asset package.");
+		}
+	}
+};
+
+PakReader::PakReader() { }
+
+/**
+ * Maps a Starbound asset package into memory and loads its index.
+ * 
+ * @param pakPath The path of the .pak file.
+ * @return If the package was valid and could be read.
+ */
+bool PakReader::open(fs::path pakPath) {
+	metadata = json::object();
+	allEntries.clear();
+	allAssetPaths.clear();
+	if (!pakFile.open(pakPath)) return false;
+
+	const std::string_view pakData = pakFile.getView(0, pakFile.getSize());
+	try {
+		PakStream headerStream = PakStream(pakData, 0);
+		if (headerStream.readBytes(8) != "SBAsset6") return false;
+		const std::uint64_t indexOffset = headerStream.readUint64();
+		if (indexOffset >= pakData.length()) return false;
+
+		PakStream indexStream = PakStream(pakData, indexOffset);
+		if (indexStream.readBytes(5) != "INDEX") return false;
+		for (std::uint64_t count = indexStream.readVlqU(); count > 0; count--) {
+			std::string key = indexStream.readString();
+			metadata[key] = indexStream.readJson();
+		}
+		const std::uint64_t fileCount = indexStream.readVlqU();
+		allAssetPaths.reserve(fileCount);
+		allEntries.reserve(fileCount);
+		for (std::uint64_t i = 0; i < fileCount; i++) {
+			std::string assetPath = indexStream.readString();
+			PakEntry entry;
+			entry.offset = indexStream.readUint64();
+			entry.size = indexStream.readUint64();
+			allEntries[assetPath] = entry;
+			allAssetPaths.push_back(std::move(assetPath));
+		}
+	} catch (const std::out_of_range &) {
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @param assetPath The asset path, starting with a forward slash.
+ * @return If the package contains the asset.
+ */
+const bool PakReader::contains(const std::string & assetPath) {
+	return allEntries.contains(assetPath);
+}
+
+/**
+ * Gets the contents of an asset without copying it.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @return The contents of the asset, empty if the package does not contain it.
+ */
+std::string_view PakReader::fetchText(const std::string & assetPath) {
+	auto found = allEntries.find(assetPath);
+	if (found == allEntries.end()) return std::string_view();
+	return pakFile.getView(found->second.offset, found->second.size);
+}
+
+const json & PakReader::getMetadata() { return metadata; }
+const std::vector<std::string> & PakReader::getAllAssetPaths() { return allAssetPaths; }
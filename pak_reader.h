@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "mapped_file.h"
+
+struct PakEntry {
+	std::uint64_t offset = 0;
+	std::uint64_t size = 0;
+};
+
+class PakReader {
+private:
+	MappedFile pakFile;
+	nlohmann::json metadata;
+	std::unordered_map<std::string, PakEntry> allEntries;
+	std::vector<std::string> allAssetPaths;
+public:
+	PakReader();
+	bool open(std::filesystem::path pakPath);
+	const bool contains(const std::string & assetPath);
+	std::string_view fetchText(const std::string & assetPath);
+	//Getters
+	const nlohmann::json & getMetadata();
+	const std::vector<std::string> & getAllAssetPaths();
+};
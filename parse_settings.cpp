@@ -1,6 +1,8 @@
 #include "parse_settings.h"
 
+#include <algorithm>
 #include <iostream>
+#include "config_profiler.h"
 #include "utilities.h"
 
 using json = nlohmann::json;
@@ -9,8 +11,20 @@ namespace fs = std::filesystem;
 
 FileSettings::FileSettings(fs::path settingsPath) {
 	fileExtension = '.' + settingsPath.stem().string();
-	json settingsJson = fetchJson(settingsPath);
+	loadSettings(fetchJson(settingsPath), settingsPath.string());
+}
+
+/**
+ * Loads settings without touching the file system.
+ * 
+ * @param fileExtension The file extension the settings are for, such as ".object".
+ * @param settingsJson The parse target JSON, laid out like the files in parse_targets.
+ */
+FileSettings::FileSettings(std::string fileExtension, json settingsJson) : fileExtension(fileExtension) {
+	loadSettings(settingsJson, fileExtension);
+}
 
+void FileSettings::loadSettings(json settingsJson, const std::string & configName) {
 	if (settingsJson.contains("addPatchMakersComment")) {
 		addPatchMakersComment = settingsJson["addPatchMakersComment"];
 	}
@@ -40,6 +54,11 @@ FileSettings::FileSettings(fs::path settingsPath) {
 				if (valuesJson.contains("convertBreakoutNewlines")) {
 					pointerSettings.convertBreakoutNewlines = valuesJson["convertBreakoutNewlines"];
 				}
+				if (valuesJson.contains("resolvedPath")) {
+					pointerSettings.resolvedPath = valuesJson["resolvedPath"];
+					//Values from other assets can not be patched through this one.
+					pointerSettings.reference = true;
+				}
 				if (valuesJson.contains("intermediaryPlaceholderCondition")) {
 					std::string value = valuesJson["intermediaryPlaceholderCondition"];
 					if (value == "never") {
@@ -74,6 +93,7 @@ FileSettings::FileSettings(fs::path settingsPath) {
 					pointerSettings.patchRemoveIfEquals = valuesJson["patchRemoveIfEquals"].dump();
 					
 				}
+				pointerSettings.profileId = ConfigProfiler::registerPointer(configName, pointerSettings.path);
 				allPointerSettings.push_back(pointerSettings);
 			}
 		}
@@ -96,9 +116,105 @@ const bool FileSettings::hasPointerSettings() {
 	return allPointerSettings.size() >= 1;
 }
 
+/**
+ * @return If any pointerSettings take their value from another asset.
+ */
+const bool FileSettings::hasResolvedPointers() {
+	for (const PointerSettings & pointerSettings : allPointerSettings) {
+		if (pointerSettings.resolvedPath != "") return true;
+	}
+	return false;
+}
+
+/**
+ * Adds the values of another parse target for the same file extension, so both are patched from one plan.
+ * Values whose path is already configured are skipped, so the first target wins.
+ * 
+ * @param targetSettings The settings of the other parse target.
+ */
+void FileSettings::mergeTarget(FileSettings & targetSettings) {
+	std::unordered_set<std::string> allPaths;
+	for (const PointerSettings & pointerSettings : allPointerSettings) allPaths.insert(pointerSettings.path);
+	for (const PointerSettings & pointerSettings : targetSettings.allPointerSettings) {
+		if (allPaths.insert(pointerSettings.path).second) allPointerSettings.push_back(pointerSettings);
+	}
+	addPatchMakersComment = addPatchMakersComment || targetSettings.addPatchMakersComment;
+	valuesContainNewlines = valuesContainNewlines || targetSettings.valuesContainNewlines;
+}
+
 //Getters
 
 const std::string FileSettings::getFileExtension() { return fileExtension; }
+const std::string FileSettings::getTargetName() { return targetName; }
 const bool FileSettings::getAddPatchMakersComment() { return addPatchMakersComment; }
 const bool FileSettings::getValuesContainNewlines() { return valuesContainNewlines; }
 std::vector<PointerSettings> FileSettings::getAllPointerSettings() { return allPointerSettings; }
+
+//Setters
+
+/**
+ * @param name The parse target the settings belong to, the folder in parse_targets they were loaded from.
+ */
+void FileSettings::setTargetName(std::string name) { targetName = name; }
+
+/**
+ * @param allFileSettings The settings of every configured file type.
+ * @return Every configured file extension.
+ */
+std::unordered_set<std::string> getAllFileExtensions(std::vector<FileSettings> & allFileSettings) {
+	std::unordered_set<std::string> allExtensions;
+	for (FileSettings & fileSettings : allFileSettings) {
+		allExtensions.insert(fileSettings.getFileExtension());
+	}
+	return allExtensions;
+}
+
+/**
+ * @param allFileSettings The settings of every configured file type.
+ * @return The name of every parse target, sorted.
+ */
+std::vector<std::string> getAllTargetNames(std::vector<FileSettings> & allFileSettings) {
+	std::vector<std::string> allTargetNames;
+	for (FileSettings & fileSettings : allFileSettings) {
+		if (std::find(allTargetNames.begin(), allTargetNames.end(), fileSettings.getTargetName()) == allTargetNames.end()) {
+			allTargetNames.push_back(fileSettings.getTargetName());
+		}
+	}
+	std::sort(allTargetNames.begin(), allTargetNames.end());
+	return allTargetNames;
+}
+
+/**
+ * @param allFileSettings The settings of every configured file type and parse target.
+ * @return One settings per file extension with the values of every parse target for it, in target name order.
+ */
+std::vector<FileSettings> mergeTargetsByExtension(std::vector<FileSettings> & allFileSettings) {
+	std::vector<FileSettings *> sortedFileSettings;
+	for (FileSettings & fileSettings : allFileSettings) sortedFileSettings.push_back(&fileSettings);
+	std::stable_sort(sortedFileSettings.begin(), sortedFileSettings.end(), [](FileSettings * a, FileSettings * b) {
+		return a->getTargetName() < b->getTargetName();
+	});
+
+	std::vector<FileSettings> mergedFileSettings;
+	for (FileSettings * fileSettings : sortedFileSettings) {
+		auto merged = std::find_if(mergedFileSettings.begin(), mergedFileSettings.end(), [&](FileSettings & mergedSettings) {
+			return mergedSettings.getFileExtension() == fileSettings->getFileExtension();
+		});
+		if (merged != mergedFileSettings.end()) {
+			merged->mergeTarget(*fileSettings);
+		} else {
+			mergedFileSettings.push_back(*fileSettings);
+			mergedFileSettings.back().setTargetName("");
+		}
+	}
+	return mergedFileSettings;
+}
+
+/**
+ * @param targetName The parse target, empty when there is only one.
+ * @param assetPath The asset path, starting with a forward slash.
+ * @return Where the intermediary file of the asset goes relative to the intermediary asset folder, such as "/localization/objects/chair.object".
+ */
+std::string getTargetIntermediaryPath(const std::string & targetName, const std::string & assetPath) {
+	return targetName.empty() ? assetPath : '/' + targetName + assetPath;
+}
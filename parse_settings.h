@@ -1,7 +1,10 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
+#include <unordered_set>
 #include <vector>
+#include <nlohmann/json.hpp>
 
 enum placeholderCondition {
 	never,
@@ -22,6 +25,9 @@ struct PointerSettings {
 	std::string numericIteratorMarker = "";
 	bool reference = false;
 	bool convertBreakoutNewlines = false;
+	int profileId = -1;
+	//Pointer into the asset the value at path refers to, such as an item name or asset path.
+	std::string resolvedPath = "";
 	//Intermediary.
 	placeholderCondition intermediaryPlaceholderCondition = never;
 	std::string intermediaryLabel = "";
@@ -34,16 +40,33 @@ struct PointerSettings {
 class FileSettings {
 private:
 	std::string fileExtension;
+	std::string targetName;
 	bool addPatchMakersComment = false;
 	bool valuesContainNewlines = false;
 	std::vector<PointerSettings> allPointerSettings;
+
+	void loadSettings(nlohmann::json settingsJson, const std::string & configName);
 public:
 	FileSettings(std::filesystem::path settingsPath);
+	FileSettings(std::string fileExtension, nlohmann::json settingsJson);
 	void writeExampleSettings(std::stringstream & settingsText);
 	const bool hasPointerSettings();
+	const bool hasResolvedPointers();
+	void mergeTarget(FileSettings & targetSettings);
 	//Getters
 	const std::string getFileExtension();
+	const std::string getTargetName();
 	const bool getAddPatchMakersComment();
 	const bool getValuesContainNewlines();
 	std::vector<PointerSettings> getAllPointerSettings();
+	//Setters
+	void setTargetName(std::string name);
 };
+
+std::unordered_set<std::string> getAllFileExtensions(std::vector<FileSettings> & allFileSettings);
+
+std::vector<std::string> getAllTargetNames(std::vector<FileSettings> & allFileSettings);
+
+std::vector<FileSettings> mergeTargetsByExtension(std::vector<FileSettings> & allFileSettings);
+
+std::string getTargetIntermediaryPath(const std::string & targetName, const std::string & assetPath);
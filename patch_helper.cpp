@@ -0,0 +1,97 @@
+#include "patch_helper.h"
+
+#include <sstream>
+#include "json_intermediary_writer.h"
+#include "utilities.h"
+
+using json = nlohmann::json;
+
+/**
+ * Makes intermediary files and patches from buffers for use inside other programs. Nothing is read from or written to the file system.
+ * Safe to use from several threads at once.
+ * 
+ * @param masterSettings The settings patches are made with, such as from MasterSettings(json, PatchStyleSettings(json)).
+ * @param allFileSettings The settings of every file type, such as from FileSettings(".object", json).
+ */
+PatchHelper::PatchHelper(MasterSettings masterSettings, std::vector<FileSettings> allFileSettings) : allFileSettings(allFileSettings), basePatchWriter(masterSettings) { }
+
+/**
+ * @param assetPath The asset path or file name.
+ * @return The settings for the asset's file extension, null if it is not configured.
+ */
+FileSettings * PatchHelper::findFileSettings(const std::string & assetPath) {
+	const std::size_t dotPosition = assetPath.rfind('.');
+	if (dotPosition == std::string::npos) return nullptr;
+	const std::string extension = assetPath.substr(dotPosition);
+	for (FileSettings & fileSettings : allFileSettings) {
+		if (fileSettings.getFileExtension() == extension) return &fileSettings;
+	}
+	return nullptr;
+}
+
+/**
+ * Makes the intermediary text of an asset.
+ * 
+ * @param intermediaryText Set to the intermediary text.
+ * @param assetPath The asset path, used to pick the file settings.
+ * @param sourceText The source asset text, which may contain comments.
+ * @return How many values the intermediary text contains, -1 if the file type is not configured.
+ */
+int PatchHelper::makeIntermediary(std::string & intermediaryText, const std::string & assetPath, std::string_view sourceText) {
+	FileSettings * fileSettings = findFileSettings(assetPath);
+	if (fileSettings == nullptr) return -1;
+	return makeIntermediaryFromJson(intermediaryText, assetPath, parseJsonText(std::string(sourceText), fileSettings->getValuesContainNewlines()));
+}
+
+/**
+ * Makes the intermediary text of an already parsed asset.
+ * 
+ * @param intermediaryText Set to the intermediary text.
+ * @param assetPath The asset path, used to pick the file settings.
+ * @param sourceJson The parsed source asset.
+ * @return How many values the intermediary text contains, -1 if the file type is not configured.
+ */
+int PatchHelper::makeIntermediaryFromJson(std::string & intermediaryText, const std::string & assetPath, const json & sourceJson) {
+	FileSettings * fileSettings = findFileSettings(assetPath);
+	if (fileSettings == nullptr) return -1;
+	std::stringstream intermediaryStream;
+	JsonIntermediaryWriter intermediaryWriter;
+	const int totalValues = intermediaryWriter.writeIntermediaryFile(intermediaryStream, *fileSettings, sourceJson);
+	intermediaryText = intermediaryStream.str();
+	return totalValues;
+}
+
+/**
+ * Makes the patch text of an asset.
+ * 
+ * @param patchText Set to the patch text, empty if nothing needs patching.
+ * @param assetPath The asset path, used to pick the file settings.
+ * @param sourceText The source asset text, which may contain comments.
+ * @param intermediaryText The edited intermediary text, which may contain comments.
+ * @return How many operation sets the patch contains, -1 if the file type is not configured.
+ */
+int PatchHelper::makePatch(std::string & patchText, const std::string & assetPath, std::string_view sourceText, std::string_view intermediaryText) {
+	FileSettings * fileSettings = findFileSettings(assetPath);
+	if (fileSettings == nullptr) return -1;
+	const bool valuesHaveNewlines = fileSettings->getValuesContainNewlines();
+	return makePatchFromJson(patchText, assetPath, parseJsonText(std::string(sourceText), valuesHaveNewlines), parseJsonText(std::string(intermediaryText), valuesHaveNewlines));
+}
+
+/**
+ * Makes the patch text of an already parsed asset.
+ * 
+ * @param patchText Set to the patch text, empty if nothing needs patching.
+ * @param assetPath The asset path, used to pick the file settings.
+ * @param sourceJson The parsed source asset.
+ * @param intermediaryJson The parsed edited intermediary.
+ * @return How many operation sets the patch contains, -1 if the file type is not configured.
+ */
+int PatchHelper::makePatchFromJson(std::string & patchText, const std::string & assetPath, const json & sourceJson, const json & intermediaryJson) {
+	FileSettings * fileSettings = findFileSettings(assetPath);
+	if (fileSettings == nullptr) return -1;
+	std::stringstream patchStream;
+	JsonPatchWriter patchWriter = basePatchWriter;
+	const int totalOps = patchWriter.writePatchFile(patchStream, *fileSettings, sourceJson, intermediaryJson);
+	patchText = totalOps > 0 ? patchStream.str() : "";
+	return totalOps;
+}
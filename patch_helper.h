@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "global_settings.h"
+#include "json_patch_writer.h"
+#include "parse_settings.h"
+
+class PatchHelper {
+private:
+	std::vector<FileSettings> allFileSettings;
+	JsonPatchWriter basePatchWriter;
+public:
+	PatchHelper(MasterSettings masterSettings, std::vector<FileSettings> allFileSettings);
+	FileSettings * findFileSettings(const std::string & assetPath);
+	int makeIntermediary(std::string & intermediaryText, const std::string & assetPath, std::string_view sourceText);
+	int makeIntermediaryFromJson(std::string & intermediaryText, const std::string & assetPath, const nlohmann::json & sourceJson);
+	int makePatch(std::string & patchText, const std::string & assetPath, std::string_view sourceText, std::string_view intermediaryText);
+	int makePatchFromJson(std::string & patchText, const std::string & assetPath, const nlohmann::json & sourceJson, const nlohmann::json & intermediaryJson);
+};
@@ -0,0 +1,200 @@
+#include "patch_operation_optimiser.h"
+
+#include <cctype>
+#include <set>
+#include <string>
+
+//Starbound skips an operation set when one of its tests fails, but any other failed operation fails the whole patch file.
+//Sets are only merged or trimmed when every test would still pass or fail together with the same operations.
+
+/**
+ * @param path A JSON pointer.
+ * @return If the last segment of the pointer is an array index or the array end marker.
+ */
+static bool endsWithArrayIndex(const std::string & path) {
+	const std::size_t lastSlash = path.rfind('/');
+	if (lastSlash == std::string::npos || lastSlash + 1 == path.length()) return false;
+	const std::string segment = path.substr(lastSlash + 1);
+	if (segment == "-") return true;
+	for (char character : segment) {
+		if (!std::isdigit(static_cast<unsigned char>(character))) return false;
+	}
+	return true;
+}
+
+/**
+ * @param first A JSON pointer.
+ * @param second A JSON pointer.
+ * @return If either pointer is the other or one of its parents.
+ */
+static bool pathsOverlap(const std::string & first, const std::string & second) {
+	if (first.length() == second.length()) return first == second;
+	const std::string & shorter = first.length() < second.length() ? first : second;
+	const std::string & longer = first.length() < second.length() ? second : first;
+	return longer.compare(0, shorter.length(), shorter) == 0 && longer[shorter.length()] == '/';
+}
+
+/**
+ * Gets every path an operation may change. Inserting or removing array elements shifts their siblings, so the whole array counts as changed.
+ * 
+ * @param operation The operation to check.
+ * @return The changed paths, empty for tests.
+ */
+static std::vector<std::string> getChangedPaths(const PatchOperation & operation) {
+	auto changedPath = [](const std::string & path) {
+		return endsWithArrayIndex(path) ? path.substr(0, path.rfind('/')) : path;
+	};
+	switch (operation.operation) {
+	case replaceValue:
+		return {operation.path};
+	case addValue:
+	case removeValue:
+		return {changedPath(operation.path)};
+	case copyValue:
+		return {changedPath(operation.value)};
+	case moveValue:
+		return {changedPath(operation.path), changedPath(operation.value)};
+	default:
+		return {};
+	}
+}
+
+/**
+ * @param operation A test operation.
+ * @return A key that is identical for tests that check the same thing.
+ */
+static std::string getTestKey(const PatchOperation & operation) {
+	if (operation.operation == testInverse) {
+		return (operation.value == "true" ? "absent:" : "present:") + operation.path;
+	}
+	return "value:" + operation.path + '\n' + operation.value;
+}
+
+/**
+ * Tracks which tests are known to pass at a point in an operation set.
+ */
+struct KnownTests {
+	std::set<std::string> allTestKeys;
+	std::set<std::string> allTestPaths;
+
+	bool implies(const PatchOperation & operation) {
+		if (allTestKeys.contains(getTestKey(operation))) return true;
+		//A value test also shows the value is present.
+		if (operation.operation == testInverse && operation.value != "true") {
+			for (const std::string & testKey : allTestKeys) {
+				if (testKey.starts_with("value:" + operation.path + '\n')) return true;
+			}
+		}
+		return false;
+	}
+
+	void add(const PatchOperation & operation) {
+		allTestKeys.insert(getTestKey(operation));
+		allTestPaths.insert(operation.path);
+	}
+
+	void invalidate(const PatchOperation & operation) {
+		for (const std::string & changedPath : getChangedPaths(operation)) {
+			for (auto testPath = allTestPaths.begin(); testPath != allTestPaths.end();) {
+				if (pathsOverlap(*testPath, changedPath)) {
+					for (auto testKey = allTestKeys.begin(); testKey != allTestKeys.end();) {
+						const std::size_t keyPathStart = testKey->find(':') + 1;
+						const std::string keyPath = testKey->substr(keyPathStart, testKey->find('\n', keyPathStart) - keyPathStart);
+						if (keyPath == *testPath) {
+							testKey = allTestKeys.erase(testKey);
+						} else {
+							++testKey;
+						}
+					}
+					testPath = allTestPaths.erase(testPath);
+				} else {
+					++testPath;
+				}
+			}
+		}
+	}
+};
+
+/**
+ * Removes tests that an earlier test in the same set already implies, as long as nothing between them changed the tested path.
+ * 
+ * @param operationSet The operation set to trim.
+ * @return The tests left in the set, before any other operation ran.
+ */
+static std::set<std::string> removeImpliedTests(OperationSet & operationSet) {
+	std::set<std::string> leadingTestKeys;
+	KnownTests knownTests;
+	bool onlyTestsSoFar = true;
+	OperationSet trimmedSet;
+	for (const PatchOperation & operation : operationSet) {
+		if (operation.operation == testValue || operation.operation == testInverse) {
+			if (knownTests.implies(operation)) continue;
+			knownTests.add(operation);
+			if (onlyTestsSoFar) leadingTestKeys.insert(getTestKey(operation));
+		} else {
+			onlyTestsSoFar = false;
+			knownTests.invalidate(operation);
+		}
+		trimmedSet.push_back(operation);
+	}
+	operationSet = std::move(trimmedSet);
+	return leadingTestKeys;
+}
+
+/**
+ * @param operationSet An operation set.
+ * @return If every test in the set comes before any other operation.
+ */
+static bool testsLead(const OperationSet & operationSet) {
+	bool onlyTestsSoFar = true;
+	for (const PatchOperation & operation : operationSet) {
+		const bool isTest = operation.operation == testValue || operation.operation == testInverse;
+		if (isTest && !onlyTestsSoFar) return false;
+		if (!isTest) onlyTestsSoFar = false;
+	}
+	return true;
+}
+
+/**
+ * @param operationSet An operation set.
+ * @param testedSet The operation set whose tests should be checked.
+ * @return If any operation in the set changes a path tested by the tested set.
+ */
+static bool changesTestedPaths(const OperationSet & operationSet, const OperationSet & testedSet) {
+	for (const PatchOperation & operation : operationSet) {
+		for (const std::string & changedPath : getChangedPaths(operation)) {
+			for (const PatchOperation & testedOperation : testedSet) {
+				if ((testedOperation.operation == testValue || testedOperation.operation == testInverse) && pathsOverlap(testedOperation.path, changedPath)) return true;
+			}
+		}
+	}
+	return false;
+}
+
+/**
+ * Merges and trims operation sets without changing what happens when the patch is applied.
+ * Neighbouring sets are merged when they test exactly the same things and the first set does not change what is tested,
+ * which includes sets that have no tests at all. Tests already implied by an earlier test in the same set are removed.
+ * 
+ * @param allOperationSets The operation sets of a patch, in the order they are applied.
+ */
+void optimiseOperationSets(std::vector<OperationSet> & allOperationSets) {
+	std::vector<OperationSet> optimisedSets;
+	std::set<std::string> previousTestKeys;
+	for (OperationSet & operationSet : allOperationSets) {
+		std::set<std::string> testKeys = removeImpliedTests(operationSet);
+		if (!optimisedSets.empty()) {
+			OperationSet & previousSet = optimisedSets.back();
+			if (testKeys == previousTestKeys && testsLead(previousSet) && testsLead(operationSet) && !changesTestedPaths(previousSet, previousSet)) {
+				//Every test in this set was already made by the previous set, so only the other operations are kept.
+				for (PatchOperation & operation : operationSet) {
+					if (operation.operation != testValue && operation.operation != testInverse) previousSet.push_back(std::move(operation));
+				}
+				continue;
+			}
+		}
+		previousTestKeys = testKeys;
+		optimisedSets.push_back(std::move(operationSet));
+	}
+	allOperationSets = std::move(optimisedSets);
+}
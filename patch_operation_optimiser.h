@@ -0,0 +1,6 @@
+#pragma once
+
+#include <vector>
+#include "json_patch_writer.h"
+
+void optimiseOperationSets(std::vector<OperationSet> & allOperationSets);
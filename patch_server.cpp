@@ -0,0 +1,261 @@
+#include "patch_server.h"
+
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "asset_scheduler.h"
+#include "json_intermediary_writer.h"
+#include "user_interaction_helper.h"
+#include "utilities.h"
+#ifndef _WIN32
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+//JSON-RPC error codes.
+const int parseErrorCode = -32700;
+const int invalidRequestCode = -32600;
+const int methodNotFoundCode = -32601;
+const int invalidParamsCode = -32602;
+const int assetErrorCode = -32000;
+
+/**
+ * Thrown by methods to send an error response.
+ */
+struct RequestError {
+	int code;
+	std::string message;
+};
+
+/**
+ * Answers requests from other programs, such as editors, while keeping settings and parsed source assets in memory.
+ * 
+ * @param masterSettings The settings patches are made with.
+ * @param allFileSettings The settings of every configured file type.
+ * @param sourceLayers The source layers assets are loaded from. Every loaded asset is kept until invalidated.
+ */
+PatchServer::PatchServer(MasterSettings masterSettings, std::vector<FileSettings> allFileSettings, SourceLayers * sourceLayers)
+	: allFileSettings(allFileSettings), sourceLayers(sourceLayers), assetIndex(sourceLayers, AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads())), basePatchWriter(masterSettings) {
+	sourceLayers->setCacheUnpatchedAssets(true);
+}
+
+/**
+ * Listens on a Unix domain socket until a shutdown request. Every connection is served on its own thread,
+ * with one JSON-RPC 2.0 request per line and one response per line.
+ * 
+ * @param socketPath Where to create the socket. An existing socket there is replaced.
+ * @return If the socket could be created.
+ */
+bool PatchServer::run(fs::path socketPath) {
+#ifdef _WIN32
+	std::cout << "Serving is only supported on systems with Unix domain sockets.\n";
+	return false;
+#else
+	sockaddr_un address = {};
+	address.sun_family = AF_UNIX;
+	if (socketPath.string().length() >= sizeof(address.sun_path)) {
+		std::cout << "Socket path is too long:\n"
+			<< socketPath.string() << std::endl;
+		return false;
+	}
+	std::snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath.c_str());
+
+	listenSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenSocket < 0) return false;
+	unlink(socketPath.c_str());
+	if (bind(listenSocket, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || listen(listenSocket, 16) != 0) {
+		std::cout << "Failed to listen on:\n"
+			<< socketPath.string() << std::endl;
+		close(listenSocket);
+		return false;
+	}
+	//A client closing before reading its response should only end its own connection.
+	std::signal(SIGPIPE, SIG_IGN);
+	std::cout << "Serving at:\n"
+		<< socketPath.string() << std::endl;
+
+	int nextConnectionId = 0;
+	while (!stopping) {
+		const int connectionSocket = accept(listenSocket, nullptr, nullptr);
+		if (connectionSocket < 0) {
+			if (stopping) break;
+			continue;
+		}
+		if (stopping) {
+			close(connectionSocket);
+			break;
+		}
+		joinFinishedConnections();
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		const int connectionId = nextConnectionId++;
+		allOpenSockets[connectionId] = connectionSocket;
+		allConnectionThreads.emplace(connectionId, std::thread(&PatchServer::serveConnection, this, connectionId, connectionSocket));
+	}
+	//Every connection has to end before the server and the source layers it uses go away.
+	closeConnections();
+	close(listenSocket);
+	unlink(socketPath.c_str());
+	std::cout << "Stopped serving.\n";
+	return true;
+#endif
+}
+
+void PatchServer::serveConnection(int connectionId, int connectionSocket) {
+#ifndef _WIN32
+	std::string pending;
+	char buffer[65536];
+	while (true) {
+		const ssize_t bytesRead = read(connectionSocket, buffer, sizeof(buffer));
+		if (bytesRead <= 0) break;
+		pending.append(buffer, bytesRead);
+		//Answer every complete line.
+		std::size_t lineEnd;
+		while ((lineEnd = pending.find('\n')) != std::string::npos) {
+			const std::string requestText = pending.substr(0, lineEnd);
+			pending.erase(0, lineEnd + 1);
+			if (requestText.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+			const std::string responseText = handleRequest(requestText).dump() + '\n';
+			std::size_t bytesWritten = 0;
+			while (bytesWritten < responseText.length()) {
+				const ssize_t written = write(connectionSocket, responseText.data() + bytesWritten, responseText.length() - bytesWritten);
+				if (written <= 0) break;
+				bytesWritten += written;
+			}
+		}
+		if (stopping) {
+			//Wake the accept loop so the server can exit.
+			shutdown(listenSocket, SHUT_RDWR);
+			break;
+		}
+	}
+	//Closed under the lock so closeConnections never shuts down a reused socket.
+	std::lock_guard<std::mutex> lock(connectionMutex);
+	allOpenSockets.erase(connectionId);
+	close(connectionSocket);
+	allFinishedConnections.push_back(connectionId);
+#endif
+}
+
+/**
+ * Joins the threads of connections that have ended, so a long running server does not keep one for every connection it served.
+ */
+void PatchServer::joinFinishedConnections() {
+	std::vector<std::thread> allFinishedThreads;
+	{
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		for (const int connectionId : allFinishedConnections) {
+			auto found = allConnectionThreads.find(connectionId);
+			if (found == allConnectionThreads.end()) continue;
+			allFinishedThreads.push_back(std::move(found->second));
+			allConnectionThreads.erase(found);
+		}
+		allFinishedConnections.clear();
+	}
+	for (std::thread & finishedThread : allFinishedThreads) finishedThread.join();
+}
+
+/**
+ * Ends every open connection and waits for its thread. Requests already being answered are finished first.
+ */
+void PatchServer::closeConnections() {
+#ifndef _WIN32
+	std::map<int, std::thread> allRemainingThreads;
+	{
+		std::lock_guard<std::mutex> lock(connectionMutex);
+		//Wakes threads waiting for a request.
+		for (const auto & [connectionId, connectionSocket] : allOpenSockets) shutdown(connectionSocket, SHUT_RDWR);
+		allRemainingThreads = std::move(allConnectionThreads);
+		allConnectionThreads.clear();
+		allFinishedConnections.clear();
+	}
+	for (auto & [connectionId, connectionThread] : allRemainingThreads) connectionThread.join();
+#endif
+}
+
+/**
+ * @param requestText A JSON-RPC 2.0 request.
+ * @return The JSON-RPC 2.0 response.
+ */
+json PatchServer::handleRequest(const std::string & requestText) {
+	json response = {{"jsonrpc", "2.0"}, {"id", nullptr}};
+	try {
+		json request;
+		try {
+			request = json::parse(requestText);
+		} catch (const json::parse_error & exception) {
+			throw RequestError{parseErrorCode, exception.what()};
+		}
+		if (!request.is_object() || !request.contains("method") || !request["method"].is_string()) throw RequestError{invalidRequestCode, "Expected a method."};
+		if (request.contains("id")) response["id"] = request["id"];
+		response["result"] = callMethod(request["method"], request.contains("params") ? request["params"] : json::object());
+	} catch (const RequestError & error) {
+		response["error"] = {{"code", error.code}, {"message", error.message}};
+	} catch (const std::exception & exception) {
+		response["error"] = {{"code", assetErrorCode}, {"message", exception.what()}};
+	}
+	return response;
+}
+
+/**
+ * Methods:
+ * extract {asset, target} gives the intermediary text of a source asset.
+ * generate {asset, intermediary, target} gives the patch text for an edited intermediary text.
+ * target is optional and picks the parse target when there are several, otherwise the first configured for the file type is used.
+ * invalidate {asset} forgets a source asset so it is loaded again, or every asset if asset is left out.
+ * shutdown stops the server.
+ */
+json PatchServer::callMethod(const std::string & method, const json & params) {
+	if (!params.is_object()) throw RequestError{invalidParamsCode, "Expected named params."};
+	if (method == "shutdown") {
+		stopping = true;
+		return true;
+	}
+	if (method == "invalidate") {
+		if (params.contains("asset") && params["asset"].is_string()) {
+			sourceLayers->invalidate(params["asset"]);
+			assetIndex.invalidate(params["asset"]);
+		} else {
+			sourceLayers->invalidateAll();
+			assetIndex.invalidateAll();
+		}
+		return true;
+	}
+	if (method != "extract" && method != "generate") throw RequestError{methodNotFoundCode, "Unknown method " + method + '.'};
+
+	if (!params.contains("asset") || !params["asset"].is_string()) throw RequestError{invalidParamsCode, "Expected an asset path."};
+	const std::string assetPath = params["asset"];
+	const std::string targetName = params.contains("target") && params["target"].is_string() ? params["target"].get<std::string>() : "";
+	FileSettings * fileSettings = findFileSettings(assetPath, targetName);
+	if (fileSettings == nullptr) throw RequestError{invalidParamsCode, "No parse target is configured for " + assetPath + '.'};
+	const std::shared_ptr<const json> sourceJson = sourceLayers->fetchSourceJson(assetPath, fileSettings->getValuesContainNewlines());
+	if (!sourceJson) throw RequestError{assetErrorCode, "Source asset " + assetPath + " not found."};
+
+	if (method == "extract") {
+		std::stringstream intermediaryText;
+		JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter(nullptr, &assetIndex, assetPath);
+		const int totalValues = intermediaryWriter.writeIntermediaryFile(intermediaryText, *fileSettings, *sourceJson);
+		return {{"intermediary", intermediaryText.str()}, {"values", totalValues}};
+	}
+
+	if (!params.contains("intermediary") || !params["intermediary"].is_string()) throw RequestError{invalidParamsCode, "Expected intermediary text."};
+	const json intermediaryJson = parseJsonText(params["intermediary"], fileSettings->getValuesContainNewlines());
+	std::stringstream patchText;
+	JsonPatchWriter patchWriter = basePatchWriter;
+	const int totalOps = patchWriter.writePatchFile(patchText, *fileSettings, *sourceJson, intermediaryJson);
+	return {{"patch", totalOps > 0 ? patchText.str() : ""}, {"operationSets", totalOps}};
+}
+
+FileSettings * PatchServer::findFileSettings(const std::string & assetPath, const std::string & targetName) {
+	const std::string extension = fs::path(assetPath).extension().string();
+	for (FileSettings & fileSettings : allFileSettings) {
+		if (fileSettings.getFileExtension() == extension && (targetName.empty() || fileSettings.getTargetName() == targetName)) return &fileSettings;
+	}
+	return nullptr;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "asset_index.h"
+#include "global_settings.h"
+#include "json_patch_writer.h"
+#include "parse_settings.h"
+#include "source_layers.h"
+
+class PatchServer {
+private:
+	std::vector<FileSettings> allFileSettings;
+	SourceLayers * sourceLayers = nullptr;
+	AssetIndex assetIndex;
+	JsonPatchWriter basePatchWriter;
+	std::atomic<bool> stopping = false;
+	int listenSocket = -1;
+	//Threads serving connections, their sockets while open and the connections that have finished, by connection id.
+	std::map<int, std::thread> allConnectionThreads;
+	std::map<int, int> allOpenSockets;
+	std::vector<int> allFinishedConnections;
+	std::mutex connectionMutex;
+
+	void serveConnection(int connectionId, int connectionSocket);
+	void joinFinishedConnections();
+	void closeConnections();
+	nlohmann::json handleRequest(const std::string & requestText);
+	nlohmann::json callMethod(const std::string & method, const nlohmann::json & params);
+	FileSettings * findFileSettings(const std::string & assetPath, const std::string & targetName);
+public:
+	PatchServer(MasterSettings masterSettings, std::vector<FileSettings> allFileSettings, SourceLayers * sourceLayers);
+	bool run(std::filesystem::path socketPath);
+};
@@ -18,6 +18,15 @@ PatchStyleSettings::PatchStyleSettings(std::filesystem::path settingsPath) {
 	}
 }
 
+/**
+ * Loads settings without touching the file system. Missing settings keep their defaults.
+ * 
+ * @param settingsJson The patch style JSON.
+ */
+PatchStyleSettings::PatchStyleSettings(json settingsJson) {
+	loadSettings(settingsJson);
+}
+
 void PatchStyleSettings::writeSettings(std::stringstream & settingsText) {
 	std::stringstream settingsJson;
 	settingsJson << '{'
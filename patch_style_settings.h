@@ -29,6 +29,7 @@ class PatchStyleSettings {
 public:
 	PatchStyleSettings();
 	PatchStyleSettings(std::filesystem::path settingsPath);
+	PatchStyleSettings(nlohmann::json settingsJson);
 	//Getters
 	const int getIndentationSpacesPerModifier();
 	//Outer wrapper brackets
@@ -0,0 +1,227 @@
+#include "perf_counters.h"
+#include "allocation_accounting.h"
+
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+//Counts are kept per thread and only merged when the report is written.
+struct ThreadCounters {
+	StageCounters allStageCounters[counterStageCount];
+};
+
+//The counters of the current thread, closed when it exits.
+struct LocalCounterFiles {
+	int allFileDescriptors[counterEventCount] = {-1, -1, -1, -1};
+	bool opened = false;
+
+	~LocalCounterFiles() {
+#ifdef __linux__
+		for (int fileDescriptor : allFileDescriptors) {
+			if (fileDescriptor >= 0) close(fileDescriptor);
+		}
+#endif
+	}
+};
+
+std::atomic<bool> PerfCounters::enabled = false;
+
+static std::mutex countersMutex;
+static std::vector<std::unique_ptr<ThreadCounters>> allThreadCounters;
+//Why each counter could not be opened, empty if it could be on every thread.
+static std::string allEventErrors[counterEventCount];
+thread_local ThreadCounters * localThreadCounters = nullptr;
+thread_local LocalCounterFiles localCounterFiles;
+thread_local int localScopeDepth = 0;
+
+/**
+ * @param stage A stage, or counterStageCount for work outside every stage.
+ * @return The name of the stage used in reports.
+ */
+std::string getCounterStageName(int stage) {
+	const std::string stageNames[counterStageCount + 1] = {"read", "strip comments", "parse JSON", "extract values", "make patch", "write", "other"};
+	return stage >= 0 && stage <= counterStageCount ? stageNames[stage] : "";
+}
+
+/**
+ * Enables counting for the rest of the run.
+ */
+void PerfCounters::enable() {
+	enabled = true;
+}
+
+/**
+ * @return If counting is enabled.
+ */
+const bool PerfCounters::isEnabled() {
+	return enabled.load(std::memory_order_relaxed);
+}
+
+/**
+ * Reads every counter of the current thread, opening them the first time. Counters that could not be opened read as 0.
+ * 
+ * @param allEventCounts Receives the count of every event, scaled up if the kernel had to share the hardware between counters.
+ * @return If any counter is available on this thread.
+ */
+bool PerfCounters::readLocalCounters(std::uint64_t * allEventCounts) {
+	if (!localCounterFiles.opened) {
+		localCounterFiles.opened = true;
+		for (int event = 0; event < counterEventCount; event++) {
+			std::string error;
+#ifdef __linux__
+			static const std::uint64_t allEventConfigs[counterEventCount] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+			perf_event_attr attributes;
+			std::memset(&attributes, 0, sizeof(attributes));
+			attributes.type = PERF_TYPE_HARDWARE;
+			attributes.size = sizeof(attributes);
+			attributes.config = allEventConfigs[event];
+			attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			//User space only, which perf_event_paranoid allows for a process's own threads by default.
+			attributes.exclude_kernel = 1;
+			attributes.exclude_hv = 1;
+			//This thread on any CPU.
+			localCounterFiles.allFileDescriptors[event] = static_cast<int>(syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0));
+			if (localCounterFiles.allFileDescriptors[event] < 0) error = std::strerror(errno);
+#else
+			error = "perf_event_open is only available on Linux";
+#endif
+			if (!error.empty()) {
+				std::lock_guard<std::mutex> lock(countersMutex);
+				if (allEventErrors[event].empty()) allEventErrors[event] = error;
+			}
+		}
+	}
+
+	bool anyCounted = false;
+	for (int event = 0; event < counterEventCount; event++) {
+		allEventCounts[event] = 0;
+#ifdef __linux__
+		if (localCounterFiles.allFileDescriptors[event] < 0) continue;
+		std::uint64_t values[3] = {};
+		if (read(localCounterFiles.allFileDescriptors[event], values, sizeof(values)) != sizeof(values)) continue;
+		allEventCounts[event] = values[2] > 0 && values[2] < values[1] ? static_cast<std::uint64_t>(values[0] * (static_cast<double>(values[1]) / values[2])) : values[0];
+		anyCounted = true;
+#endif
+	}
+	return anyCounted;
+}
+
+void PerfCounters::recordStage(counterStage stage, std::uint64_t nanoseconds, const std::uint64_t * allStartCounts, const std::uint64_t * allEndCounts, bool counted) {
+	if (localThreadCounters == nullptr) {
+		std::unique_ptr<ThreadCounters> threadCounters = std::make_unique<ThreadCounters>();
+		localThreadCounters = threadCounters.get();
+		std::lock_guard<std::mutex> lock(countersMutex);
+		allThreadCounters.push_back(std::move(threadCounters));
+	}
+	StageCounters & stageCounters = localThreadCounters->allStageCounters[stage];
+	stageCounters.calls++;
+	stageCounters.nanoseconds += nanoseconds;
+	if (!counted) return;
+	for (int event = 0; event < counterEventCount; event++) {
+		if (allEndCounts[event] > allStartCounts[event]) stageCounters.allEventCounts[event] += allEndCounts[event] - allStartCounts[event];
+	}
+}
+
+/**
+ * Merges the counts of every thread and writes a table per stage and per thread.
+ * 
+ * @param reportStream The stream the report will be written to. Its formatting is left as it was.
+ */
+void PerfCounters::writeReport(std::ostream & reportStream) {
+	std::lock_guard<std::mutex> lock(countersMutex);
+	const std::string eventNames[counterEventCount] = {"cycles", "instructions", "cache misses", "branch misses"};
+	//Formatted on its own stream, so the caller's keeps its flags.
+	std::stringstream reportText;
+
+	reportText << "Hardware counters, stages inside another stage count towards the outer one:\n";
+	bool anyEventAvailable = false;
+	for (int event = 0; event < counterEventCount; event++) {
+		if (allEventErrors[event].empty()) {
+			anyEventAvailable = true;
+		} else {
+			reportText << "No " << eventNames[event] << " counter: " << allEventErrors[event] << '\n';
+		}
+	}
+	if (!anyEventAvailable) reportText << "Only calls and time are reported. Counters may need perf_event_paranoid lowered or are not available in virtual machines.\n";
+
+	auto writeRow = [&](const std::string & name, const StageCounters & counters) {
+		reportText << std::left << std::setw(16) << name << std::right << std::setw(10) << counters.calls
+			<< std::setw(12) << std::fixed << std::setprecision(1) << counters.nanoseconds / 1000000.0;
+		for (int event = 0; event < counterEventCount; event++) {
+			if (allEventErrors[event].empty()) {
+				reportText << std::setw(16) << counters.allEventCounts[event];
+			} else {
+				reportText << std::setw(16) << "n/a";
+			}
+			//Instructions per cycle after the instructions.
+			if (event == instructionsEvent) {
+				if (allEventErrors[cyclesEvent].empty() && allEventErrors[instructionsEvent].empty() && counters.allEventCounts[cyclesEvent] > 0) {
+					reportText << std::setw(8) << std::setprecision(2) << static_cast<double>(counters.allEventCounts[instructionsEvent]) / counters.allEventCounts[cyclesEvent];
+				} else {
+					reportText << std::setw(8) << "n/a";
+				}
+			}
+		}
+		reportText << '\n';
+	};
+	auto writeHeader = [&](const std::string & name) {
+		reportText << std::left << std::setw(16) << name << std::right << std::setw(10) << "Calls" << std::setw(12) << "Time ms"
+			<< std::setw(16) << "Cycles" << std::setw(16) << "Instructions" << std::setw(8) << "IPC"
+			<< std::setw(16) << "Cache misses" << std::setw(16) << "Branch misses" << '\n';
+	};
+
+	writeHeader("Stage");
+	for (int stage = 0; stage < counterStageCount; stage++) {
+		StageCounters merged;
+		for (const std::unique_ptr<ThreadCounters> & threadCounters : allThreadCounters) {
+			const StageCounters & counters = threadCounters->allStageCounters[stage];
+			merged.calls += counters.calls;
+			merged.nanoseconds += counters.nanoseconds;
+			for (int event = 0; event < counterEventCount; event++) merged.allEventCounts[event] += counters.allEventCounts[event];
+		}
+		if (merged.calls > 0) writeRow(getCounterStageName(stage), merged);
+	}
+
+	writeHeader("Thread");
+	for (std::size_t thread = 0; thread < allThreadCounters.size(); thread++) {
+		StageCounters merged;
+		for (const StageCounters & counters : allThreadCounters[thread]->allStageCounters) {
+			merged.calls += counters.calls;
+			merged.nanoseconds += counters.nanoseconds;
+			for (int event = 0; event < counterEventCount; event++) merged.allEventCounts[event] += counters.allEventCounts[event];
+		}
+		writeRow(std::to_string(thread + 1), merged);
+	}
+	reportStream << reportText.str();
+}
+
+CounterScope::CounterScope(counterStage stage) : stage(stage) {
+	previousAllocationStage = AllocationAccounting::enterStage(stage);
+	if (!PerfCounters::isEnabled()) return;
+	entered = true;
+	active = localScopeDepth++ == 0;
+	if (!active) return;
+	counted = PerfCounters::readLocalCounters(allStartCounts);
+	startNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CounterScope::~CounterScope() {
+	AllocationAccounting::leaveStage(previousAllocationStage);
+	if (!entered) return;
+	localScopeDepth--;
+	if (!active) return;
+	const std::int64_t endNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	std::uint64_t allEndCounts[counterEventCount] = {};
+	if (counted) PerfCounters::readLocalCounters(allEndCounts);
+	PerfCounters::recordStage(stage, endNanoseconds - startNanoseconds, allStartCounts, allEndCounts, counted);
+}
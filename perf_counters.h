@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+enum counterStage {
+	readCounterStage,
+	stripCommentsCounterStage,
+	parseJsonCounterStage,
+	extractCounterStage,
+	makePatchCounterStage,
+	writeCounterStage,
+	counterStageCount
+};
+
+enum counterEvent {
+	cyclesEvent,
+	instructionsEvent,
+	cacheMissesEvent,
+	branchMissesEvent,
+	counterEventCount
+};
+
+struct StageCounters {
+	std::uint64_t calls = 0;
+	std::uint64_t nanoseconds = 0;
+	std::uint64_t allEventCounts[counterEventCount] = {};
+};
+
+std::string getCounterStageName(int stage);
+
+//Hardware counters read around each pipeline stage on every thread, through perf_event_open on Linux.
+class PerfCounters {
+private:
+	static std::atomic<bool> enabled;
+	static bool readLocalCounters(std::uint64_t * allEventCounts);
+	static void recordStage(counterStage stage, std::uint64_t nanoseconds, const std::uint64_t * allStartCounts, const std::uint64_t * allEndCounts, bool counted);
+public:
+	static void enable();
+	static const bool isEnabled();
+	static void writeReport(std::ostream & reportStream);
+
+	friend class CounterScope;
+};
+
+//Counts a stage from construction to destruction. Stages inside another stage on the same thread are counted as part of it.
+class CounterScope {
+private:
+	counterStage stage;
+	//The stage allocations were counted towards before this one, in builds with allocation accounting.
+	int previousAllocationStage = counterStageCount;
+	bool entered = false;
+	bool active = false;
+	bool counted = false;
+	std::int64_t startNanoseconds = 0;
+	std::uint64_t allStartCounts[counterEventCount] = {};
+public:
+	CounterScope(counterStage stage);
+	~CounterScope();
+	CounterScope(const CounterScope &) = delete;
+	CounterScope & operator=(const CounterScope &) = delete;
+};
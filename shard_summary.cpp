@@ -0,0 +1,139 @@
+#include "shard_summary.h"
+
+#include <algorithm>
+#include <charconv>
+#include <nlohmann/json.hpp>
+#include "content_hash_memo.h"
+#include "utilities.h"
+
+namespace fs = std::filesystem;
+using json = nlohmann::json;
+
+ShardSummary::ShardSummary() { }
+
+/**
+ * @param command The command the shard ran, such as parse or makepatches.
+ * @param shardIndex Which shard this is, from 1 to the shard count.
+ * @param shardCount How many shards the run was split into.
+ */
+ShardSummary::ShardSummary(std::string command, int shardIndex, int shardCount) : command(command), shardIndex(shardIndex), shardCount(shardCount) { }
+
+/**
+ * Adds a file the shard wrote. Safe to call from several threads.
+ * 
+ * @param outputFolder The output folder the file was written to, such as intermediary_assets.
+ * @param assetPath The asset path of the file within the output folder.
+ */
+void ShardSummary::addOutput(const std::string & outputFolder, const std::string & assetPath) {
+	std::lock_guard<std::mutex> lock(summaryMutex);
+	allOutputs[outputFolder].push_back(assetPath);
+}
+
+/**
+ * Adds to a named counter, such as how many patches were made. Safe to call from several threads.
+ * 
+ * @param name The name of the counter.
+ * @param value How much to add.
+ */
+void ShardSummary::addCounter(const std::string & name, std::int64_t value) {
+	std::lock_guard<std::mutex> lock(summaryMutex);
+	allCounters[name] += value;
+}
+
+/**
+ * Writes the summary as JSON, with output paths sorted so the same shard always gives the same summary.
+ * 
+ * @param summaryText The stream the summary will be written to.
+ */
+void ShardSummary::writeSummary(std::stringstream & summaryText) {
+	std::lock_guard<std::mutex> lock(summaryMutex);
+	json summaryJson = json::object();
+	summaryJson["command"] = command;
+	summaryJson["shard"] = shardIndex;
+	summaryJson["shardCount"] = shardCount;
+	summaryJson["counters"] = allCounters;
+	json outputsJson = json::object();
+	for (auto & [outputFolder, allAssetPaths] : allOutputs) {
+		std::sort(allAssetPaths.begin(), allAssetPaths.end());
+		outputsJson[outputFolder] = allAssetPaths;
+	}
+	summaryJson["outputs"] = outputsJson;
+	summaryText << summaryJson.dump(1, '\t') << '\n';
+}
+
+/**
+ * @param summaryPath The summary file written by a shard.
+ * @return If the file was a valid shard summary.
+ */
+bool ShardSummary::loadSummary(fs::path summaryPath) {
+	if (!fs::is_regular_file(summaryPath)) return false;
+	const json summaryJson = fetchJson(summaryPath);
+	if (!summaryJson.is_object() || !summaryJson.contains("command") || !summaryJson.contains("shard") || !summaryJson.contains("shardCount")) return false;
+	if (!summaryJson["command"].is_string() || !summaryJson["shard"].is_number_integer() || !summaryJson["shardCount"].is_number_integer()) return false;
+
+	std::lock_guard<std::mutex> lock(summaryMutex);
+	command = summaryJson["command"];
+	shardIndex = summaryJson["shard"];
+	shardCount = summaryJson["shardCount"];
+	allCounters.clear();
+	allOutputs.clear();
+	if (summaryJson.contains("counters") && summaryJson["counters"].is_object()) {
+		for (auto & [name, value] : summaryJson["counters"].items()) {
+			if (value.is_number_integer()) allCounters[name] = value;
+		}
+	}
+	if (summaryJson.contains("outputs") && summaryJson["outputs"].is_object()) {
+		for (auto & [outputFolder, allAssetPaths] : summaryJson["outputs"].items()) {
+			if (!allAssetPaths.is_array()) continue;
+			for (const json & assetPath : allAssetPaths) {
+				if (assetPath.is_string()) allOutputs[outputFolder].push_back(assetPath);
+			}
+		}
+	}
+	return true;
+}
+
+std::string ShardSummary::getCommand() { return command; }
+const int ShardSummary::getShardIndex() { return shardIndex; }
+const int ShardSummary::getShardCount() { return shardCount; }
+std::map<std::string, std::int64_t> ShardSummary::getAllCounters() { return allCounters; }
+std::map<std::string, std::vector<std::string>> ShardSummary::getAllOutputs() { return allOutputs; }
+
+/**
+ * @param shard A shard such as "2/4", the second of four.
+ * @param shardIndex Receives which shard it is, from 1 to the shard count.
+ * @param shardCount Receives how many shards there are.
+ * @return If the shard was valid.
+ */
+bool parseShard(const std::string & shard, int & shardIndex, int & shardCount) {
+	const std::size_t slash = shard.find('/');
+	if (slash == std::string::npos) return false;
+	int index = 0;
+	int count = 0;
+	const char * end = shard.data() + shard.length();
+	auto [indexEnd, indexError] = std::from_chars(shard.data(), shard.data() + slash, index);
+	auto [countEnd, countError] = std::from_chars(shard.data() + slash + 1, end, count);
+	if (indexError != std::errc() || countError != std::errc() || indexEnd != shard.data() + slash || countEnd != end) return false;
+	if (count < 1 || index < 1 || index > count) return false;
+	shardIndex = index;
+	shardCount = count;
+	return true;
+}
+
+/**
+ * Finds the shard an asset belongs to from a hash of its path, so every machine splits the assets the same way without sharing anything.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @param shardCount How many shards there are.
+ * @return The shard, from 1 to the shard count.
+ */
+int getAssetShard(const std::string & assetPath, int shardCount) {
+	if (shardCount <= 1) return 1;
+	return static_cast<int>(hashContent(assetPath) % static_cast<std::uint64_t>(shardCount)) + 1;
+}
+
+fs::path getShardSummaryPath(fs::path outputPath, int shardIndex, int shardCount) {
+	fs::path summaryPath = outputPath;
+	summaryPath += ".shard" + std::to_string(shardIndex) + "of" + std::to_string(shardCount) + ".json";
+	return summaryPath;
+}
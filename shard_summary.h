@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+//What one shard of a parse or makepatches run made, so the shards of a run spread over several machines can be checked and combined.
+class ShardSummary {
+private:
+	std::string command;
+	int shardIndex = 1;
+	int shardCount = 1;
+	std::map<std::string, std::int64_t> allCounters;
+	//Asset paths written to each output folder.
+	std::map<std::string, std::vector<std::string>> allOutputs;
+	std::mutex summaryMutex;
+public:
+	ShardSummary();
+	ShardSummary(std::string command, int shardIndex, int shardCount);
+	void addOutput(const std::string & outputFolder, const std::string & assetPath);
+	void addCounter(const std::string & name, std::int64_t value);
+	void writeSummary(std::stringstream & summaryText);
+	bool loadSummary(std::filesystem::path summaryPath);
+	//Getters
+	std::string getCommand();
+	const int getShardIndex();
+	const int getShardCount();
+	std::map<std::string, std::int64_t> getAllCounters();
+	std::map<std::string, std::vector<std::string>> getAllOutputs();
+};
+
+bool parseShard(const std::string & shard, int & shardIndex, int & shardCount);
+
+int getAssetShard(const std::string & assetPath, int shardCount);
+
+std::filesystem::path getShardSummaryPath(std::filesystem::path outputPath, int shardIndex, int shardCount);
@@ -0,0 +1,331 @@
+#include "source_layers.h"
+
+#include <algorithm>
+#include <iostream>
+#include "content_hash_memo.h"
+#include "directory_walker.h"
+#include "json_patch_applier.h"
+#include "perf_counters.h"
+#include "user_interaction_helper.h"
+#include "utilities.h"
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+SourceLayers::SourceLayers() { }
+
+/**
+ * Adds a source layer above every layer already added.
+ * 
+ * @param layerPath An asset folder or Starbound .pak file.
+ * @return If the layer exists and could be read.
+ */
+bool SourceLayers::addLayer(fs::path layerPath) {
+	SourceLayer layer;
+	layer.layerPath = layerPath;
+	if (fs::is_directory(layerPath)) {
+		//Folder metadata is a JSON file at the root of the folder.
+		for (const std::string metadataName : {"_metadata", ".metadata"}) {
+			const fs::path metadataPath = layerPath / metadataName;
+			if (fs::exists(metadataPath)) {
+				const json metadata = fetchJson(metadataPath);
+				if (metadata.contains("priority") && metadata["priority"].is_number()) layer.priority = metadata["priority"];
+				break;
+			}
+		}
+	} else if (fs::is_regular_file(layerPath)) {
+		layer.pakReader = std::make_unique<PakReader>();
+		if (!layer.pakReader->open(layerPath)) return false;
+		const json & metadata = layer.pakReader->getMetadata();
+		if (metadata.contains("priority") && metadata["priority"].is_number()) layer.priority = metadata["priority"];
+	} else {
+		return false;
+	}
+	allLayers.push_back(std::move(layer));
+	return true;
+}
+
+/**
+ * Orders layers the way Starbound orders asset sources, by ascending priority and then by the order they were added.
+ */
+void SourceLayers::sortByPriority() {
+	std::stable_sort(allLayers.begin(), allLayers.end(), [](const SourceLayer & first, const SourceLayer & second) {
+		return first.priority < second.priority;
+	});
+}
+
+/**
+ * Reports every asset with a wanted extension in any layer. Assets in several layers are only reported once.
+ * 
+ * @param threadCount How many threads folders may be read with.
+ * @param allExtensions Only assets with these extensions are reported.
+ * @param pathFilter Only assets it matches are reported, null to not filter.
+ * @param onAsset Called with the asset path of every matching asset. Called from several threads at once.
+ */
+void SourceLayers::forEachAsset(int threadCount, const std::unordered_set<std::string> & allExtensions, AssetPathFilter * pathFilter, const std::function<void(const std::string &)> & onAsset) {
+	//A single folder can be streamed straight from the walk.
+	if (allLayers.size() == 1 && !allLayers[0].pakReader) {
+		const fs::path rootPath = allLayers[0].layerPath;
+		DirectoryWalker walker = DirectoryWalker(threadCount, allExtensions, pathFilter);
+		walker.walk(rootPath, [&](const fs::path & filePath) {
+			onAsset(toAssetPath(filePath, rootPath));
+		});
+		return;
+	}
+
+	std::mutex seenMutex;
+	std::unordered_set<std::string> allSeenAssetPaths;
+	auto reportOnce = [&](const std::string & assetPath) {
+		{
+			std::lock_guard<std::mutex> lock(seenMutex);
+			if (!allSeenAssetPaths.insert(assetPath).second) return;
+		}
+		onAsset(assetPath);
+	};
+	for (SourceLayer & layer : allLayers) {
+		if (layer.pakReader) {
+			for (const std::string & assetPath : layer.pakReader->getAllAssetPaths()) {
+				if (!allExtensions.contains(fs::path(assetPath).extension().string())) continue;
+				if (pathFilter == nullptr || pathFilter->matchesFile(assetPath)) reportOnce(assetPath);
+			}
+		} else {
+			DirectoryWalker walker = DirectoryWalker(threadCount, allExtensions, pathFilter);
+			walker.walk(layer.layerPath, [&](const fs::path & filePath) {
+				reportOnce(toAssetPath(filePath, layer.layerPath));
+			});
+		}
+	}
+}
+
+bool SourceLayers::fetchLayerText(SourceLayer & layer, const std::string & assetPath, std::string & text) {
+	if (layer.pakReader) {
+		if (!layer.pakReader->contains(assetPath)) return false;
+		CounterScope counterScope = CounterScope(readCounterStage);
+		text = std::string(layer.pakReader->fetchText(assetPath));
+		return true;
+	}
+	fs::path filePath = layer.layerPath;
+	filePath += fs::path(assetPath).make_preferred();
+	return tryFetchText(filePath, text);
+}
+
+/**
+ * @param assetPath The asset path, starting with a forward slash.
+ * @return The size in bytes of the asset in the highest layer that has it, 0 if none do.
+ */
+std::uintmax_t SourceLayers::getAssetSize(const std::string & assetPath) {
+	for (auto layer = allLayers.rbegin(); layer != allLayers.rend(); ++layer) {
+		if (layer->pakReader) {
+			if (layer->pakReader->contains(assetPath)) return layer->pakReader->fetchText(assetPath).size();
+		} else {
+			fs::path filePath = layer->layerPath;
+			filePath += fs::path(assetPath).make_preferred();
+			std::error_code error;
+			const std::uintmax_t fileSize = fs::file_size(filePath, error);
+			if (!error) return fileSize;
+		}
+	}
+	return 0;
+}
+
+/**
+ * @param assetPath The asset path, starting with a forward slash.
+ * @return The index of the highest layer that has the asset, higher indices having higher priority. -1 if none do.
+ */
+int SourceLayers::findAssetLayer(const std::string & assetPath) {
+	for (int layerIndex = allLayers.size() - 1; layerIndex >= 0; layerIndex--) {
+		SourceLayer & layer = allLayers[layerIndex];
+		if (layer.pakReader) {
+			if (layer.pakReader->contains(assetPath)) return layerIndex;
+		} else {
+			fs::path filePath = layer.layerPath;
+			filePath += fs::path(assetPath).make_preferred();
+			if (fs::is_regular_file(filePath)) return layerIndex;
+		}
+	}
+	return -1;
+}
+
+/**
+ * Loads the unpatched text of an asset from the highest layer that has it.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @param text Set to the text of the asset.
+ * @return If any layer has the asset.
+ */
+bool SourceLayers::fetchSourceText(const std::string & assetPath, std::string & text) {
+	for (auto layer = allLayers.rbegin(); layer != allLayers.rend(); ++layer) {
+		if (fetchLayerText(*layer, assetPath, text)) return true;
+	}
+	return false;
+}
+
+/**
+ * Loads the unpatched text of an asset and hashes it along with every layer's patch for it,
+ * so identical hashes mean identical effective source JSON.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @param text Set to the unpatched text of the asset.
+ * @param contentHash Set to the hash of the asset and its patches.
+ * @return If any layer has the asset.
+ */
+bool SourceLayers::fetchSourceContent(const std::string & assetPath, std::string & text, std::uint64_t & contentHash) {
+	if (!fetchSourceText(assetPath, text)) return false;
+	contentHash = hashContent(text);
+	const std::string patchPath = assetPath + ".patch";
+	for (SourceLayer & layer : allLayers) {
+		std::string patchText;
+		if (fetchLayerText(layer, patchPath, patchText)) contentHash = hashContent(patchText, hashContent(patchPath, contentHash));
+	}
+	return true;
+}
+
+/**
+ * Builds the effective source JSON of an asset. The asset is loaded from the highest layer that has it,
+ * then the .patch files of every layer are applied in layer order. Patched results are cached.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @param valuesHaveNewlines If values have actual newlines in them.
+ * @return The effective source JSON, null if no layer has the asset.
+ */
+std::shared_ptr<const json> SourceLayers::fetchSourceJson(const std::string & assetPath, bool valuesHaveNewlines) {
+	std::shared_ptr<const json> cachedSourceJson = findCachedAsset(assetPath, valuesHaveNewlines);
+	if (cachedSourceJson) return cachedSourceJson;
+
+	std::string sourceText;
+	if (!fetchSourceText(assetPath, sourceText)) return nullptr;
+	return fetchSourceJson(assetPath, valuesHaveNewlines, std::move(sourceText));
+}
+
+/**
+ * Builds the effective source JSON of an asset from its already loaded unpatched text.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @param valuesHaveNewlines If values have actual newlines in them.
+ * @param sourceText The unpatched text of the asset.
+ * @return The effective source JSON.
+ */
+std::shared_ptr<const json> SourceLayers::fetchSourceJson(const std::string & assetPath, bool valuesHaveNewlines, std::string sourceText) {
+	std::shared_ptr<const json> cachedSourceJson = findCachedAsset(assetPath, valuesHaveNewlines);
+	if (cachedSourceJson) return cachedSourceJson;
+
+	json sourceJson = parseJsonText(std::move(sourceText), valuesHaveNewlines);
+
+	//Apply the patches of every layer in order.
+	bool patched = false;
+	const std::string patchPath = assetPath + ".patch";
+	for (SourceLayer & layer : allLayers) {
+		std::string patchText;
+		if (!fetchLayerText(layer, patchPath, patchText)) continue;
+		std::string error;
+		if (applyStarboundPatch(sourceJson, parseJsonText(std::move(patchText), valuesHaveNewlines), error) < 0) {
+			std::lock_guard<std::mutex> lock(consoleMutex);
+			std::cout << "Could not apply patch \"" << patchPath << "\" from " << layer.layerPath.string() << ":\n"
+				<< error << std::endl;
+		}
+		patched = true;
+	}
+
+	std::shared_ptr<const json> sharedSourceJson = std::make_shared<const json>(std::move(sourceJson));
+	//Unpatched assets are cheap to load again, so only patched ones are kept unless asked otherwise.
+	if (patched || cacheUnpatchedAssets) cacheAsset((valuesHaveNewlines ? "n:" : "s:") + assetPath, sharedSourceJson);
+	return sharedSourceJson;
+}
+
+/**
+ * Loads an asset's text and content hash for fetchSourceJson(SourceAsset &, bool).
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ * @param sourceAsset Set to the loaded asset.
+ * @return If any layer has the asset.
+ */
+bool SourceLayers::fetchSourceAsset(const std::string & assetPath, SourceAsset & sourceAsset) {
+	sourceAsset.assetPath = assetPath;
+	return fetchSourceContent(assetPath, sourceAsset.text, sourceAsset.contentHash);
+}
+
+/**
+ * Builds the effective source JSON of a loaded asset, parsing it only the first time for each newline mode.
+ * 
+ * @param sourceAsset The loaded asset.
+ * @param valuesHaveNewlines If values have actual newlines in them.
+ * @return The effective source JSON.
+ */
+std::shared_ptr<const json> SourceLayers::fetchSourceJson(SourceAsset & sourceAsset, bool valuesHaveNewlines) {
+	std::shared_ptr<const json> & sourceJson = sourceAsset.allSourceJson[valuesHaveNewlines];
+	if (!sourceJson) sourceJson = fetchSourceJson(sourceAsset.assetPath, valuesHaveNewlines, sourceAsset.text);
+	return sourceJson;
+}
+
+std::shared_ptr<const json> SourceLayers::findCachedAsset(const std::string & assetPath, bool valuesHaveNewlines) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	auto found = cachedAssets.find((valuesHaveNewlines ? "n:" : "s:") + assetPath);
+	if (found == cachedAssets.end()) return nullptr;
+	cacheOrder.splice(cacheOrder.begin(), cacheOrder, found->second.second);
+	return found->second.first;
+}
+
+void SourceLayers::cacheAsset(const std::string & cacheKey, std::shared_ptr<const json> sourceJson) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	if (cachedAssets.contains(cacheKey)) return;
+	cacheOrder.push_front(cacheKey);
+	cachedAssets[cacheKey] = {sourceJson, cacheOrder.begin()};
+	//Forget the least recently used asset.
+	if (cachedAssets.size() > maxCachedAssets) {
+		cachedAssets.erase(cacheOrder.back());
+		cacheOrder.pop_back();
+	}
+}
+
+/**
+ * Forgets any cached result for an asset so it is rebuilt when next fetched.
+ * 
+ * @param assetPath The asset path, starting with a forward slash.
+ */
+void SourceLayers::invalidate(const std::string & assetPath) {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	for (const std::string prefix : {"n:", "s:"}) {
+		auto found = cachedAssets.find(prefix + assetPath);
+		if (found != cachedAssets.end()) {
+			cacheOrder.erase(found->second.second);
+			cachedAssets.erase(found);
+		}
+	}
+}
+
+/**
+ * Forgets every cached result.
+ */
+void SourceLayers::invalidateAll() {
+	std::lock_guard<std::mutex> lock(cacheMutex);
+	cachedAssets.clear();
+	cacheOrder.clear();
+}
+
+/**
+ * @return If there is more than a single plain folder, meaning assets may need patching.
+ */
+const bool SourceLayers::isLayered() {
+	return allLayers.size() > 1 || (allLayers.size() == 1 && allLayers[0].pakReader);
+}
+
+std::vector<fs::path> SourceLayers::getAllLayerPaths() {
+	std::vector<fs::path> allLayerPaths;
+	for (const SourceLayer & layer : allLayers) allLayerPaths.push_back(layer.layerPath);
+	return allLayerPaths;
+}
+
+//Setters
+void SourceLayers::setCacheUnpatchedAssets(bool cache) { cacheUnpatchedAssets = cache; }
+
+/**
+ * @param filePath A file inside an asset folder.
+ * @param rootPath The asset folder.
+ * @return The asset path of the file, starting with a forward slash.
+ */
+std::string toAssetPath(const fs::path & filePath, const fs::path & rootPath) {
+	std::string pathFragment = filePath.string();
+	pathFragment.erase(0, rootPath.string().length());
+	return fs::path(pathFragment).generic_string();
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <nlohmann/json.hpp>
+#include "asset_path_filter.h"
+#include "pak_reader.h"
+
+struct SourceLayer {
+	std::filesystem::path layerPath;
+	double priority = 0;
+	std::unique_ptr<PakReader> pakReader;
+};
+
+//An asset read once, and parsed at most once per newline mode, for making several outputs from it.
+struct SourceAsset {
+	std::string assetPath;
+	std::string text;
+	std::uint64_t contentHash = 0;
+	std::shared_ptr<const nlohmann::json> allSourceJson[2];
+};
+
+class SourceLayers {
+private:
+	std::vector<SourceLayer> allLayers;
+	std::size_t maxCachedAssets = 4096;
+	bool cacheUnpatchedAssets = false;
+	std::unordered_map<std::string, std::pair<std::shared_ptr<const nlohmann::json>, std::list<std::string>::iterator>> cachedAssets;
+	std::list<std::string> cacheOrder;
+	std::mutex cacheMutex;
+
+	bool fetchLayerText(SourceLayer & layer, const std::string & assetPath, std::string & text);
+	std::shared_ptr<const nlohmann::json> findCachedAsset(const std::string & assetPath, bool valuesHaveNewlines);
+	void cacheAsset(const std::string & cacheKey, std::shared_ptr<const nlohmann::json> sourceJson);
+public:
+	SourceLayers();
+	bool addLayer(std::filesystem::path layerPath);
+	void sortByPriority();
+	void forEachAsset(int threadCount, const std::unordered_set<std::string> & allExtensions, AssetPathFilter * pathFilter, const std::function<void(const std::string &)> & onAsset);
+	std::uintmax_t getAssetSize(const std::string & assetPath);
+	int findAssetLayer(const std::string & assetPath);
+	bool fetchSourceText(const std::string & assetPath, std::string & text);
+	bool fetchSourceContent(const std::string & assetPath, std::string & text, std::uint64_t & contentHash);
+	std::shared_ptr<const nlohmann::json> fetchSourceJson(const std::string & assetPath, bool valuesHaveNewlines);
+	std::shared_ptr<const nlohmann::json> fetchSourceJson(const std::string & assetPath, bool valuesHaveNewlines, std::string sourceText);
+	bool fetchSourceAsset(const std::string & assetPath, SourceAsset & sourceAsset);
+	std::shared_ptr<const nlohmann::json> fetchSourceJson(SourceAsset & sourceAsset, bool valuesHaveNewlines);
+	void invalidate(const std::string & assetPath);
+	void invalidateAll();
+	const bool isLayered();
+	//Getters
+	std::vector<std::filesystem::path> getAllLayerPaths();
+	//Setters
+	void setCacheUnpatchedAssets(bool cacheUnpatchedAssets);
+};
+
+std::string toAssetPath(const std::filesystem::path & filePath, const std::filesystem::path & rootPath);
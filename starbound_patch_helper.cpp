@@ -1,21 +1,62 @@
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <iostream>
+#include <map>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <nlohmann/json.hpp>
+#include "allocation_accounting.h"
+#include "asset_index.h"
+#include "asset_path_filter.h"
+#include "asset_scheduler.h"
+#include "config_profiler.h"
+#include "content_hash_memo.h"
+#include "directory_walker.h"
 #include "global_settings.h"
+#include "intermediary_bundle.h"
+#include "intermediary_rebaser.h"
 #include "json_intermediary_writer.h"
+#include "json_parser.h"
 #include "json_patch_writer.h"
+#include "output_synchroniser.h"
 #include "parse_settings.h"
+#include "patch_server.h"
+#include "perf_counters.h"
+#include "shard_summary.h"
+#include "source_layers.h"
+#include "tar_stream.h"
 #include "user_interaction_helper.h"
 #include "utilities.h"
+#include "value_index.h"
+#include "value_intern_table.h"
+#include "value_transformer.h"
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 using json = nlohmann::json;
 
 namespace fs = std::filesystem;
 
-void parseAssets(MasterSettings & masterSettings, const fs::path sourceAssetPath, const fs::path intermediaryAssetPath, std::vector<FileSettings> fileSettings);
-void makePatches(MasterSettings & masterSettings, const fs::path sourceAssetPath, const fs::path intermediaryAssetPath, const fs::path patchOutputPath, std::vector<FileSettings> fileSettings);
+bool loadSourceLayers(MasterSettings & masterSettings, SourceLayers & sourceLayers);
+std::vector<std::pair<fs::path, fs::path>> getPatchTreePaths(MasterSettings & masterSettings);
+void parseAssets(MasterSettings & masterSettings, SourceLayers & sourceLayers, const fs::path intermediaryAssetPath, std::vector<FileSettings> fileSettings);
+void makePatches(MasterSettings & masterSettings, SourceLayers & sourceLayers, std::vector<std::pair<fs::path, fs::path>> allTreePaths, std::vector<FileSettings> fileSettings, ValueTransformer * valueTransformer);
+void rebaseIntermediaries(MasterSettings & masterSettings, SourceLayers & oldSourceLayers, SourceLayers & newSourceLayers, const fs::path intermediaryAssetPath, const fs::path rebasedAssetPath, std::vector<FileSettings> fileSettings);
+void previewAssets(MasterSettings & masterSettings, SourceLayers & sourceLayers, const fs::path intermediaryAssetPath, std::vector<FileSettings> fileSettings, int samplesPerExtension, ValueTransformer * valueTransformer);
+bool queryValues(const fs::path intermediaryAssetPath, std::vector<std::string> allQueryArguments);
+bool mergeShardSummaries(std::vector<std::string> allSummaryArguments);
+std::string getOutputFolderName(const fs::path & outputPath);
+void streamParseAssets(MasterSettings & masterSettings, std::vector<FileSettings> allFileSettings, std::istream & tarInput, std::ostream & tarOutput);
+void streamMakePatches(MasterSettings & masterSettings, std::vector<FileSettings> allFileSettings, std::istream & tarInput, std::ostream & tarOutput, ValueTransformer * valueTransformer);
+std::vector<FileSettings *> getExtensionTargetSettings(std::vector<FileSettings> & allFileSettings, const std::string & extension);
+bool fetchPatchSource(SourceLayers & sourceLayers, const std::string & assetPath, SourceAsset & sourceAsset);
+bool makePatch(JsonPatchWriter & patchWriter, FileSettings & fileSettings, SourceLayers & sourceLayers, SourceAsset & sourceAsset, ValueInternTable * internTable, ValueTransformer * valueTransformer, ContentHashMemo * patchMemo, OutputSynchroniser * outputSynchroniser, const fs::path patchOutputPath, std::string intermediaryText, std::atomic<int> & totalValuesAltered);
 
 int main(int argc, char * argv[]) {
 	
@@ -24,6 +65,30 @@ int main(int argc, char * argv[]) {
 	const std::string strParse = "parse";
 	const std::string strMakePatches = "makepatches";
 	const std::string strOverwrite = "overwrite";
+	const std::string strBundle = "bundle";
+	const std::string strUnbundle = "unbundle";
+	const std::string strRebase = "rebase";
+	const std::string strServe = "serve";
+	const std::string strPreview = "preview";
+	const std::string strQuery = "query";
+	const std::string strMergeSummaries = "merge-summaries";
+	const std::string strThreadsOption = "--threads";
+	const std::string strMaxMemoryOption = "--max-memory";
+	const std::string strProfileConfigOption = "--profile-config";
+	const std::string strSourceLayerOption = "--source-layer";
+	const std::string strIncludeOption = "--include";
+	const std::string strExcludeOption = "--exclude";
+	const std::string strPatchTreeOption = "--patch-tree";
+	const std::string strTarOption = "--tar";
+	const std::string strPerfCountersOption = "--perf-counters";
+	const std::string strAllocationsOption = "--allocations";
+	const std::string strShardOption = "--shard";
+
+	//When streaming a tar archive to standard output every message goes to standard error instead.
+	std::streambuf * tarOutputBuffer = nullptr;
+	for (int i = 2; i < argc && tarOutputBuffer == nullptr; i++) {
+		if (argv[i] == strTarOption) tarOutputBuffer = std::cout.rdbuf(std::cerr.rdbuf());
+	}
 
 	//Paths that will be used for various things.
 	const fs::path parseSettingsPath = fs::current_path() /= "config/parse_targets";
@@ -33,12 +98,18 @@ int main(int argc, char * argv[]) {
 
 	MasterSettings masterSettings = MasterSettings(fs::current_path() /= "config/settings.json");
 	std::cout << "Selected patch style: " << masterSettings.getBaselinePatchStyleName() << std::endl;
+	if (!JsonParser::selectBackend(masterSettings.getJsonParser())) {
+		std::cout << "JSON parser \"" << masterSettings.getJsonParser() << "\" is not available in this build, using " << JsonParser::getBackendName() << ".\n";
+	}
 
 	//Populate parse settings for every configured file type.
 	std::vector<FileSettings> allFileSettings;
 	for (const auto & directory : fs::recursive_directory_iterator(parseSettingsPath)) {
 		if (directory.path().has_extension() && directory.path().extension().string() == ".json") {
 			FileSettings fileSettings = FileSettings(directory);
+			//Configs in a folder of parse_targets belong to the target named after it.
+			const fs::path relativePath = directory.path().lexically_relative(parseSettingsPath);
+			if (relativePath.has_parent_path()) fileSettings.setTargetName(relativePath.begin()->string());
 			if (fileSettings.hasPointerSettings()) {
 				allFileSettings.push_back(fileSettings);
 			} else {
@@ -48,6 +119,79 @@ int main(int argc, char * argv[]) {
 			}
 		}
 	}
+	//A single target keeps its intermediary files directly in the intermediary asset folder.
+	const std::vector<std::string> allTargetNames = getAllTargetNames(allFileSettings);
+	if (allTargetNames.size() > 1) {
+		std::cout << allTargetNames.size() << " parse targets are configured, each gets its own intermediary asset folder.\n";
+	} else {
+		for (FileSettings & fileSettings : allFileSettings) fileSettings.setTargetName("");
+	}
+
+	//Rules rewriting intermediary values before patches are made.
+	ValueTransformer valueTransformer;
+	if (!valueTransformer.loadRules(fs::current_path() /= "config/transforms")) return 1;
+	ValueTransformer * usedValueTransformer = valueTransformer.hasRules() ? &valueTransformer : nullptr;
+
+	//Options after the command override settings for this run, anything else is a command argument.
+	std::vector<std::string> commandArguments;
+	std::vector<std::string> sourceLayerArguments;
+	std::vector<std::string> includeArguments;
+	std::vector<std::string> excludeArguments;
+	std::vector<std::pair<std::string, std::string>> patchTreeArguments;
+	for (int i = 2; i < argc; i++) {
+		const std::string argument = argv[i];
+		if (argument == strThreadsOption && i + 1 < argc) {
+			masterSettings.setWorkerThreads(std::atoi(argv[++i]));
+		} else if (argument == strMaxMemoryOption && i + 1 < argc) {
+			if (!masterSettings.setMaxMemory(argv[++i])) {
+				std::cout << "Invalid memory size:\n"
+					<< argv[i] << std::endl;
+				return 1;
+			}
+		} else if (argument == strProfileConfigOption) {
+			ConfigProfiler::enable();
+		} else if (argument == strPerfCountersOption) {
+			PerfCounters::enable();
+		} else if (argument == strAllocationsOption) {
+			AllocationAccounting::enable();
+		} else if (argument == strShardOption && i + 1 < argc) {
+			if (!masterSettings.setShard(argv[++i])) {
+				std::cout << "Invalid shard, expected the shard and shard count such as 2/4:\n"
+					<< argv[i] << std::endl;
+				return 1;
+			}
+		} else if (argument == strSourceLayerOption && i + 1 < argc) {
+			sourceLayerArguments.push_back(argv[++i]);
+		} else if (argument == strIncludeOption && i + 1 < argc) {
+			includeArguments.push_back(argv[++i]);
+		} else if (argument == strExcludeOption && i + 1 < argc) {
+			excludeArguments.push_back(argv[++i]);
+		} else if (argument == strPatchTreeOption && i + 2 < argc) {
+			patchTreeArguments.push_back({argv[i + 1], argv[i + 2]});
+			i += 2;
+		} else if (argument == strTarOption) {
+			//Handled before anything is printed.
+		} else if (argument.starts_with("--")) {
+			std::cout << "Invalid option:\n"
+				<< argument << std::endl;
+			return 1;
+		} else {
+			commandArguments.push_back(argument);
+		}
+	}
+	if (!sourceLayerArguments.empty()) masterSettings.setSourceLayers(sourceLayerArguments);
+	if (!includeArguments.empty()) masterSettings.setIncludePaths(includeArguments);
+	if (!excludeArguments.empty()) masterSettings.setExcludePaths(excludeArguments);
+	if (!patchTreeArguments.empty()) masterSettings.setPatchTrees(patchTreeArguments);
+
+	//Large assets are parsed in parts on as many threads as assets are processed on.
+	JsonParser::setParallelParse(masterSettings.getParallelParseBytes(), AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()));
+
+	//Shards only write whole files, so nothing may be shared between them.
+	if (masterSettings.getShardCount() > 1 && (masterSettings.getBundleIntermediaryFiles() || masterSettings.getInternIntermediaryValues())) {
+		std::cout << "Sharding needs bundleIntermediaryFiles and internIntermediaryValues to be off.\n";
+		return 1;
+	}
 
 	//If parameters are used then never prompt for user inputs.
 	//TODO: Support path params
@@ -58,20 +202,160 @@ int main(int argc, char * argv[]) {
 				<< strParse //<< " [source asset path] [intermediary asset path]"
 				<< "\n	Parses content from source assets into intermediary assets.\n"
 				<< strMakePatches //<< " [source asset path] [intermediary asset path] [patch output path]"
-				<< "\n	Uses source assets and modified intermediary assets to produce patches.\n";
+				<< "\n	Uses source assets and modified intermediary assets to produce patches.\n"
+				<< strBundle
+				<< "\n	Packs the intermediary asset folder into a single intermediary bundle.\n"
+				<< strUnbundle
+				<< "\n	Unpacks the intermediary bundle into an intermediary asset folder.\n"
+				<< strRebase << " [old source asset path] [new source asset path]"
+				<< "\n	Merges edits in intermediary assets parsed from old source assets into intermediary assets parsed from new ones.\n"
+				<< strPreview << " [samples per file type]"
+				<< "\n	Prints the intermediary files and patches a few source assets of each file type would give, without writing anything.\n"
+				<< strQuery << " [words] [field:pointer] [asset:path] [length>count] [length<count]"
+				<< "\n	Lists extracted values containing every word, with the pointer and asset path containing the given text and a length in the range. Lists field statistics without arguments.\n"
+				<< strMergeSummaries << " [summary files or folders]"
+				<< "\n	Combines the counters of the summaries written by every shard of a run, checking every shard is there and no two wrote the same file.\n"
+				<< strServe << " [socket path]"
+				<< "\n	Answers JSON-RPC requests from editors on a Unix domain socket, sbph.sock by default, keeping source assets loaded.\n"
+				<< "Possible options:\n"
+				<< strThreadsOption << " [count]"
+				<< "\n	How many assets are processed at once. 0 uses every hardware thread.\n"
+				<< strMaxMemoryOption << " [size]"
+				<< "\n	Estimated memory assets being processed at once may use, such as 512M or 1G.\n"
+				<< strProfileConfigOption
+				<< "\n	Reports how often each parse target pointer matched and how long it took.\n"
+				<< strPerfCountersOption
+				<< "\n	Reports CPU cycles, instructions, cache misses and branch misses of each stage and thread, where the system allows reading them.\n"
+				<< strAllocationsOption
+				<< "\n	Reports allocations of each stage and file extension and the files needing the most memory, in builds with SBPH_ALLOCATION_ACCOUNTING.\n"
+				<< strShardOption << " [shard/count]"
+				<< "\n	With " << strParse << " or " << strMakePatches << ", only processes the assets of one shard, such as 2/4, chosen from a hash of their path, and writes a summary next to the output.\n"
+				<< strSourceLayerOption << " [path]"
+				<< "\n	Adds an asset folder or .pak file as a source layer. Can be repeated, lowest priority first.\n"
+				<< strIncludeOption << " [glob]"
+				<< "\n	Only processes assets matching the glob, such as /objects/wired or *.object. Can be repeated.\n"
+				<< strExcludeOption << " [glob]"
+				<< "\n	Never processes assets matching the glob. Can be repeated.\n"
+				<< strPatchTreeOption << " [intermediary asset path] [patch output path]"
+				<< "\n	Makes patches from the intermediary assets into the output folder. Can be repeated, such as once per language, and every source asset is parsed once.\n"
+				<< strTarOption
+				<< "\n	With " << strParse << " or " << strMakePatches << ", reads a tar archive of source_assets and intermediary_assets from standard input and writes a tar archive of the results to standard output.\n";
+		//Stream a tar archive from standard input to standard output.
+		} else if (tarOutputBuffer != nullptr && (argv[1] == strParse || argv[1] == strMakePatches)) {
+#ifdef _WIN32
+			_setmode(_fileno(stdin), _O_BINARY);
+			_setmode(_fileno(stdout), _O_BINARY);
+#endif
+			std::ostream tarOutput = std::ostream(tarOutputBuffer);
+			if (argv[1] == strParse) {
+				streamParseAssets(masterSettings, allFileSettings, std::cin, tarOutput);
+			} else {
+				streamMakePatches(masterSettings, allFileSettings, std::cin, tarOutput, usedValueTransformer);
+			}
 		//Parse.
 		} else if (argv[1] == strParse) {
-			sourceAssetPath = fs::current_path() /= "source_assets";
 			intermediaryAssetPath = fs::current_path() /= "intermediary_assets";
 
-			parseAssets(masterSettings, sourceAssetPath, intermediaryAssetPath, allFileSettings);
+			SourceLayers sourceLayers;
+			if (!loadSourceLayers(masterSettings, sourceLayers)) return 1;
+			parseAssets(masterSettings, sourceLayers, intermediaryAssetPath, allFileSettings);
 		//Make patches.
 		} else if (argv[1] == strMakePatches) {
-			sourceAssetPath = fs::current_path() /= "source_assets";
+			SourceLayers sourceLayers;
+			if (!loadSourceLayers(masterSettings, sourceLayers)) return 1;
+			makePatches(masterSettings, sourceLayers, getPatchTreePaths(masterSettings), allFileSettings, usedValueTransformer);
+		//Rebase intermediary assets onto new source assets.
+		} else if (argv[1] == strRebase) {
+			if (commandArguments.size() != 2) {
+				std::cout << "Expected an old and a new source asset path.\n";
+				return 1;
+			}
 			intermediaryAssetPath = fs::current_path() /= "intermediary_assets";
-			patchOutputPath = fs::current_path() /= "patch_output";
+			const fs::path rebasedAssetPath = fs::current_path() /= "intermediary_assets_rebased";
 
-			makePatches(masterSettings, sourceAssetPath, intermediaryAssetPath, patchOutputPath, allFileSettings);
+			SourceLayers oldSourceLayers;
+			SourceLayers newSourceLayers;
+			for (int i = 0; i < 2; i++) {
+				const fs::path layerPath = fs::current_path() / commandArguments[i];
+				if (warnIfNothingAtPath(layerPath, "source asset")) return 1;
+				if (!(i == 0 ? oldSourceLayers : newSourceLayers).addLayer(layerPath)) {
+					std::cout << "The source assets could not be read.\n"
+						<< layerPath.string() << std::endl;
+					return 1;
+				}
+			}
+			if (allTargetNames.size() > 1) {
+				//Each parse target is rebased on its own.
+				if (masterSettings.getBundleIntermediaryFiles() || masterSettings.getInternIntermediaryValues()) {
+					std::cout << "Rebasing several parse targets needs bundleIntermediaryFiles and internIntermediaryValues to be off.\n";
+					return 1;
+				}
+				for (const std::string & targetName : allTargetNames) {
+					std::vector<FileSettings> allTargetFileSettings;
+					for (FileSettings & fileSettings : allFileSettings) {
+						if (fileSettings.getTargetName() == targetName) allTargetFileSettings.push_back(fileSettings);
+					}
+					std::cout << "Rebasing parse target " << targetName << ".\n";
+					rebaseIntermediaries(masterSettings, oldSourceLayers, newSourceLayers, intermediaryAssetPath / targetName, rebasedAssetPath / targetName, allTargetFileSettings);
+				}
+			} else {
+				rebaseIntermediaries(masterSettings, oldSourceLayers, newSourceLayers, intermediaryAssetPath, rebasedAssetPath, allFileSettings);
+			}
+		//Preview parse targets on a sample of source assets.
+		} else if (argv[1] == strPreview) {
+			intermediaryAssetPath = fs::current_path() /= "intermediary_assets";
+			const int samplesPerExtension = commandArguments.empty() ? 3 : std::atoi(commandArguments[0].c_str());
+			if (samplesPerExtension <= 0) {
+				std::cout << "Expected a positive sample count.\n";
+				return 1;
+			}
+
+			SourceLayers sourceLayers;
+			if (!loadSourceLayers(masterSettings, sourceLayers)) return 1;
+			previewAssets(masterSettings, sourceLayers, intermediaryAssetPath, allFileSettings, samplesPerExtension, usedValueTransformer);
+		//Search the value index.
+		} else if (argv[1] == strQuery) {
+			intermediaryAssetPath = fs::current_path() /= "intermediary_assets";
+			if (!queryValues(intermediaryAssetPath, commandArguments)) return 1;
+		//Combine the summaries of every shard of a run.
+		} else if (argv[1] == strMergeSummaries) {
+			if (!mergeShardSummaries(commandArguments)) return 1;
+		//Answer requests from editors.
+		} else if (argv[1] == strServe) {
+			const fs::path socketPath = commandArguments.empty() ? fs::current_path() / "sbph.sock" : fs::current_path() / commandArguments[0];
+
+			SourceLayers sourceLayers;
+			if (!loadSourceLayers(masterSettings, sourceLayers)) return 1;
+			PatchServer patchServer = PatchServer(masterSettings, allFileSettings, &sourceLayers);
+			if (!patchServer.run(socketPath)) return 1;
+		//Pack or unpack the intermediary bundle.
+		} else if (argv[1] == strBundle || argv[1] == strUnbundle) {
+			intermediaryAssetPath = fs::current_path() /= "intermediary_assets";
+			const fs::path intermediaryBundlePath = getIntermediaryBundlePath(intermediaryAssetPath);
+			const bool pack = argv[1] == strBundle;
+			const fs::path readPath = pack ? intermediaryAssetPath : intermediaryBundlePath;
+			const fs::path writePath = pack ? intermediaryBundlePath : intermediaryAssetPath;
+
+			if (warnIfNothingAtPath(readPath, pack ? "intermediary asset" : "intermediary bundle")) return 1;
+			if (fs::exists(writePath)) {
+				if (!masterSettings.getOverwriteFiles()) {
+					std::cout << "Output already exists at:"
+						<< writePath.string()
+						<< "\nNo files will be written.\n"
+						<< "Delete it or run again in overwrite mode.\n";
+					return 1;
+				}
+				fs::remove_all(writePath);
+			}
+
+			const int totalFiles = pack ? packIntermediaryBundle(readPath, writePath) : unpackIntermediaryBundle(readPath, writePath);
+			if (totalFiles < 0) {
+				std::cout << "Failed to convert:\n"
+					<< readPath.string() << std::endl;
+				return 1;
+			}
+			std::cout << totalFiles << " intermediary files " << (pack ? "packed" : "unpacked") << " at:\n"
+				<< writePath.string() << std::endl;
 		//Invalid command.
 		} else {
 			std::cout << "Invalid command:\n"
@@ -106,32 +390,40 @@ int main(int argc, char * argv[]) {
 							<< "\nCopy assets that should be parsed there and then proceed.\n";
 						system("pause");
 					}
-					//If an intermediary asset folder exists prompt the user before deleting it.
-					if (fs::exists(intermediaryAssetPath)) {
+					//If an intermediary asset folder or bundle exists prompt the user before deleting it.
+					const fs::path intermediaryOutputPath = masterSettings.getBundleIntermediaryFiles() ? getIntermediaryBundlePath(intermediaryAssetPath) : intermediaryAssetPath;
+					if (fs::exists(intermediaryOutputPath)) {
 						if (requestBoolean("An intermediary asset folder already exists.\nShould it be replaced?")) {
 							std::cout << "Deleting old intermediary asset folder.\n";
-							fs::remove_all(intermediaryAssetPath);
+							fs::remove_all(intermediaryOutputPath);
 							std::cout << "Old intermediary asset folder deleted.\n";
 						} else {
 							std::cout << "Aborting parse.\n";
 							break;
 						}
 					}
-					parseAssets(masterSettings, sourceAssetPath, intermediaryAssetPath, allFileSettings);
+					SourceLayers sourceLayers;
+					if (loadSourceLayers(masterSettings, sourceLayers)) parseAssets(masterSettings, sourceLayers, intermediaryAssetPath, allFileSettings);
 				//Make patches
 				} else if (input == strMakePatches) {
 					//If a patch asset folder exists prompt the user before deleting it.
 					if (fs::exists(patchOutputPath)) {
 						if (requestBoolean("A patch folder already exists.\nShould it be replaced?")) {
-							std::cout << "Deleting old patch output folder.\n";
-							fs::remove_all(patchOutputPath);
-							std::cout << "Old patch patch output folder deleted.\n";
+							if (masterSettings.getWriteChangedFilesOnly()) {
+								//Replaced in place by makePatches.
+								masterSettings.setOverwriteFiles(true);
+							} else {
+								std::cout << "Deleting old patch output folder.\n";
+								fs::remove_all(patchOutputPath);
+								std::cout << "Old patch patch output folder deleted.\n";
+							}
 						} else {
 							std::cout << "Aborting make patches.\n";
 							break;
 						}
 					}
-					makePatches(masterSettings, sourceAssetPath, intermediaryAssetPath, patchOutputPath, allFileSettings);
+					SourceLayers sourceLayers;
+					if (loadSourceLayers(masterSettings, sourceLayers)) makePatches(masterSettings, sourceLayers, getPatchTreePaths(masterSettings), allFileSettings, usedValueTransformer);
 				//Quit
 				} else if (input == strQuit) {
 					quit = true;
@@ -143,159 +435,1375 @@ int main(int argc, char * argv[]) {
 		} while (!quit);
 	}
 
+	//Pointer hit rates for this run.
+	if (ConfigProfiler::isEnabled()) ConfigProfiler::writeReport(std::cout);
+	//Hardware counters for this run.
+	if (PerfCounters::isEnabled()) PerfCounters::writeReport(std::cout);
+	//Allocations for this run.
+	if (AllocationAccounting::isEnabled()) AllocationAccounting::writeReport(std::cout);
+
+	if (tarOutputBuffer != nullptr) std::cout.rdbuf(tarOutputBuffer);
 	return 0;
 }
 
-void parseAssets(MasterSettings & masterSettings, const fs::path sourceAssetPath, const fs::path intermediaryAssetPath, std::vector<FileSettings> allFileSettings) {
-	//Stop if the source asset folder does not exist.
-	if (warnIfNothingAtPath(sourceAssetPath, "source asset")) return;
+/**
+ * Opens the configured source layers, or the source asset folder if none are configured.
+ * 
+ * @param masterSettings The settings listing the source layers.
+ * @param sourceLayers Receives every layer in priority order.
+ * @return If every layer could be opened.
+ */
+bool loadSourceLayers(MasterSettings & masterSettings, SourceLayers & sourceLayers) {
+	std::vector<std::string> allLayerPaths = masterSettings.getSourceLayers();
+	if (allLayerPaths.empty()) allLayerPaths.push_back("source_assets");
+	for (const std::string & layerPath : allLayerPaths) {
+		const fs::path fullLayerPath = fs::current_path() / layerPath;
+		//Stop if a source layer does not exist.
+		if (warnIfNothingAtPath(fullLayerPath, "source asset")) return false;
+		if (!sourceLayers.addLayer(fullLayerPath)) {
+			std::cout << "The source layer could not be read.\n"
+				<< fullLayerPath.string()
+				<< "\nAborting.\n";
+			return false;
+		}
+	}
+	sourceLayers.sortByPriority();
+	return true;
+}
+
+/**
+ * @return Every intermediary asset folder and the patch output folder made from it, the default pair if none are configured.
+ */
+std::vector<std::pair<fs::path, fs::path>> getPatchTreePaths(MasterSettings & masterSettings) {
+	std::vector<std::pair<fs::path, fs::path>> allTreePaths;
+	for (const auto & [intermediaryPath, outputPath] : masterSettings.getPatchTrees()) {
+		allTreePaths.push_back({fs::current_path() / intermediaryPath, fs::current_path() / outputPath});
+	}
+	if (allTreePaths.empty()) allTreePaths.push_back({fs::current_path() / "intermediary_assets", fs::current_path() / "patch_output"});
+	return allTreePaths;
+}
+
+void parseAssets(MasterSettings & masterSettings, SourceLayers & sourceLayers, const fs::path intermediaryAssetPath, std::vector<FileSettings> allFileSettings) {
+	//Intermediary files are either written to a folder or a single bundle.
+	const bool bundleIntermediaryFiles = masterSettings.getBundleIntermediaryFiles();
+	const fs::path intermediaryOutputPath = bundleIntermediaryFiles ? getIntermediaryBundlePath(intermediaryAssetPath) : intermediaryAssetPath;
+	const std::string intermediaryOutputDescription = bundleIntermediaryFiles ? "intermediary bundle" : "intermediary asset folder";
 
-	//Stop if the intermediary asset folder exists unless in overwrite mode.
-	if (fs::exists(intermediaryAssetPath)) {
+	//Stop if the intermediary output exists unless in overwrite mode.
+	if (fs::exists(intermediaryOutputPath)) {
 		if (masterSettings.getOverwriteFiles()) {
-			std::cout << "Deleting old intermediary asset folder.\n";
-			fs::remove_all(intermediaryAssetPath);
-			std::cout << "Old intermediary asset folder deleted.\n";
+			std::cout << "Deleting old " << intermediaryOutputDescription << ".\n";
+			fs::remove_all(intermediaryOutputPath);
+			std::cout << "Old " << intermediaryOutputDescription << " deleted.\n";
 		} else {
-			std::cout << "Intermediary asset folder already exists at:"
-				<< intermediaryAssetPath.string()
+			std::cout << "An " << intermediaryOutputDescription << " already exists at:"
+				<< intermediaryOutputPath.string()
 				<< "\nNo files will be written.\n"
-				<< "Delete the folder or run again in overwrite mode.\n";
+				<< "Delete it or run again in overwrite mode.\n";
 			return;
 		}
 	}
 
+	//Values shared by intermediary files are written to a table next to them.
+	const bool internIntermediaryValues = masterSettings.getInternIntermediaryValues();
+	const fs::path internedValuesPath = getInternedValuesPath(intermediaryAssetPath);
+	if (fs::exists(internedValuesPath)) fs::remove(internedValuesPath);
+	ValueInternTable internTable;
+
+	//Every extracted string value is indexed by word for the query command.
+	const bool shardAssets = masterSettings.getShardCount() > 1;
+	const bool buildValueIndex = masterSettings.getBuildValueIndex() && !shardAssets;
+	const fs::path valueIndexPath = getValueIndexPath(intermediaryAssetPath);
+	if (fs::exists(valueIndexPath)) fs::remove(valueIndexPath);
+	ValueIndexWriter valueIndexWriter;
+	if (masterSettings.getBuildValueIndex() && shardAssets) std::cout << "The value index is not written by a shard, as it can not be combined with the other shards' indexes.\n";
+
+	//What this shard made, for merge-summaries.
+	ShardSummary shardSummary = ShardSummary("parse", masterSettings.getShardIndex(), masterSettings.getShardCount());
+	const std::string outputFolderName = getOutputFolderName(intermediaryOutputPath);
+
+	IntermediaryBundleWriter bundleWriter;
+	if (bundleIntermediaryFiles && !bundleWriter.open(intermediaryOutputPath)) {
+		std::cout << "Failed to create intermediary bundle at:\n"
+			<< intermediaryOutputPath.string() << std::endl;
+		return;
+	}
+
+	//Writes an intermediary file, or appends it to the bundle.
+	auto writeIntermediary = [&](const std::string & intermediaryAssetPathFragment, std::string intermediaryText) {
+		if (bundleIntermediaryFiles) {
+			bundleWriter.append(intermediaryAssetPathFragment, intermediaryText);
+			return;
+		}
+		//Where the intermediary asset should go.
+		fs::path intermediaryPath = intermediaryAssetPath;
+		intermediaryPath += fs::path(intermediaryAssetPathFragment).make_preferred();
+
+		//Write the file
+		std::stringstream intermediaryStream(std::move(intermediaryText));
+		if (!writeStringStreamToPath(intermediaryStream, intermediaryPath)) {
+			std::lock_guard<std::mutex> lock(consoleMutex);
+			std::cout << "Failed to write intermediary file to:\n"
+				<< intermediaryPath.string() << std::endl;
+		}
+	};
+	//Intermediary files with interned values, held until every value is interned.
+	std::mutex pendingIntermediaryMutex;
+	std::vector<std::pair<std::string, std::string>> allPendingIntermediaries;
+
 	std::cout << "Making intermediary files.\n";
 
 	auto startTime = std::chrono::high_resolution_clock::now();
-	int totalIntermediaryFilesMade = 0;
-	JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter();
-	//Iteratively parse source assets.
-	for (const auto & directory : fs::recursive_directory_iterator(sourceAssetPath)) {
-		if (directory.path().has_extension()) {
-
-			//Check if the extension is in allFileSettings.
-			const std::string extension = directory.path().extension().string();
-			for (FileSettings & fileSettings : allFileSettings) {
-				if (extension == fileSettings.getFileExtension()) {
-					//Source JSON.
-					const json sourceJson = fetchJson(directory, fileSettings.getValuesContainNewlines());
+	std::atomic<int> totalIntermediaryFilesMade = 0;
+	std::atomic<int> totalSourceAssets = 0;
+	AssetScheduler scheduler = AssetScheduler(masterSettings.getWorkerThreads(), masterSettings.getMaxMemoryBytes());
+	const bool useMemoryBudget = masterSettings.getMaxMemoryBytes() > 0;
+	//Byte identical source assets are only parsed once.
+	const bool deduplicateIdenticalAssets = masterSettings.getDeduplicateIdenticalAssets();
+	ContentHashMemo intermediaryMemo;
+	//Folders filtered out are never read.
+	AssetPathFilter pathFilter = AssetPathFilter(masterSettings.getIncludePaths(), masterSettings.getExcludePaths());
+	pathFilter.setShard(masterSettings.getShardIndex(), masterSettings.getShardCount());
+	//Assets other assets refer to, loaded as they are asked for.
+	AssetIndex assetIndex = AssetIndex(&sourceLayers, AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()));
+	//Parse source assets as the walk finds them.
+	sourceLayers.forEachAsset(AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()), getAllFileExtensions(allFileSettings), &pathFilter, [&](const std::string & assetPath) {
+		//Every parse target for the extension is written from the same source parse.
+		const std::vector<FileSettings *> allTargetSettings = getExtensionTargetSettings(allFileSettings, fs::path(assetPath).extension().string());
+		if (allTargetSettings.empty()) return;
+		totalSourceAssets++;
 
-					std::stringstream intermediaryText;
-					int currentValuesToKeep = intermediaryWriter.writeIntermediaryFile(intermediaryText, fileSettings, sourceJson);
+		const std::uint64_t estimatedBytes = useMemoryBudget ? AssetScheduler::estimateFootprint(assetPath, sourceLayers.getAssetSize(assetPath)) : 0;
+		scheduler.submit(estimatedBytes, [&, assetPath, allTargetSettings]() {
+			AllocationFileScope allocationScope = AllocationFileScope(assetPath);
+			//Every target shares the source text and parsed JSON.
+			SourceAsset sourceAsset;
+			if (!sourceLayers.fetchSourceAsset(assetPath, sourceAsset)) return;
 
-					//If there were any values to keep save the file.
-					if (currentValuesToKeep > 0) {
-						//Where the intermediary asset should go.
-						fs::path intermediaryPath = intermediaryAssetPath;
-						std::string pathFragment = directory.path().string();
-						pathFragment.erase(0, sourceAssetPath.string().length());
-						intermediaryPath += pathFragment;
-
-						//Write the file
-						if (!writeStringStreamToPath(intermediaryText, intermediaryPath)) {
-							std::cout << "Failed to write intermediary file to:\n"
-								<< intermediaryPath.string() << std::endl;
-								
-						}
+			for (FileSettings * targetSettings : allTargetSettings) {
+				FileSettings & fileSettings = *targetSettings;
+				auto makeIntermediary = [&]() {
+					//Source JSON with every layer's patches applied.
+					const std::shared_ptr<const json> sourceJson = sourceLayers.fetchSourceJson(sourceAsset, fileSettings.getValuesContainNewlines());
 
-						totalIntermediaryFilesMade++;
+					std::stringstream intermediaryText;
+					JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter(internIntermediaryValues ? &internTable : nullptr, &assetIndex, assetPath);
+					intermediaryWriter.setRecordValues(buildValueIndex);
+					MemoResult result;
+					result.count = intermediaryWriter.writeIntermediaryFile(intermediaryText, fileSettings, *sourceJson);
+					result.text = intermediaryText.str();
+					result.internedIds = intermediaryWriter.getInternedIds();
+					result.allExtractedValues = intermediaryWriter.getExtractedValues();
+					return result;
+				};
+				MemoResult intermediary;
+				if (deduplicateIdenticalAssets) {
+					bool reused = true;
+					//Relative references make the result depend on the folder too.
+					const std::string folderKey = fileSettings.hasResolvedPointers() ? fs::path(assetPath).parent_path().generic_string() : "";
+					intermediary = intermediaryMemo.fetchOrMake(std::to_string(sourceAsset.contentHash) + fileSettings.getFileExtension() + folderKey + '|' + fileSettings.getTargetName(), sourceAsset.text.size(), [&]() {
+						reused = false;
+						return makeIntermediary();
+					});
+					//Every copy counts as a use of its interned values.
+					if (reused && internIntermediaryValues) internTable.addUses(intermediary.internedIds);
+				} else {
+					intermediary = makeIntermediary();
+				}
+
+				//If there were any values to keep save the file.
+				if (intermediary.count > 0) {
+					const std::string intermediaryAssetPathFragment = getTargetIntermediaryPath(fileSettings.getTargetName(), assetPath);
+					if (buildValueIndex) valueIndexWriter.addAsset(intermediaryAssetPathFragment, fileSettings.getFileExtension(), intermediary.allExtractedValues);
+					if (shardAssets) shardSummary.addOutput(outputFolderName, intermediaryAssetPathFragment);
+					if (internIntermediaryValues) {
+						//Written once every value is interned and the ids are sorted.
+						std::lock_guard<std::mutex> lock(pendingIntermediaryMutex);
+						allPendingIntermediaries.emplace_back(intermediaryAssetPathFragment, std::move(intermediary.text));
+					} else {
+						writeIntermediary(intermediaryAssetPathFragment, std::move(intermediary.text));
 					}
-					//There can only be one match.
-					break;
+
+					totalIntermediaryFilesMade++;
 				}
 			}
+		});
+	});
+	//Wait for every asset to be parsed.
+	scheduler.finish();
+
+	//Ids are given out in the order threads reach values, so they are sorted before any intermediary file is written.
+	if (internIntermediaryValues) {
+		internTable.sortValues();
+		std::sort(allPendingIntermediaries.begin(), allPendingIntermediaries.end());
+		for (auto & [intermediaryAssetPathFragment, intermediaryText] : allPendingIntermediaries) {
+			writeIntermediary(intermediaryAssetPathFragment, internTable.renumberReferences(intermediaryText));
+			intermediaryText = std::string();
+		}
+		allPendingIntermediaries.clear();
+	}
+
+	//Write the bundle index.
+	if (bundleIntermediaryFiles && !bundleWriter.close()) {
+		std::cout << "Failed to finish writing intermediary bundle at:\n"
+			<< intermediaryOutputPath.string() << std::endl;
+	}
+
+	//Write the interned value table.
+	if (internIntermediaryValues) {
+		std::stringstream tableText;
+		internTable.writeTable(tableText);
+		if (writeStringStreamToPath(tableText, internedValuesPath)) {
+			std::cout << internTable.getValueCount() << " unique values interned at:\n"
+				<< internedValuesPath.string() << std::endl;
+		} else {
+			std::cout << "Failed to write interned value table to:\n"
+				<< internedValuesPath.string() << std::endl;
+		}
+	}
+
+	//Write the value index.
+	if (buildValueIndex) {
+		if (valueIndexWriter.write(valueIndexPath)) {
+			std::cout << "Values of " << valueIndexWriter.getAssetCount() << " intermediary files indexed at:\n"
+				<< valueIndexPath.string() << std::endl;
+		} else {
+			std::cout << "Failed to write value index to:\n"
+				<< valueIndexPath.string() << std::endl;
+		}
+	}
+
+	//Write what this shard made.
+	if (shardAssets) {
+		shardSummary.addCounter("sourceAssets", totalSourceAssets);
+		shardSummary.addCounter("intermediaryFiles", totalIntermediaryFilesMade);
+		shardSummary.addCounter("reusedParses", intermediaryMemo.getReusedCount());
+		std::stringstream summaryText;
+		shardSummary.writeSummary(summaryText);
+		const fs::path summaryPath = getShardSummaryPath(intermediaryOutputPath, masterSettings.getShardIndex(), masterSettings.getShardCount());
+		if (writeStringStreamToPath(summaryText, summaryPath)) {
+			std::cout << "Shard " << masterSettings.getShardIndex() << " of " << masterSettings.getShardCount() << " summary written to:\n"
+				<< summaryPath.string() << std::endl;
+		} else {
+			std::cout << "Failed to write shard summary to:\n"
+				<< summaryPath.string() << std::endl;
 		}
 	}
 
 	auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - startTime);
 	//Finished parse notification
 	std::cout << totalIntermediaryFilesMade << " intermediary files created in " << duration.count() << "s at:\n"
-		<< intermediaryAssetPath.string() << std::endl;
+		<< intermediaryOutputPath.string() << std::endl;
+	if (intermediaryMemo.getReusedCount() > 0) std::cout << intermediaryMemo.getReusedCount() << " identical source assets reused an earlier parse.\n";
+}
+
+void makePatches(MasterSettings & masterSettings, SourceLayers & sourceLayers, std::vector<std::pair<fs::path, fs::path>> allTreePaths, std::vector<FileSettings> allFileSettings, ValueTransformer * valueTransformer) {
+	//Intermediary files are either read from a folder or a single bundle.
+	const bool bundleIntermediaryFiles = masterSettings.getBundleIntermediaryFiles();
+	const bool internIntermediaryValues = masterSettings.getInternIntermediaryValues();
+	const bool writeChangedFilesOnly = masterSettings.getWriteChangedFilesOnly();
+
+	//Every intermediary asset folder and the patch output folder made from it, such as one per language.
+	struct PatchTree {
+		fs::path intermediaryAssetPath;
+		fs::path patchOutputPath;
+		std::string outputFolderName;
+		IntermediaryBundleReader bundleReader;
+		ValueInternTable internTable;
+		std::unique_ptr<OutputSynchroniser> outputSynchroniser;
+		std::atomic<int> totalPatchesMade = 0;
+		std::atomic<int> totalValuesAltered = 0;
+	};
+	std::vector<std::unique_ptr<PatchTree>> allPatchTrees;
+	for (const auto & [intermediaryAssetPath, patchOutputPath] : allTreePaths) {
+		const fs::path intermediaryBundlePath = getIntermediaryBundlePath(intermediaryAssetPath);
+
+		//Skip if the intermediary asset folder or bundle does not exist.
+		if (bundleIntermediaryFiles) {
+			if (!fs::exists(intermediaryBundlePath)) {
+				std::cout << "The intermediary bundle is missing.\n"
+					<< intermediaryBundlePath.string()
+					<< "\nThere is nothing to do, aborting.\n";
+				continue;
+			}
+		} else if (warnIfNothingAtPath(intermediaryAssetPath, "intermediary asset")) {
+			continue;
+		}
+
+		//Skip if the bundle is not valid.
+		std::unique_ptr<PatchTree> patchTree = std::make_unique<PatchTree>();
+		patchTree->intermediaryAssetPath = intermediaryAssetPath;
+		patchTree->patchOutputPath = patchOutputPath;
+		patchTree->outputFolderName = getOutputFolderName(patchOutputPath);
+		if (bundleIntermediaryFiles && !patchTree->bundleReader.open(intermediaryBundlePath)) {
+			std::cout << "The intermediary bundle could not be read.\n"
+				<< intermediaryBundlePath.string()
+				<< "\nAborting.\n";
+			continue;
+		}
+
+		//Skip if intermediary values are interned and the table can not be loaded.
+		if (internIntermediaryValues && !patchTree->internTable.loadTable(getInternedValuesPath(intermediaryAssetPath))) {
+			std::cout << "The interned value table could not be read.\n"
+				<< getInternedValuesPath(intermediaryAssetPath).string()
+				<< "\nAborting.\n";
+			continue;
+		}
+
+		//Skip if the patch output folder exists unless in overwrite mode.
+		if (fs::exists(patchOutputPath)) {
+			if (masterSettings.getOverwriteFiles() && writeChangedFilesOnly) {
+				std::cout << "Updating existing patch output folder.\n";
+			} else if (masterSettings.getOverwriteFiles()) {
+				std::cout << "Deleting old patch output folder.\n";
+				fs::remove_all(patchOutputPath);
+				std::cout << "Old patch output folder deleted.\n";
+			} else {
+				std::cout << "Patch output folder already exists at:"
+					<< patchOutputPath.string()
+					<< "\nNo files will be written.\n"
+					<< "Delete the folder or run again in overwrite mode.\n";
+				continue;
+			}
+		}
+		//Patches identical to the existing output are not written again.
+		if (writeChangedFilesOnly) patchTree->outputSynchroniser = std::make_unique<OutputSynchroniser>(patchOutputPath);
+		allPatchTrees.push_back(std::move(patchTree));
+	}
+	if (allPatchTrees.empty()) return;
+
+	std::cout << "Making patches.\n";
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	const JsonPatchWriter basePatchWriter = JsonPatchWriter(masterSettings);
+	AssetScheduler scheduler = AssetScheduler(masterSettings.getWorkerThreads(), masterSettings.getMaxMemoryBytes());
+	const bool useMemoryBudget = masterSettings.getMaxMemoryBytes() > 0;
+	//Identical source and intermediary pairs only have their patch made once.
+	ContentHashMemo patchMemo;
+	ContentHashMemo * usedPatchMemo = masterSettings.getDeduplicateIdenticalAssets() ? &patchMemo : nullptr;
+	AssetPathFilter pathFilter = AssetPathFilter(masterSettings.getIncludePaths(), masterSettings.getExcludePaths());
+	pathFilter.setShard(masterSettings.getShardIndex(), masterSettings.getShardCount());
+	//What this shard made, for merge-summaries.
+	const bool shardAssets = masterSettings.getShardCount() > 1;
+	ShardSummary shardSummary = ShardSummary("makepatches", masterSettings.getShardIndex(), masterSettings.getShardCount());
+
+	//Intermediary files of the same asset from every parse target are merged into one patch, using every target's values.
+	const std::vector<std::string> allTargetNames = getAllTargetNames(allFileSettings);
+	std::vector<FileSettings> allMergedFileSettings;
+	struct TreeIntermediary {
+		std::size_t treeIndex = 0;
+		FileSettings * fileSettings = nullptr;
+		fs::path filePath;
+		const BundleEntry * entry = nullptr;
+	};
+	std::map<std::string, std::vector<TreeIntermediary>> allTreeIntermediaries;
+
+	if (allPatchTrees.size() == 1 && allTargetNames.size() <= 1) {
+		PatchTree & patchTree = *allPatchTrees[0];
+		ValueInternTable * internTable = internIntermediaryValues ? &patchTree.internTable : nullptr;
+		if (bundleIntermediaryFiles) {
+			//Generate patches from every bundle entry.
+			for (const BundleEntry & entry : patchTree.bundleReader.getAllEntries()) {
+				if (!pathFilter.matchesFile(entry.assetPath)) continue;
+				const fs::path entryPath = fs::path(entry.assetPath);
+				const std::string extension = entryPath.extension().string();
+				//Check if the extension should be read.
+				for (FileSettings & fileSettings : allFileSettings) {
+					if (extension == fileSettings.getFileExtension()) {
+						//The source asset is parsed along with its intermediary, and is usually far larger.
+						const std::uint64_t estimatedBytes = useMemoryBudget ? AssetScheduler::estimateFootprint(entryPath, sourceLayers.getAssetSize(entry.assetPath) + entry.length) : 0;
+						scheduler.submit(estimatedBytes, [&, entryPath]() {
+							AllocationFileScope allocationScope = AllocationFileScope(entry.assetPath);
+							SourceAsset sourceAsset;
+							if (!fetchPatchSource(sourceLayers, entry.assetPath, sourceAsset)) return;
+							JsonPatchWriter patchWriter = basePatchWriter;
+							if (makePatch(patchWriter, fileSettings, sourceLayers, sourceAsset, internTable, valueTransformer, usedPatchMemo, patchTree.outputSynchroniser.get(), patchTree.patchOutputPath, std::string(patchTree.bundleReader.fetchText(entry)), patchTree.totalValuesAltered)) {
+								patchTree.totalPatchesMade++;
+								if (shardAssets) shardSummary.addOutput(patchTree.outputFolderName, entry.assetPath + ".patch");
+							}
+						});
+					}
+				}
+			}
+		} else {
+			//Generate patches as the walk finds intermediary files.
+			DirectoryWalker intermediaryWalker = DirectoryWalker(AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()), getAllFileExtensions(allFileSettings), &pathFilter);
+			intermediaryWalker.walk(patchTree.intermediaryAssetPath, [&](const fs::path & intermediaryPath) {
+				//Get the file extension.
+				const std::string extension = intermediaryPath.extension().string();
+				//Check if the extension should be read.
+				for (FileSettings & fileSettings : allFileSettings) {
+					if (extension == fileSettings.getFileExtension()) {
+						//The source asset is parsed along with its intermediary, and is usually far larger.
+						std::uint64_t estimatedBytes = 0;
+						if (useMemoryBudget) {
+							std::error_code error;
+							const std::uintmax_t intermediarySize = fs::file_size(intermediaryPath, error);
+							estimatedBytes = AssetScheduler::estimateFootprint(intermediaryPath, sourceLayers.getAssetSize(toAssetPath(intermediaryPath, patchTree.intermediaryAssetPath)) + (error ? 0 : intermediarySize));
+						}
+						scheduler.submit(estimatedBytes, [&, intermediaryPath]() {
+							AllocationFileScope allocationScope = AllocationFileScope(toAssetPath(intermediaryPath, patchTree.intermediaryAssetPath));
+							std::string intermediaryText;
+							if (!tryFetchText(intermediaryPath, intermediaryText)) return;
+
+							const std::string assetPath = toAssetPath(intermediaryPath, patchTree.intermediaryAssetPath);
+							SourceAsset sourceAsset;
+							if (!fetchPatchSource(sourceLayers, assetPath, sourceAsset)) return;
+							JsonPatchWriter patchWriter = basePatchWriter;
+							if (makePatch(patchWriter, fileSettings, sourceLayers, sourceAsset, internTable, valueTransformer, usedPatchMemo, patchTree.outputSynchroniser.get(), patchTree.patchOutputPath, std::move(intermediaryText), patchTree.totalValuesAltered)) {
+								patchTree.totalPatchesMade++;
+								if (shardAssets) shardSummary.addOutput(patchTree.outputFolderName, assetPath + ".patch");
+							}
+						});
+					}
+				}
+			});
+		}
+	} else {
+		allMergedFileSettings = mergeTargetsByExtension(allFileSettings);
+		//Find the intermediary files of every tree and target first, so each source asset is only parsed once for all of them.
+		for (std::size_t treeIndex = 0; treeIndex < allPatchTrees.size(); treeIndex++) {
+			PatchTree & patchTree = *allPatchTrees[treeIndex];
+			for (const std::string & targetName : allTargetNames) {
+				auto addIntermediary = [&](const std::string & assetPath, TreeIntermediary intermediary) {
+					const std::string extension = fs::path(assetPath).extension().string();
+					for (FileSettings & fileSettings : allFileSettings) {
+						if (fileSettings.getTargetName() == targetName && extension == fileSettings.getFileExtension()) {
+							intermediary.treeIndex = treeIndex;
+							intermediary.fileSettings = &fileSettings;
+							allTreeIntermediaries[assetPath].push_back(intermediary);
+							return;
+						}
+					}
+				};
+				if (bundleIntermediaryFiles) {
+					const std::string targetPrefix = getTargetIntermediaryPath(targetName, "/");
+					for (const BundleEntry & entry : patchTree.bundleReader.getAllEntries()) {
+						if (!entry.assetPath.starts_with(targetPrefix)) continue;
+						const std::string assetPath = entry.assetPath.substr(targetPrefix.length() - 1);
+						if (pathFilter.matchesFile(assetPath)) addIntermediary(assetPath, {0, nullptr, "", &entry});
+					}
+				} else {
+					const fs::path targetAssetPath = targetName.empty() ? patchTree.intermediaryAssetPath : patchTree.intermediaryAssetPath / targetName;
+					if (!fs::is_directory(targetAssetPath)) continue;
+					DirectoryWalker intermediaryWalker = DirectoryWalker(AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()), getAllFileExtensions(allFileSettings), &pathFilter);
+					std::mutex walkMutex;
+					intermediaryWalker.walk(targetAssetPath, [&](const fs::path & intermediaryPath) {
+						std::lock_guard<std::mutex> lock(walkMutex);
+						addIntermediary(toAssetPath(intermediaryPath, targetAssetPath), {0, nullptr, intermediaryPath, nullptr});
+					});
+				}
+			}
+		}
+
+		for (const auto & [assetPath, allIntermediaries] : allTreeIntermediaries) {
+			FileSettings * mergedFileSettings = nullptr;
+			for (FileSettings & fileSettings : allMergedFileSettings) {
+				if (fileSettings.getFileExtension() == allIntermediaries[0].fileSettings->getFileExtension()) mergedFileSettings = &fileSettings;
+			}
+			//The source asset is parsed once along with every tree's intermediary, and is usually far larger than them.
+			std::uint64_t estimatedBytes = 0;
+			if (useMemoryBudget) {
+				estimatedBytes = AssetScheduler::estimateFootprint(assetPath, sourceLayers.getAssetSize(assetPath));
+				for (const TreeIntermediary & intermediary : allIntermediaries) {
+					estimatedBytes += intermediary.entry != nullptr ? AssetScheduler::estimateFootprint(assetPath, intermediary.entry->length) : scheduler.estimateFootprint(intermediary.filePath);
+				}
+			}
+			scheduler.submit(estimatedBytes, [&, mergedFileSettings]() {
+				AllocationFileScope allocationScope = AllocationFileScope(assetPath);
+				//Every tree shares the source text and parsed JSON.
+				SourceAsset sourceAsset;
+				if (!fetchPatchSource(sourceLayers, assetPath, sourceAsset)) return;
+
+				//Intermediary files were found tree by tree, so each tree's are next to each other.
+				for (std::size_t first = 0, last = 0; first < allIntermediaries.size(); first = last) {
+					while (last < allIntermediaries.size() && allIntermediaries[last].treeIndex == allIntermediaries[first].treeIndex) last++;
+					PatchTree & patchTree = *allPatchTrees[allIntermediaries[first].treeIndex];
+
+					//Targets are merged in name order, the first to have a value wins.
+					json mergedJson = json::object();
+					std::string intermediaryText;
+					for (std::size_t i = first; i < last; i++) {
+						const TreeIntermediary & intermediary = allIntermediaries[i];
+						intermediaryText.clear();
+						if (intermediary.entry != nullptr) {
+							intermediaryText = patchTree.bundleReader.fetchText(*intermediary.entry);
+						} else if (!tryFetchText(intermediary.filePath, intermediaryText)) {
+							continue;
+						}
+						//A single target's intermediary file is used as it is.
+						if (last - first == 1) break;
+						const json targetJson = parseJsonText(std::move(intermediaryText), intermediary.fileSettings->getValuesContainNewlines());
+						for (auto & [key, value] : targetJson.items()) {
+							if (!mergedJson.contains(key) || (key == "patchMakerComment" && mergedJson[key] == "")) mergedJson[key] = value;
+						}
+					}
+					FileSettings & fileSettings = last - first == 1 ? *allIntermediaries[first].fileSettings : *mergedFileSettings;
+					if (last - first > 1) intermediaryText = mergedJson.dump();
+
+					JsonPatchWriter patchWriter = basePatchWriter;
+					if (makePatch(patchWriter, fileSettings, sourceLayers, sourceAsset, internIntermediaryValues ? &patchTree.internTable : nullptr, valueTransformer, usedPatchMemo, patchTree.outputSynchroniser.get(), patchTree.patchOutputPath, std::move(intermediaryText), patchTree.totalValuesAltered)) {
+						patchTree.totalPatchesMade++;
+						if (shardAssets) shardSummary.addOutput(patchTree.outputFolderName, assetPath + ".patch");
+					}
+				}
+			});
+		}
+	}
+	//Wait for every patch to be made.
+	scheduler.finish();
+
+	auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - startTime);
+	for (std::unique_ptr<PatchTree> & patchTree : allPatchTrees) {
+		//Remove patches that were not made this run, leaving those of assets filtered out and files that are not patches, such as the mod's _metadata.
+		int totalStaleRemoved = 0;
+		if (writeChangedFilesOnly) {
+			totalStaleRemoved = patchTree->outputSynchroniser->removeStaleFiles([&](const fs::path & filePath) {
+				std::string assetPath = toAssetPath(filePath, patchTree->patchOutputPath);
+				if (!assetPath.ends_with(".patch")) return false;
+				assetPath.erase(assetPath.length() - 6);
+				return pathFilter.matchesFile(assetPath);
+			});
+		}
+
+		if (shardAssets) {
+			shardSummary.addCounter("patches", patchTree->totalPatchesMade);
+			shardSummary.addCounter("operationSets", patchTree->totalValuesAltered);
+			if (writeChangedFilesOnly) {
+				shardSummary.addCounter("patchFilesWritten", patchTree->outputSynchroniser->getWrittenCount());
+				shardSummary.addCounter("unchangedPatchFiles", patchTree->outputSynchroniser->getUnchangedCount());
+				shardSummary.addCounter("stalePatchFilesRemoved", totalStaleRemoved);
+			}
+		}
+
+		//Finished patch output notification
+		std::cout << patchTree->totalPatchesMade << " patches containing " << patchTree->totalValuesAltered << " operation sets created in " << duration.count() << "s at:\n"
+			<< patchTree->patchOutputPath.string() << std::endl;
+		if (writeChangedFilesOnly) {
+			std::cout << patchTree->outputSynchroniser->getWrittenCount() << " patch files written, " << patchTree->outputSynchroniser->getUnchangedCount() << " were unchanged and "
+				<< totalStaleRemoved << " stale patch files removed.\n";
+		}
+	}
+	if (patchMemo.getReusedCount() > 0) std::cout << patchMemo.getReusedCount() << " identical assets reused an earlier patch.\n";
+	if (valueTransformer != nullptr) std::cout << valueTransformer->getTransformedValueCount() << " values changed by transform rules.\n";
+
+	//Write what this shard made, next to the first patch output folder.
+	if (shardAssets) {
+		shardSummary.addCounter("reusedPatches", patchMemo.getReusedCount());
+		if (valueTransformer != nullptr) shardSummary.addCounter("transformedValues", valueTransformer->getTransformedValueCount());
+		std::stringstream summaryText;
+		shardSummary.writeSummary(summaryText);
+		const fs::path summaryPath = getShardSummaryPath(allPatchTrees[0]->patchOutputPath, masterSettings.getShardIndex(), masterSettings.getShardCount());
+		if (writeStringStreamToPath(summaryText, summaryPath)) {
+			std::cout << "Shard " << masterSettings.getShardIndex() << " of " << masterSettings.getShardCount() << " summary written to:\n"
+				<< summaryPath.string() << std::endl;
+		} else {
+			std::cout << "Failed to write shard summary to:\n"
+				<< summaryPath.string() << std::endl;
+		}
+	}
 }
 
-void makePatches(MasterSettings & masterSettings, const fs::path sourceAssetPath, const fs::path intermediaryAssetPath, const fs::path patchOutputPath, std::vector<FileSettings> allFileSettings) {
-	//Stop if the source asset folder does not exist.
-	if (warnIfNothingAtPath(sourceAssetPath, "source asset")) return;
-	//Stop if the intermediary asset folder does not exist.
-	if (warnIfNothingAtPath(intermediaryAssetPath, "intermediary asset")) return;
+/**
+ * Prints the intermediary file and patch of a sample of source assets of every configured file type, along with how often each pointer matched.
+ * Samples are spread evenly over the sorted asset paths, so they come from across the folder tree. Nothing is written.
+ * Existing intermediary files are used for the patches, so edits can be previewed too.
+ * 
+ * @param masterSettings The settings to use.
+ * @param sourceLayers The source layers assets are sampled from.
+ * @param intermediaryAssetPath The intermediary asset folder edited intermediary files are read from, if there are any.
+ * @param allFileSettings The settings of every configured file type.
+ * @param samplesPerExtension How many source assets to sample for each file type.
+ * @param valueTransformer Rewrites intermediary values before the patch is made, null to use them as they are.
+ */
+void previewAssets(MasterSettings & masterSettings, SourceLayers & sourceLayers, const fs::path intermediaryAssetPath, std::vector<FileSettings> allFileSettings, int samplesPerExtension, ValueTransformer * valueTransformer) {
+	ConfigProfiler::enable();
+
+	//Find every matching asset, grouped by extension.
+	std::map<std::string, std::vector<std::string>> allAssetPathsByExtension;
+	std::mutex assetPathsMutex;
+	AssetPathFilter pathFilter = AssetPathFilter(masterSettings.getIncludePaths(), masterSettings.getExcludePaths());
+	sourceLayers.forEachAsset(AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()), getAllFileExtensions(allFileSettings), &pathFilter, [&](const std::string & assetPath) {
+		std::lock_guard<std::mutex> lock(assetPathsMutex);
+		allAssetPathsByExtension[fs::path(assetPath).extension().string()].push_back(assetPath);
+	});
 
-	//Stop if the patch output folder exists unless in overwrite mode.
-	if (fs::exists(patchOutputPath)) {
+	//Edited intermediary files are used if they exist.
+	const bool bundleIntermediaryFiles = masterSettings.getBundleIntermediaryFiles();
+	IntermediaryBundleReader bundleReader;
+	const bool bundleOpen = bundleIntermediaryFiles && bundleReader.open(getIntermediaryBundlePath(intermediaryAssetPath));
+	ValueInternTable internTable;
+	const bool internTableLoaded = masterSettings.getInternIntermediaryValues() && internTable.loadTable(getInternedValuesPath(intermediaryAssetPath));
+
+	AssetIndex assetIndex = AssetIndex(&sourceLayers, AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()));
+	JsonPatchWriter patchWriter = JsonPatchWriter(masterSettings);
+	for (auto & [extension, allAssetPaths] : allAssetPathsByExtension) {
+		std::sort(allAssetPaths.begin(), allAssetPaths.end());
+		const std::size_t sampleCount = std::min<std::size_t>(samplesPerExtension, allAssetPaths.size());
+		std::cout << "Previewing " << sampleCount << " of " << allAssetPaths.size() << ' ' << extension << " assets.\n";
+
+		for (std::size_t sample = 0; sample < sampleCount; sample++) {
+			const std::string & assetPath = allAssetPaths[(2 * sample + 1) * allAssetPaths.size() / (2 * sampleCount)];
+			for (FileSettings & fileSettings : allFileSettings) {
+				if (fileSettings.getFileExtension() != extension) continue;
+				std::cout << "\n== " << assetPath;
+				if (!fileSettings.getTargetName().empty()) std::cout << " (" << fileSettings.getTargetName() << ')';
+				std::cout << " ==\n";
+
+				std::shared_ptr<const json> sourceJson;
+				try {
+					sourceJson = sourceLayers.fetchSourceJson(assetPath, fileSettings.getValuesContainNewlines());
+				} catch (const json::exception & exception) {
+					std::cout << "Could not be parsed:\n"
+						<< exception.what() << '\n';
+					continue;
+				}
+				if (!sourceJson) continue;
+
+				std::stringstream intermediaryText;
+				JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter(nullptr, &assetIndex, assetPath);
+				const int totalValues = intermediaryWriter.writeIntermediaryFile(intermediaryText, fileSettings, *sourceJson);
+				if (totalValues <= 0) {
+					std::cout << "No values matched, no intermediary file would be made.\n";
+					continue;
+				}
+				std::cout << "Intermediary file with " << totalValues << " values:\n"
+					<< intermediaryText.str() << '\n';
+
+				//Patch from the edited intermediary file if there is one.
+				const std::string intermediaryPathFragment = getTargetIntermediaryPath(fileSettings.getTargetName(), assetPath);
+				std::string editedText;
+				bool edited = false;
+				if (bundleOpen && bundleReader.contains(intermediaryPathFragment)) {
+					editedText = bundleReader.fetchText(intermediaryPathFragment);
+					edited = true;
+				} else if (!bundleIntermediaryFiles) {
+					fs::path intermediaryPath = intermediaryAssetPath;
+					intermediaryPath += fs::path(intermediaryPathFragment).make_preferred();
+					edited = tryFetchText(intermediaryPath, editedText);
+				}
+				//Transform rules can make a patch from an unedited intermediary file.
+				if (!edited && valueTransformer == nullptr) {
+					std::cout << "No edited intermediary file, an unedited one makes no patch.\n";
+					continue;
+				}
+				if (!edited) editedText = intermediaryText.str();
+				const std::string intermediaryDescription = edited ? "edited intermediary file" : "transformed intermediary file";
+				json editedJson;
+				try {
+					editedJson = parseJsonText(std::move(editedText), fileSettings.getValuesContainNewlines());
+				} catch (const json::exception & exception) {
+					std::cout << "The " << intermediaryDescription << " could not be parsed:\n"
+						<< exception.what() << '\n';
+					continue;
+				}
+				if (internTableLoaded) internTable.resolveReferences(editedJson);
+				if (valueTransformer != nullptr) valueTransformer->transformIntermediary(editedJson, fileSettings.getFileExtension());
+				std::stringstream patchText;
+				JsonPatchWriter currentPatchWriter = patchWriter;
+				const int totalOps = currentPatchWriter.writePatchFile(patchText, fileSettings, *sourceJson, editedJson);
+				if (totalOps > 0) {
+					std::cout << "Patch from the " << intermediaryDescription << " with " << totalOps << " operation sets:\n"
+						<< patchText.str() << '\n';
+				} else {
+					std::cout << "The " << intermediaryDescription << " makes no patch.\n";
+				}
+			}
+		}
+	}
+	std::cout << '\n';
+}
+
+/**
+ * Parses source assets from a tar archive as they arrive, writing their intermediary files to another tar archive.
+ * Source layers and other assets are not available, so resolved values are skipped and values are never interned.
+ * 
+ * @param masterSettings The settings to use.
+ * @param allFileSettings The parse targets to use.
+ * @param tarInput The archive with source assets in a source_assets folder.
+ * @param tarOutput Receives the intermediary files in an intermediary_assets folder.
+ */
+void streamParseAssets(MasterSettings & masterSettings, std::vector<FileSettings> allFileSettings, std::istream & tarInput, std::ostream & tarOutput) {
+	std::cout << "Making intermediary files from the archive on standard input.\n";
+	if (masterSettings.getInternIntermediaryValues()) std::cout << "Intermediary values are not interned when streaming.\n";
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::atomic<int> totalIntermediaryFilesMade = 0;
+	AssetScheduler scheduler = AssetScheduler(masterSettings.getWorkerThreads(), masterSettings.getMaxMemoryBytes());
+	const bool useMemoryBudget = masterSettings.getMaxMemoryBytes() > 0;
+	AssetPathFilter pathFilter = AssetPathFilter(masterSettings.getIncludePaths(), masterSettings.getExcludePaths());
+	pathFilter.setShard(masterSettings.getShardIndex(), masterSettings.getShardCount());
+	const bool shardAssets = masterSettings.getShardCount() > 1;
+	ShardSummary shardSummary = ShardSummary("parse", masterSettings.getShardIndex(), masterSettings.getShardCount());
+	TarReader tarReader = TarReader(tarInput);
+	TarWriter tarWriter = TarWriter(tarOutput);
+
+	TarEntry entry;
+	while (tarReader.next(entry)) {
+		const std::string assetPath = stripTarRoot(entry.path, "source_assets");
+		if (assetPath.empty() || !pathFilter.matchesFile(assetPath)) continue;
+		const std::vector<FileSettings *> allTargetSettings = getExtensionTargetSettings(allFileSettings, fs::path(assetPath).extension().string());
+		if (allTargetSettings.empty()) continue;
+
+		//Submitting waits while the scheduler is full, so the archive is only read as fast as it is parsed.
+		const std::uint64_t estimatedBytes = useMemoryBudget ? AssetScheduler::estimateFootprint(assetPath, entry.data.size()) : 0;
+		scheduler.submit(estimatedBytes, [&, assetPath, allTargetSettings, sourceText = std::move(entry.data)]() {
+			//Every target shares the parsed JSON.
+			std::shared_ptr<const json> allSourceJson[2];
+			for (FileSettings * fileSettings : allTargetSettings) {
+				std::shared_ptr<const json> & sourceJson = allSourceJson[fileSettings->getValuesContainNewlines()];
+				if (!sourceJson) sourceJson = std::make_shared<const json>(parseJsonText(sourceText, fileSettings->getValuesContainNewlines()));
+
+				std::stringstream intermediaryText;
+				JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter(nullptr, nullptr, assetPath);
+				if (intermediaryWriter.writeIntermediaryFile(intermediaryText, *fileSettings, *sourceJson) > 0) {
+					const std::string intermediaryAssetPathFragment = getTargetIntermediaryPath(fileSettings->getTargetName(), assetPath);
+					tarWriter.append("intermediary_assets" + intermediaryAssetPathFragment, intermediaryText.str());
+					if (shardAssets) shardSummary.addOutput("intermediary_assets", intermediaryAssetPathFragment);
+					totalIntermediaryFilesMade++;
+				}
+			}
+		});
+	}
+	//Wait for every asset to be parsed.
+	scheduler.finish();
+	//The shard summary goes into the archive next to the intermediary files.
+	if (shardAssets) {
+		shardSummary.addCounter("intermediaryFiles", totalIntermediaryFilesMade);
+		std::stringstream summaryText;
+		shardSummary.writeSummary(summaryText);
+		tarWriter.append(getShardSummaryPath("intermediary_assets", masterSettings.getShardIndex(), masterSettings.getShardCount()).generic_string(), summaryText.str());
+	}
+	if (!tarWriter.finish()) std::cout << "Failed to write the intermediary archive to standard output.\n";
+
+	auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - startTime);
+	std::cout << totalIntermediaryFilesMade << " intermediary files streamed in " << duration.count() << "s.\n";
+}
+
+/**
+ * Makes patches from a tar archive of source assets and intermediary files as they arrive, writing them to another tar archive.
+ * Intermediary files are kept until their source asset arrives, and source assets without an intermediary file already read are skipped,
+ * so only the small intermediary files are held in memory however many source assets the archive has. intermediary_assets has to come first.
+ * 
+ * @param masterSettings The settings to use.
+ * @param allFileSettings The parse targets to use.
+ * @param tarInput The archive with source assets in a source_assets folder and intermediary files in an intermediary_assets folder.
+ * @param tarOutput Receives the patches in a patch_output folder.
+ * @param valueTransformer Rewrites intermediary values before the patch is made, null to use them as they are.
+ */
+void streamMakePatches(MasterSettings & masterSettings, std::vector<FileSettings> allFileSettings, std::istream & tarInput, std::ostream & tarOutput, ValueTransformer * valueTransformer) {
+	if (getAllTargetNames(allFileSettings).size() > 1) {
+		std::cout << "Streaming patches needs a single parse target.\n";
+		return;
+	}
+	if (masterSettings.getInternIntermediaryValues()) {
+		std::cout << "Streaming patches needs internIntermediaryValues to be off.\n";
+		return;
+	}
+
+	std::cout << "Making patches from the archive on standard input.\n";
+
+	auto startTime = std::chrono::high_resolution_clock::now();
+	std::atomic<int> totalPatchesMade = 0;
+	std::atomic<int> totalValuesAltered = 0;
+	const JsonPatchWriter basePatchWriter = JsonPatchWriter(masterSettings);
+	AssetScheduler scheduler = AssetScheduler(masterSettings.getWorkerThreads(), masterSettings.getMaxMemoryBytes());
+	const bool useMemoryBudget = masterSettings.getMaxMemoryBytes() > 0;
+	AssetPathFilter pathFilter = AssetPathFilter(masterSettings.getIncludePaths(), masterSettings.getExcludePaths());
+	pathFilter.setShard(masterSettings.getShardIndex(), masterSettings.getShardCount());
+	const bool shardAssets = masterSettings.getShardCount() > 1;
+	ShardSummary shardSummary = ShardSummary("makepatches", masterSettings.getShardIndex(), masterSettings.getShardCount());
+	TarReader tarReader = TarReader(tarInput);
+	TarWriter tarWriter = TarWriter(tarOutput);
+	std::unordered_map<std::string, std::string> allPendingIntermediaryTexts;
+	bool sourceAssetsStarted = false;
+	bool orderReported = false;
+	int totalUnmatchedSources = 0;
+
+	TarEntry entry;
+	while (tarReader.next(entry)) {
+		std::string assetPath = stripTarRoot(entry.path, "source_assets");
+		const bool isSource = !assetPath.empty();
+		if (!isSource) assetPath = stripTarRoot(entry.path, "intermediary_assets");
+		if (assetPath.empty() || !pathFilter.matchesFile(assetPath)) continue;
+		const std::vector<FileSettings *> allTargetSettings = getExtensionTargetSettings(allFileSettings, fs::path(assetPath).extension().string());
+		if (allTargetSettings.empty()) continue;
+
+		//Intermediary files wait for their source asset.
+		if (!isSource) {
+			if (sourceAssetsStarted && !orderReported) {
+				orderReported = true;
+				std::cout << "Intermediary files after source assets in the archive are only patched if their source asset comes later. Put intermediary_assets first.\n";
+			}
+			allPendingIntermediaryTexts[assetPath] = std::move(entry.data);
+			continue;
+		}
+		//Source assets are never kept, as the archive usually has far more of them than intermediary files.
+		sourceAssetsStarted = true;
+		auto pendingIntermediary = allPendingIntermediaryTexts.find(assetPath);
+		if (pendingIntermediary == allPendingIntermediaryTexts.end()) {
+			totalUnmatchedSources++;
+			continue;
+		}
+		std::string sourceText = std::move(entry.data);
+		std::string intermediaryText = std::move(pendingIntermediary->second);
+		allPendingIntermediaryTexts.erase(pendingIntermediary);
+
+		FileSettings * fileSettings = allTargetSettings[0];
+		const std::uint64_t estimatedBytes = useMemoryBudget ? AssetScheduler::estimateFootprint(assetPath, sourceText.size() + intermediaryText.size()) : 0;
+		scheduler.submit(estimatedBytes, [&, assetPath, fileSettings, sourceText = std::move(sourceText), intermediaryText = std::move(intermediaryText)]() {
+			const json sourceJson = parseJsonText(sourceText, fileSettings->getValuesContainNewlines());
+			json intermediaryJson = parseJsonText(intermediaryText, fileSettings->getValuesContainNewlines());
+			if (valueTransformer != nullptr) valueTransformer->transformIntermediary(intermediaryJson, fileSettings->getFileExtension());
+
+			std::stringstream patchText;
+			JsonPatchWriter patchWriter = basePatchWriter;
+			const int currentOps = patchWriter.writePatchFile(patchText, *fileSettings, sourceJson, intermediaryJson);
+			totalValuesAltered += currentOps;
+			//If there were no ops there is no file to save.
+			if (currentOps <= 0) return;
+			tarWriter.append("patch_output" + assetPath + ".patch", patchText.str());
+			if (shardAssets) shardSummary.addOutput("patch_output", assetPath + ".patch");
+			totalPatchesMade++;
+		});
+	}
+	//Wait for every patch to be made.
+	scheduler.finish();
+	//The shard summary goes into the archive next to the patches.
+	if (shardAssets) {
+		shardSummary.addCounter("patches", totalPatchesMade);
+		shardSummary.addCounter("operationSets", totalValuesAltered);
+		if (valueTransformer != nullptr) shardSummary.addCounter("transformedValues", valueTransformer->getTransformedValueCount());
+		std::stringstream summaryText;
+		shardSummary.writeSummary(summaryText);
+		tarWriter.append(getShardSummaryPath("patch_output", masterSettings.getShardIndex(), masterSettings.getShardCount()).generic_string(), summaryText.str());
+	}
+	if (!tarWriter.finish()) std::cout << "Failed to write the patch archive to standard output.\n";
+
+	for (const auto & [assetPath, intermediaryText] : allPendingIntermediaryTexts) {
+		std::cout << "Source asset \"" << fs::path(assetPath).make_preferred().string() << "\" not found after its intermediary file, skipping patch.\n";
+	}
+	if (totalUnmatchedSources > 0) std::cout << totalUnmatchedSources << " source assets had no intermediary file before them in the archive and were skipped.\n";
+
+	auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - startTime);
+	std::cout << totalPatchesMade << " patches containing " << totalValuesAltered << " operation sets streamed in " << duration.count() << "s.\n";
+}
+
+/**
+ * Looks up extracted values in the value index written by parse.
+ * 
+ * @param intermediaryAssetPath The intermediary asset folder the index was written next to.
+ * @param allQueryArguments Words values must contain, plus field:, asset:, length> and length< limits. Field statistics are listed if empty.
+ * @return If the index could be read and the query was valid.
+ */
+bool queryValues(const fs::path intermediaryAssetPath, std::vector<std::string> allQueryArguments) {
+	auto startTime = std::chrono::steady_clock::now();
+	const fs::path valueIndexPath = getValueIndexPath(intermediaryAssetPath);
+	ValueIndexReader indexReader;
+	if (!indexReader.open(valueIndexPath)) {
+		if (indexReader.isCorrupt()) {
+			std::cout << "The value index is corrupt, parse with buildValueIndex on to make it again.\n";
+		} else {
+			std::cout << "The value index could not be read, parse with buildValueIndex on to make it.\n";
+		}
+		std::cout << valueIndexPath.string() << std::endl;
+		return false;
+	}
+
+	//Without a query describe every configured pointer.
+	if (allQueryArguments.empty()) {
+		std::cout << indexReader.getValueCount() << " values in " << indexReader.getAssetCount() << " intermediary files.\n";
+		for (std::uint32_t fieldId = 0; fieldId < indexReader.getFieldCount(); fieldId++) {
+			const IndexedField field = indexReader.getField(fieldId);
+			std::cout << field.fieldName << "\n	" << field.valueCount << " values, " << field.minLength << " to " << field.maxLength << " characters, "
+				<< field.totalLength / std::max<std::uint32_t>(field.valueCount, 1) << " on average.\n";
+		}
+		return true;
+	}
+
+	ValueQuery query;
+	for (const std::string & argument : allQueryArguments) {
+		if (argument.starts_with("field:")) {
+			query.fieldFragment = argument.substr(6);
+		} else if (argument.starts_with("asset:")) {
+			query.assetFragment = argument.substr(6);
+		} else if (argument.starts_with("length>") || argument.starts_with("length<")) {
+			const std::string lengthText = argument.substr(7);
+			if (lengthText.empty() || lengthText.size() > 9 || !std::all_of(lengthText.begin(), lengthText.end(), [](char character) { return std::isdigit(static_cast<unsigned char>(character)); })) {
+				std::cout << "Invalid length:\n"
+					<< argument << std::endl;
+				return false;
+			}
+			const std::uint64_t length = std::stoull(lengthText);
+			if (argument[6] == '>') {
+				query.minLength = static_cast<std::uint32_t>(length + 1);
+			} else if (length > 0) {
+				query.maxLength = static_cast<std::uint32_t>(length - 1);
+			} else {
+				return true;
+			}
+		} else {
+			query.allTerms.push_back(argument);
+		}
+	}
+
+	const std::vector<std::uint32_t> allValueIds = indexReader.findValues(query);
+	if (indexReader.isCorrupt()) {
+		std::cout << "The value index is corrupt, parse with buildValueIndex on to make it again.\n"
+			<< valueIndexPath.string() << std::endl;
+		return false;
+	}
+	std::string_view lastAssetPath;
+	int totalAssets = 0;
+	for (std::uint32_t valueId : allValueIds) {
+		const IndexedValue value = indexReader.getValue(valueId);
+		if (value.assetPath != lastAssetPath) {
+			std::cout << value.assetPath << '\n';
+			lastAssetPath = value.assetPath;
+			totalAssets++;
+		}
+		std::cout << "	" << value.path << " : " << json(std::string(value.text)).dump(-1, ' ', false, json::error_handler_t::replace) << '\n';
+	}
+	auto duration = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime);
+	std::cout << allValueIds.size() << " values in " << totalAssets << " intermediary files matched in " << duration.count() << "ms.\n";
+	return true;
+}
+
+/**
+ * Combines the summaries written by every shard of parse and makepatches runs, each command on its own.
+ * Checks every shard of a run is there exactly once and that no two shards wrote the same file.
+ * 
+ * @param allSummaryArguments Summary files, or folders to use every shard summary in. The working folder if empty.
+ * @return If the summaries were of complete runs with no file written twice.
+ */
+bool mergeShardSummaries(std::vector<std::string> allSummaryArguments) {
+	if (allSummaryArguments.empty()) allSummaryArguments.push_back(".");
+
+	//Folders are searched for shard summaries, in name order so the report is always the same.
+	std::vector<fs::path> allSummaryPaths;
+	for (const std::string & summaryArgument : allSummaryArguments) {
+		const fs::path argumentPath = (fs::current_path() / summaryArgument).lexically_normal();
+		if (fs::is_directory(argumentPath)) {
+			std::vector<fs::path> allFolderPaths;
+			for (const auto & directory : fs::directory_iterator(argumentPath)) {
+				const std::string fileName = directory.path().filename().string();
+				if (directory.is_regular_file() && fileName.ends_with(".json") && fileName.find(".shard") != std::string::npos) allFolderPaths.push_back(directory.path());
+			}
+			std::sort(allFolderPaths.begin(), allFolderPaths.end());
+			allSummaryPaths.insert(allSummaryPaths.end(), allFolderPaths.begin(), allFolderPaths.end());
+		} else {
+			allSummaryPaths.push_back(argumentPath);
+		}
+	}
+	if (allSummaryPaths.empty()) {
+		std::cout << "No shard summaries found.\n";
+		return false;
+	}
+
+	//Summaries of parse and makepatches runs are combined separately.
+	bool valid = true;
+	std::map<std::string, std::vector<std::pair<fs::path, std::unique_ptr<ShardSummary>>>> allCommandSummaries;
+	for (const fs::path & summaryPath : allSummaryPaths) {
+		std::unique_ptr<ShardSummary> shardSummary = std::make_unique<ShardSummary>();
+		if (!shardSummary->loadSummary(summaryPath)) {
+			std::cout << "Not a shard summary:\n"
+				<< summaryPath.string() << std::endl;
+			valid = false;
+			continue;
+		}
+		const std::string command = shardSummary->getCommand();
+		allCommandSummaries[command].push_back({summaryPath, std::move(shardSummary)});
+	}
+
+	for (auto & [command, allSummaries] : allCommandSummaries) {
+		const int shardCount = allSummaries[0].second->getShardCount();
+		std::map<int, fs::path> allShardPaths;
+		std::map<std::string, std::int64_t> allTotals;
+		//Which shard wrote each file, and every file written by more than one.
+		std::map<std::pair<std::string, std::string>, int> allOutputShards;
+		std::vector<std::string> allCollisions;
+		for (auto & [summaryPath, shardSummary] : allSummaries) {
+			if (shardSummary->getShardCount() != shardCount) {
+				std::cout << "Shard summary of a " << command << " run split into " << shardSummary->getShardCount() << " shards instead of " << shardCount << ":\n"
+					<< summaryPath.string() << std::endl;
+				valid = false;
+				continue;
+			}
+			const int shardIndex = shardSummary->getShardIndex();
+			if (!allShardPaths.emplace(shardIndex, summaryPath).second) {
+				std::cout << "Shard " << shardIndex << " of " << command << " is summarised twice:\n"
+					<< allShardPaths[shardIndex].string() << '\n'
+					<< summaryPath.string() << std::endl;
+				valid = false;
+				continue;
+			}
+
+			for (const auto & [name, value] : shardSummary->getAllCounters()) allTotals[name] += value;
+			for (const auto & [outputFolder, allAssetPaths] : shardSummary->getAllOutputs()) {
+				for (const std::string & assetPath : allAssetPaths) {
+					auto [outputShard, added] = allOutputShards.emplace(std::make_pair(outputFolder, assetPath), shardIndex);
+					if (!added) allCollisions.push_back(outputFolder + assetPath + " by shards " + std::to_string(outputShard->second) + " and " + std::to_string(shardIndex));
+				}
+			}
+		}
+
+		for (int shardIndex = 1; shardIndex <= shardCount; shardIndex++) {
+			if (!allShardPaths.contains(shardIndex)) {
+				std::cout << "Shard " << shardIndex << " of " << shardCount << " of " << command << " has no summary.\n";
+				valid = false;
+			}
+		}
+		if (!allCollisions.empty()) {
+			std::cout << allCollisions.size() << " files were written by more than one shard of " << command << ":\n";
+			const std::size_t listedCount = std::min<std::size_t>(allCollisions.size(), 20);
+			for (std::size_t i = 0; i < listedCount; i++) std::cout << allCollisions[i] << '\n';
+			if (allCollisions.size() > listedCount) std::cout << "And " << allCollisions.size() - listedCount << " more.\n";
+			valid = false;
+		}
+
+		std::cout << allShardPaths.size() << " of " << shardCount << " " << command << " shards summarised, " << allOutputShards.size() << " files written:\n";
+		for (const auto & [name, total] : allTotals) std::cout << "	" << name << " : " << total << '\n';
+	}
+	return valid && !allCommandSummaries.empty();
+}
+
+/**
+ * @param outputPath An output folder.
+ * @return The folder relative to the working folder, as named in shard summaries.
+ */
+std::string getOutputFolderName(const fs::path & outputPath) {
+	const fs::path relativePath = outputPath.lexically_relative(fs::current_path());
+	return relativePath.empty() ? outputPath.generic_string() : relativePath.generic_string();
+}
+
+void rebaseIntermediaries(MasterSettings & masterSettings, SourceLayers & oldSourceLayers, SourceLayers & newSourceLayers, const fs::path intermediaryAssetPath, const fs::path rebasedAssetPath, std::vector<FileSettings> allFileSettings) {
+	//Intermediary files are read from and written to either folders or single bundles.
+	const bool bundleIntermediaryFiles = masterSettings.getBundleIntermediaryFiles();
+	const fs::path intermediaryBundlePath = getIntermediaryBundlePath(intermediaryAssetPath);
+	const fs::path rebasedOutputPath = bundleIntermediaryFiles ? getIntermediaryBundlePath(rebasedAssetPath) : rebasedAssetPath;
+	const fs::path conflictReportPath = getRebaseConflictsPath(rebasedAssetPath);
+
+	//Stop if the edited intermediary asset folder or bundle does not exist.
+	if (warnIfNothingAtPath(bundleIntermediaryFiles ? intermediaryBundlePath : intermediaryAssetPath, bundleIntermediaryFiles ? "intermediary bundle" : "intermediary asset")) return;
+	IntermediaryBundleReader bundleReader;
+	if (bundleIntermediaryFiles && !bundleReader.open(intermediaryBundlePath)) {
+		std::cout << "The intermediary bundle could not be read.\n"
+			<< intermediaryBundlePath.string()
+			<< "\nAborting.\n";
+		return;
+	}
+
+	//Edited values are resolved from the old table and rebased values are interned into a new one.
+	const bool internIntermediaryValues = masterSettings.getInternIntermediaryValues();
+	ValueInternTable editedInternTable;
+	if (internIntermediaryValues && !editedInternTable.loadTable(getInternedValuesPath(intermediaryAssetPath))) {
+		std::cout << "The interned value table could not be read.\n"
+			<< getInternedValuesPath(intermediaryAssetPath).string()
+			<< "\nAborting.\n";
+		return;
+	}
+	ValueInternTable rebasedInternTable;
+
+	//Stop if the rebased output exists unless in overwrite mode.
+	if (fs::exists(rebasedOutputPath)) {
 		if (masterSettings.getOverwriteFiles()) {
-			std::cout << "Deleting old patch output folder.\n";
-			fs::remove_all(patchOutputPath);
-			std::cout << "Old patch output folder deleted.\n";
+			std::cout << "Deleting old rebased intermediary assets.\n";
+			fs::remove_all(rebasedOutputPath);
+			std::cout << "Old rebased intermediary assets deleted.\n";
 		} else {
-			std::cout << "Patch output folder already exists at:"
-				<< patchOutputPath.string()
+			std::cout << "Rebased intermediary assets already exist at:"
+				<< rebasedOutputPath.string()
 				<< "\nNo files will be written.\n"
-				<< "Delete the folder or run again in overwrite mode.\n";
+				<< "Delete them or run again in overwrite mode.\n";
 			return;
 		}
 	}
+	if (fs::exists(conflictReportPath)) fs::remove(conflictReportPath);
 
-	std::cout << "Making patches.\n";
+	IntermediaryBundleWriter bundleWriter;
+	if (bundleIntermediaryFiles && !bundleWriter.open(rebasedOutputPath)) {
+		std::cout << "Failed to create intermediary bundle at:\n"
+			<< rebasedOutputPath.string() << std::endl;
+		return;
+	}
+
+	//Loads the edited intermediary text of an asset.
+	auto fetchEditedText = [&](const std::string & assetPath, std::string & editedText) {
+		if (bundleIntermediaryFiles) {
+			if (!bundleReader.contains(assetPath)) return false;
+			editedText = std::string(bundleReader.fetchText(assetPath));
+			return true;
+		}
+		fs::path editedPath = intermediaryAssetPath;
+		editedPath += fs::path(assetPath).make_preferred();
+		return tryFetchText(editedPath, editedText);
+	};
+	//Writes a rebased intermediary file, or appends it to the bundle.
+	auto writeRebasedFile = [&](const std::string & assetPath, std::string rebasedText) {
+		if (bundleIntermediaryFiles) {
+			bundleWriter.append(assetPath, rebasedText);
+			return;
+		}
+		fs::path rebasedPath = rebasedAssetPath;
+		rebasedPath += fs::path(assetPath).make_preferred();
+		std::stringstream rebasedStream(std::move(rebasedText));
+		if (!writeStringStreamToPath(rebasedStream, rebasedPath)) {
+			std::lock_guard<std::mutex> lock(consoleMutex);
+			std::cout << "Failed to write intermediary file to:\n"
+				<< rebasedPath.string() << std::endl;
+		}
+	};
+	//Rebased intermediary files with interned values, held until every value is interned.
+	std::mutex pendingRebasedMutex;
+	std::vector<std::pair<std::string, std::string>> allPendingRebasedTexts;
+	//Writes a rebased intermediary file.
+	auto writeRebasedText = [&](const std::string & assetPath, std::string rebasedText) {
+		if (internIntermediaryValues) {
+			std::lock_guard<std::mutex> lock(pendingRebasedMutex);
+			allPendingRebasedTexts.emplace_back(assetPath, std::move(rebasedText));
+			return;
+		}
+		writeRebasedFile(assetPath, std::move(rebasedText));
+	};
+
+	std::cout << "Rebasing intermediary files.\n";
 
 	auto startTime = std::chrono::high_resolution_clock::now();
-	int totalPatchesMade = 0;
-	int totalValuesAltered = 0;
-	JsonPatchWriter patchWriter = JsonPatchWriter(masterSettings);
+	std::atomic<int> totalIntermediaryFilesMade = 0;
+	std::atomic<int> totalFilesUnchanged = 0;
+	AssetIndex oldAssetIndex = AssetIndex(&oldSourceLayers, AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()));
+	AssetIndex newAssetIndex = AssetIndex(&newSourceLayers, AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()));
+	IntermediaryRebaser rebaser = IntermediaryRebaser(internIntermediaryValues ? &rebasedInternTable : nullptr, &oldAssetIndex, &newAssetIndex);
+	std::mutex rebasedMutex;
+	std::unordered_set<std::string> allRebasedAssetPaths;
+	AssetScheduler scheduler = AssetScheduler(masterSettings.getWorkerThreads(), masterSettings.getMaxMemoryBytes());
+	const bool useMemoryBudget = masterSettings.getMaxMemoryBytes() > 0;
+	AssetPathFilter pathFilter = AssetPathFilter(masterSettings.getIncludePaths(), masterSettings.getExcludePaths());
+	//Rebase every new source asset.
+	newSourceLayers.forEachAsset(AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()), getAllFileExtensions(allFileSettings), &pathFilter, [&](const std::string & assetPath) {
+		const std::string extension = fs::path(assetPath).extension().string();
+		for (FileSettings & fileSettings : allFileSettings) {
+			if (extension == fileSettings.getFileExtension()) {
+				//Both sources and the edited intermediary are held at once.
+				const std::uint64_t estimatedBytes = useMemoryBudget ? AssetScheduler::estimateFootprint(assetPath, newSourceLayers.getAssetSize(assetPath)) * 3 : 0;
+				scheduler.submit(estimatedBytes, [&, assetPath]() {
+					{
+						std::lock_guard<std::mutex> lock(rebasedMutex);
+						allRebasedAssetPaths.insert(assetPath);
+					}
+					const bool valuesHaveNewlines = fileSettings.getValuesContainNewlines();
+					std::string newSourceText;
+					std::uint64_t newSourceHash = 0;
+					if (!newSourceLayers.fetchSourceContent(assetPath, newSourceText, newSourceHash)) return;
+					std::string editedText;
+					const bool edited = fetchEditedText(assetPath, editedText);
+					std::string oldSourceText;
+					std::uint64_t oldSourceHash = 0;
+					const bool oldSourceFound = oldSourceLayers.fetchSourceContent(assetPath, oldSourceText, oldSourceHash);
 
-	//Iteratively generate patches.
-	for (const auto & directory : fs::recursive_directory_iterator(intermediaryAssetPath)) {
-		//Folders should be ignored.
-		if (directory.path().has_extension()) {
-			//Get the file extension.
-			const std::string extension = directory.path().extension().string();
-			//Check if the extension should be read.
-			for (FileSettings & fileSettings : allFileSettings) {
-				if (extension == fileSettings.getFileExtension()) {
-					const json intermediaryJson = fetchJson(directory, fileSettings.getValuesContainNewlines());
-
-					//Get the source file path.
-					fs::path sourceJsonPath = sourceAssetPath;
-					std::string pathFragment = directory.path().string();
-					pathFragment.erase(0, intermediaryAssetPath.string().length());
-					sourceJsonPath += pathFragment;
-
-					//If the source version does not exists there is nothing to do. It should if the user did not delete it.
-					if (fs::exists(sourceJsonPath)) {
-						//Source JSON.
-						const json sourceJson = fetchJson(sourceJsonPath, fileSettings.getValuesContainNewlines());
-
-						std::stringstream patchText;
-						int currentOps = 0;
-
-						//Write the patch JSON text.
-						currentOps = patchWriter.writePatchFile(patchText, fileSettings, sourceJson, intermediaryJson);
-						totalValuesAltered += currentOps;
-
-						//If there were any ops save the file.
-						if (currentOps > 0) {
-							//Get the patch file path.
-							fs::path patchFilePath = patchOutputPath;
-							patchFilePath += pathFragment;
-							patchFilePath += ".patch";
-
-							//Creating the patch file.
-							if(!writeStringStreamToPath(patchText, patchFilePath)) {
-								std::cout << "Failed to write patch file to:\n"
-									<< patchFilePath.string() << std::endl;
-							}
+					//Unchanged source assets keep their edited intermediary file as it is, unless it has values from other assets.
+					if (edited && oldSourceFound && oldSourceHash == newSourceHash && !internIntermediaryValues && !fileSettings.hasResolvedPointers()) {
+						writeRebasedText(assetPath, std::move(editedText));
+						totalFilesUnchanged++;
+						totalIntermediaryFilesMade++;
+						return;
+					}
 
-							totalPatchesMade++;
-						}
+					const std::shared_ptr<const json> newSourceJson = newSourceLayers.fetchSourceJson(assetPath, valuesHaveNewlines, std::move(newSourceText));
+					std::stringstream rebasedText;
+					int currentValuesToKeep = 0;
+					if (edited) {
+						json editedJson = parseJsonText(std::move(editedText), valuesHaveNewlines);
+						if (internIntermediaryValues) editedInternTable.resolveReferences(editedJson);
+						const std::shared_ptr<const json> oldSourceJson = oldSourceFound ? oldSourceLayers.fetchSourceJson(assetPath, valuesHaveNewlines, std::move(oldSourceText)) : std::make_shared<const json>(json::object());
+						currentValuesToKeep = rebaser.rebaseIntermediaryFile(rebasedText, fileSettings, assetPath, *oldSourceJson, *newSourceJson, editedJson);
 					} else {
-						std::cout << "Source asset \"" << pathFragment << "\" not found, skipping patch.\n";
+						//Nothing to merge, parse as usual.
+						JsonIntermediaryWriter intermediaryWriter = JsonIntermediaryWriter(internIntermediaryValues ? &rebasedInternTable : nullptr, &newAssetIndex, assetPath);
+						currentValuesToKeep = intermediaryWriter.writeIntermediaryFile(rebasedText, fileSettings, *newSourceJson);
 					}
-				}
+
+					//If there were any values to keep save the file.
+					if (currentValuesToKeep > 0) {
+						writeRebasedText(assetPath, rebasedText.str());
+						totalIntermediaryFilesMade++;
+					}
+				});
+				//There can only be one match.
+				break;
+			}
+		}
+	});
+	//Wait for every asset to be rebased.
+	scheduler.finish();
+
+	//Report edited intermediary files whose source asset is gone.
+	auto reportIfRemoved = [&](const std::string & assetPath) {
+		if (allRebasedAssetPaths.contains(assetPath)) return;
+		const std::string extension = fs::path(assetPath).extension().string();
+		for (FileSettings & fileSettings : allFileSettings) {
+			if (extension == fileSettings.getFileExtension()) {
+				std::string editedText;
+				if (!fetchEditedText(assetPath, editedText)) return;
+				json editedJson = parseJsonText(std::move(editedText), fileSettings.getValuesContainNewlines());
+				if (internIntermediaryValues) editedInternTable.resolveReferences(editedJson);
+				rebaser.addRemovedAsset(assetPath, editedJson);
+				return;
 			}
 		}
+	};
+	if (bundleIntermediaryFiles) {
+		for (const BundleEntry & entry : bundleReader.getAllEntries()) {
+			if (pathFilter.matchesFile(entry.assetPath)) reportIfRemoved(entry.assetPath);
+		}
+	} else {
+		DirectoryWalker editedWalker = DirectoryWalker(AssetScheduler::resolveWorkerCount(masterSettings.getWorkerThreads()), getAllFileExtensions(allFileSettings), &pathFilter);
+		std::mutex removedMutex;
+		editedWalker.walk(intermediaryAssetPath, [&](const fs::path & editedPath) {
+			std::lock_guard<std::mutex> lock(removedMutex);
+			reportIfRemoved(toAssetPath(editedPath, intermediaryAssetPath));
+		});
+	}
+
+	//Ids are given out in the order threads reach values, so they are sorted before any rebased file is written.
+	if (internIntermediaryValues) {
+		rebasedInternTable.sortValues();
+		std::sort(allPendingRebasedTexts.begin(), allPendingRebasedTexts.end());
+		for (auto & [assetPath, rebasedText] : allPendingRebasedTexts) {
+			writeRebasedFile(assetPath, rebasedInternTable.renumberReferences(rebasedText));
+			rebasedText = std::string();
+		}
+		allPendingRebasedTexts.clear();
+	}
+
+	//Write the bundle index.
+	if (bundleIntermediaryFiles && !bundleWriter.close()) {
+		std::cout << "Failed to finish writing intermediary bundle at:\n"
+			<< rebasedOutputPath.string() << std::endl;
+	}
+
+	//Write the interned value table.
+	if (internIntermediaryValues) {
+		std::stringstream tableText;
+		rebasedInternTable.writeTable(tableText);
+		if (!writeStringStreamToPath(tableText, getInternedValuesPath(rebasedAssetPath))) {
+			std::cout << "Failed to write interned value table to:\n"
+				<< getInternedValuesPath(rebasedAssetPath).string() << std::endl;
+		}
+	}
+
+	//Write the conflict report.
+	if (rebaser.getConflictCount() > 0) {
+		std::stringstream reportText;
+		rebaser.writeConflictReport(reportText);
+		if (!writeStringStreamToPath(reportText, conflictReportPath)) {
+			std::cout << "Failed to write rebase conflicts to:\n"
+				<< conflictReportPath.string() << std::endl;
+		}
 	}
 
 	auto duration = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::high_resolution_clock::now() - startTime);
-	//Finished patch output notification
-	std::cout << totalPatchesMade << " patches containing " << totalValuesAltered << " operation sets created in " << duration.count() << "s at:\n"
-		<< patchOutputPath.string() << std::endl;
+	//Finished rebase notification
+	std::cout << totalIntermediaryFilesMade << " intermediary files rebased in " << duration.count() << "s at:\n"
+		<< rebasedOutputPath.string() << '\n'
+		<< totalFilesUnchanged << " files had unchanged source assets, " << rebaser.getEditsKept() << " edits were kept and "
+		<< rebaser.getValuesUpdated() << " unedited values were updated.\n";
+	if (rebaser.getConflictCount() > 0) {
+		std::cout << rebaser.getConflictCount() << " conflicts need review at:\n"
+			<< conflictReportPath.string() << std::endl;
+	}
+}
+
+/**
+ * Finds the parse target settings for an extension, at most one per target.
+ */
+std::vector<FileSettings *> getExtensionTargetSettings(std::vector<FileSettings> & allFileSettings, const std::string & extension) {
+	std::vector<FileSettings *> allTargetSettings;
+	for (FileSettings & fileSettings : allFileSettings) {
+		if (extension == fileSettings.getFileExtension()) {
+			//There can only be one match per target.
+			bool targetMatched = false;
+			for (FileSettings * targetSettings : allTargetSettings) targetMatched = targetMatched || targetSettings->getTargetName() == fileSettings.getTargetName();
+			if (!targetMatched) allTargetSettings.push_back(&fileSettings);
+		}
+	}
+	return allTargetSettings;
+}
+
+/**
+ * Loads the source asset an intermediary file was made from, reporting if it is missing.
+ */
+bool fetchPatchSource(SourceLayers & sourceLayers, const std::string & assetPath, SourceAsset & sourceAsset) {
+	//If the source version does not exists there is nothing to do. It should if the user did not delete it.
+	if (!sourceLayers.fetchSourceAsset(assetPath, sourceAsset)) {
+		std::lock_guard<std::mutex> lock(consoleMutex);
+		std::cout << "Source asset \"" << fs::path(assetPath).make_preferred().string() << "\" not found, skipping patch.\n";
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Makes the patch for a single asset and writes it to the patch output folder.
+ * 
+ * @param patchWriter The patch writer to use.
+ * @param fileSettings The file extension specific settings to use when making the patch.
+ * @param sourceLayers The source layers the asset is loaded from.
+ * @param sourceAsset The loaded source asset, shared by every patch made from it.
+ * @param internTable The table interned values are resolved from, null if values are not interned.
+ * @param valueTransformer Rewrites intermediary values before the patch is made, null to use them as they are.
+ * @param patchMemo Patches already made for identical source and intermediary assets, null to always make the patch.
+ * @param outputSynchroniser Skips writing patches that are unchanged, null to always write.
+ * @param patchOutputPath The patch output folder.
+ * @param intermediaryText The intermediary text of the asset.
+ * @param totalValuesAltered Incremented by how many operation sets the patch contains.
+ * @return If a patch file was written.
+ */
+bool makePatch(JsonPatchWriter & patchWriter, FileSettings & fileSettings, SourceLayers & sourceLayers, SourceAsset & sourceAsset, ValueInternTable * internTable, ValueTransformer * valueTransformer, ContentHashMemo * patchMemo, OutputSynchroniser * outputSynchroniser, const fs::path patchOutputPath, std::string intermediaryText, std::atomic<int> & totalValuesAltered) {
+	auto makePatchText = [&]() {
+		json intermediaryJson = parseJsonText(std::move(intermediaryText), fileSettings.getValuesContainNewlines());
+		if (internTable != nullptr) internTable->resolveReferences(intermediaryJson);
+		if (valueTransformer != nullptr) valueTransformer->transformIntermediary(intermediaryJson, fileSettings.getFileExtension());
+		//Source JSON with every layer's patches applied.
+		const std::shared_ptr<const json> sourceJson = sourceLayers.fetchSourceJson(sourceAsset, fileSettings.getValuesContainNewlines());
+
+		//Write the patch JSON text.
+		std::stringstream patchText;
+		MemoResult result;
+		result.count = patchWriter.writePatchFile(patchText, fileSettings, *sourceJson, intermediaryJson);
+		result.text = patchText.str();
+		return result;
+	};
+	//Patch trees with their own interned value tables resolve the same intermediary text to different values.
+	const std::string tableKey = internTable != nullptr ? ':' + std::to_string(internTable->getTableHash()) : "";
+	const std::uint64_t contentLength = sourceAsset.text.size() + intermediaryText.size();
+	const MemoResult patch = patchMemo != nullptr
+		? patchMemo->fetchOrMake(std::to_string(sourceAsset.contentHash) + ':' + std::to_string(hashContent(intermediaryText)) + tableKey + fileSettings.getFileExtension() + fileSettings.getTargetName(), contentLength, makePatchText)
+		: makePatchText();
+	int currentOps = patch.count;
+	totalValuesAltered += currentOps;
+
+	//If there were no ops there is no file to save.
+	if (currentOps <= 0) return false;
+
+	//Get the patch file path.
+	fs::path patchFilePath = patchOutputPath;
+	patchFilePath += fs::path(sourceAsset.assetPath).make_preferred();
+	patchFilePath += ".patch";
+
+	//Creating the patch file.
+	bool written = false;
+	if (outputSynchroniser != nullptr) {
+		written = outputSynchroniser->writeFile(patchFilePath, patch.text);
+	} else {
+		std::stringstream patchText(patch.text);
+		written = writeStringStreamToPath(patchText, patchFilePath);
+	}
+	if (!written) {
+		std::lock_guard<std::mutex> lock(consoleMutex);
+		std::cout << "Failed to write patch file to:\n"
+			<< patchFilePath.string() << std::endl;
+	}
+
+	return true;
 }
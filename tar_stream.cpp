@@ -0,0 +1,198 @@
+#include "tar_stream.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+	constexpr std::size_t blockSize = 512;
+
+	/**
+	 * Reads a numeric header field, either octal text or GNU base 256 for large values.
+	 */
+	std::uint64_t readNumber(const char * field, std::size_t length) {
+		std::uint64_t value = 0;
+		if (static_cast<unsigned char>(field[0]) & 0x80) {
+			for (std::size_t i = 1; i < length; i++) value = (value << 8) | static_cast<unsigned char>(field[i]);
+			return value;
+		}
+		for (std::size_t i = 0; i < length; i++) {
+			if (field[i] >= '0' && field[i] <= '7') {
+				value = (value << 3) | static_cast<std::uint64_t>(field[i] - '0');
+			} else if (field[i] != ' ' || value != 0) {
+				break;
+			}
+		}
+		return value;
+	}
+
+	/**
+	 * Reads a header text field that is only NUL terminated if shorter than the field.
+	 */
+	std::string readText(const char * field, std::size_t length) {
+		return std::string(field, std::find(field, field + length, '\0'));
+	}
+
+	void writeOctal(char * field, std::size_t length, std::uint64_t value) {
+		std::snprintf(field, length, "%0*llo", static_cast<int>(length - 1), static_cast<unsigned long long>(value));
+	}
+}
+
+TarReader::TarReader(std::istream & input) : input(input) { }
+
+bool TarReader::readBlock(char * block) {
+	input.read(block, blockSize);
+	return static_cast<std::size_t>(input.gcount()) == blockSize;
+}
+
+/**
+ * Reads an entry's data and skips the padding after it.
+ */
+bool TarReader::readData(std::uint64_t size, std::string & data) {
+	data.resize(size);
+	input.read(data.data(), static_cast<std::streamsize>(size));
+	if (static_cast<std::uint64_t>(input.gcount()) != size) return false;
+	const std::uint64_t padding = (blockSize - size % blockSize) % blockSize;
+	input.ignore(static_cast<std::streamsize>(padding));
+	return static_cast<std::uint64_t>(input.gcount()) == padding;
+}
+
+/**
+ * Reads the next regular file in the archive. Folders and links are skipped, long names from GNU and pax headers are applied.
+ *
+ * @param entry Receives the path and contents of the file.
+ * @return If a file was read, false at the end of the archive.
+ */
+bool TarReader::next(TarEntry & entry) {
+	char header[blockSize];
+	std::string longPath;
+	while (!finished) {
+		//The archive ends with zero blocks, or when the input does.
+		if (!readBlock(header) || std::all_of(header, header + blockSize, [](char byte) { return byte == '\0'; })) break;
+
+		const char type = header[156];
+		if (!readData(readNumber(header + 124, 12), entry.data)) break;
+
+		if (type == 'L') {
+			//GNU long name for the next entry.
+			longPath = readText(entry.data.data(), entry.data.size());
+		} else if (type == 'x') {
+			//Pax records are "length key=value\n".
+			std::size_t position = 0;
+			while (position < entry.data.size()) {
+				const std::size_t space = entry.data.find(' ', position);
+				const std::size_t length = std::strtoull(entry.data.c_str() + position, nullptr, 10);
+				if (space == std::string::npos || length == 0 || position + length > entry.data.size()) break;
+				const std::string record = entry.data.substr(space + 1, position + length - space - 2);
+				if (record.starts_with("path=")) longPath = record.substr(5);
+				position += length;
+			}
+		} else if (type == '0' || type == '\0' || type == '7') {
+			if (longPath.empty()) {
+				entry.path = readText(header, 100);
+				const std::string prefix = readText(header + 345, 155);
+				if (std::memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty()) entry.path = prefix + '/' + entry.path;
+			} else {
+				entry.path = longPath;
+			}
+			if (entry.path.starts_with("./")) entry.path.erase(0, 2);
+			return true;
+		} else {
+			longPath.clear();
+		}
+	}
+	finished = true;
+	return false;
+}
+
+//Getters
+const bool TarReader::isFinished() { return finished; }
+
+TarWriter::TarWriter(std::ostream & output) : output(output) { }
+
+/**
+ * Writes a ustar header, preceded by a pax header if the path does not fit.
+ */
+void TarWriter::writeHeader(const std::string & path, std::uint64_t size, char type) {
+	char header[blockSize] = {};
+	//Long paths are split at a folder into the prefix field.
+	std::size_t split = 0;
+	if (path.size() > 100) {
+		const std::size_t slash = path.find('/', path.size() - 101);
+		if (slash != std::string::npos && slash <= 155 && slash + 1 < path.size()) {
+			split = slash + 1;
+		} else {
+			const std::string body = " path=" + path + "\n";
+			std::size_t length = body.size() + 1;
+			while (std::to_string(length).size() + body.size() != length) length++;
+			const std::string record = std::to_string(length) + body;
+			writeHeader("PaxHeader", record.size(), 'x');
+			writeData(record);
+		}
+	}
+	const std::string name = path.substr(split, 100);
+	std::memcpy(header, name.data(), name.size());
+	if (split > 0) std::memcpy(header + 345, path.data(), split - 1);
+	writeOctal(header + 100, 8, 0644);
+	writeOctal(header + 108, 8, 0);
+	writeOctal(header + 116, 8, 0);
+	writeOctal(header + 124, 12, size);
+	writeOctal(header + 136, 12, 0);
+	header[156] = type;
+	std::memcpy(header + 257, "ustar", 6);
+	std::memcpy(header + 263, "00", 2);
+
+	//The checksum is taken with its own field as spaces.
+	std::memset(header + 148, ' ', 8);
+	unsigned int checksum = 0;
+	for (char byte : header) checksum += static_cast<unsigned char>(byte);
+	writeOctal(header + 148, 7, checksum);
+	output.write(header, blockSize);
+}
+
+void TarWriter::writeData(std::string_view data) {
+	static const char padding[blockSize] = {};
+	output.write(data.data(), static_cast<std::streamsize>(data.size()));
+	output.write(padding, static_cast<std::streamsize>((blockSize - data.size() % blockSize) % blockSize));
+}
+
+/**
+ * Appends a file to the archive.
+ *
+ * @param path The path of the file inside the archive, using forward slashes.
+ * @param data The contents of the file.
+ */
+void TarWriter::append(const std::string & path, std::string_view data) {
+	std::lock_guard<std::mutex> lock(outputMutex);
+	writeHeader(path, data.size(), '0');
+	writeData(data);
+	totalEntries++;
+}
+
+/**
+ * Ends the archive with two zero blocks.
+ *
+ * @return If everything was written.
+ */
+bool TarWriter::finish() {
+	static const char endBlocks[blockSize * 2] = {};
+	std::lock_guard<std::mutex> lock(outputMutex);
+	output.write(endBlocks, sizeof(endBlocks));
+	output.flush();
+	return output.good();
+}
+
+//Getters
+const int TarWriter::getEntryCount() { return totalEntries; }
+
+/**
+ * Finds the asset path of an archive entry inside a root folder.
+ *
+ * @param entryPath The path of the entry, such as source_assets/objects/crate.object.
+ * @param rootName The root folder, such as source_assets.
+ * @return The asset path with a leading slash, or empty if the entry is not in the root folder.
+ */
+std::string stripTarRoot(const std::string & entryPath, const std::string & rootName) {
+	if (entryPath.size() <= rootName.size() + 1 || !entryPath.starts_with(rootName) || entryPath[rootName.size()] != '/') return "";
+	return entryPath.substr(rootName.size());
+}
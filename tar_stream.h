@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+struct TarEntry {
+	std::string path;
+	std::string data;
+};
+
+//Reads regular files from a tar archive as they arrive, without seeking.
+class TarReader {
+private:
+	std::istream & input;
+	bool finished = false;
+
+	bool readBlock(char * block);
+	bool readData(std::uint64_t size, std::string & data);
+public:
+	TarReader(std::istream & input);
+	bool next(TarEntry & entry);
+	//Getters
+	const bool isFinished();
+};
+
+//Writes files to a ustar archive, safe to append to from several threads.
+class TarWriter {
+private:
+	std::ostream & output;
+	std::mutex outputMutex;
+	int totalEntries = 0;
+
+	void writeHeader(const std::string & path, std::uint64_t size, char type);
+	void writeData(std::string_view data);
+public:
+	TarWriter(std::ostream & output);
+	void append(const std::string & path, std::string_view data);
+	bool finish();
+	//Getters
+	const int getEntryCount();
+};
+
+std::string stripTarRoot(const std::string & entryPath, const std::string & rootName);
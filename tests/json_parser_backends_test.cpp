@@ -0,0 +1,106 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "json_parser.h"
+
+using json = nlohmann::json;
+
+/**
+ * Checks two parsed documents are the same down to the type of every number, which == alone does not.
+ */
+static bool isSameJson(const json & expected, const json & actual) {
+	if (expected.type() != actual.type()) return false;
+	if (expected.is_object()) {
+		if (expected.size() != actual.size()) return false;
+		for (auto expectedIterator = expected.begin(), actualIterator = actual.begin(); expectedIterator != expected.end(); expectedIterator++, actualIterator++) {
+			if (expectedIterator.key() != actualIterator.key() || !isSameJson(expectedIterator.value(), actualIterator.value())) return false;
+		}
+		return true;
+	}
+	if (expected.is_array()) {
+		if (expected.size() != actual.size()) return false;
+		for (std::size_t i = 0; i < expected.size(); i++) {
+			if (!isSameJson(expected[i], actual[i])) return false;
+		}
+		return true;
+	}
+	return expected == actual && expected.dump() == actual.dump();
+}
+
+/**
+ * Parses the text with the backend, giving the JSON dumped or the error message.
+ */
+static std::string parseWith(const std::string & backendName, const std::string & text, json & parsedJson) {
+	JsonParser::selectBackend(backendName);
+	try {
+		parsedJson = JsonParser::parse(text);
+		return parsedJson.dump();
+	} catch (const json::exception & exception) {
+		parsedJson = json();
+		return std::string("error: ") + exception.what();
+	}
+}
+
+/**
+ * Builds a document large enough to be parsed in parts, with duplicate keys in different parts.
+ */
+static std::string makeLargeDocument() {
+	std::string text = "{\"first\": -1, \"numbers\": [";
+	for (int i = 0; i < 20000; i++) {
+		if (i > 0) text += ", ";
+		text += std::to_string(i % 7 == 0 ? -i : i) + ", " + std::to_string(i) + ".5, 18446744073709551615, -9223372036854775808, -0.0";
+	}
+	text += "], \"items\": {";
+	for (int i = 0; i < 20000; i++) {
+		if (i > 0) text += ", ";
+		text += "\"item" + std::to_string(i % 15000) + "\": {\"name\": \"Item \\u00e9 " + std::to_string(i) + "\", \"count\": " + std::to_string(i) + "}";
+	}
+	text += "}, \"first\": 1}";
+	return text;
+}
+
+int main() {
+	if (!JsonParser::selectBackend("simdjson")) {
+		std::cout << "Built without the simdjson backend." << std::endl;
+		return 1;
+	}
+
+	const std::vector<std::string> allDocuments = {
+		"-0",
+		"[-0, 0, -0.0, 0.0, -0e0, -0E+0, -01]",
+		"{\"a\": -0, \"b\": \"-0\"}",
+		"[9223372036854775807, 9223372036854775808, 18446744073709551615, 18446744073709551616]",
+		"[-9223372036854775808, -9223372036854775809, 123456789012345678901234567890, -123456789012345678901234567890]",
+		"[1e400]",
+		"[0.1, 1e5, 1E-5, 2.50, 1.5e-320, 1.7976931348623157e308]",
+		"{\"a\": 1, \"a\": 2}",
+		"{\"b\": 1, \"a\": [1, 2], \"b\": {\"c\": 3, \"c\": [4]}, \"a\": null}",
+		"[\"\\u00e9\\ud83d\\ude00\", \"tab\\tquote\\\"slash\\/\", \"\"]",
+		"[true, false, null, {}, []]",
+		"{\"unclosed\": [1, 2}",
+		"[1, 2,]",
+		""
+	};
+
+	int failedCount = 0;
+	auto compareBackends = [&](const std::string & name, const std::string & text) {
+		json expectedJson;
+		json actualJson;
+		const std::string expected = parseWith("nlohmann", text, expectedJson);
+		const std::string actual = parseWith("simdjson", text, actualJson);
+		if (expected != actual || !isSameJson(expectedJson, actualJson)) {
+			std::cout << "Backends differ for " << name << ":\n  nlohmann: " << expected.substr(0, 200) << "\n  simdjson: " << actual.substr(0, 200) << std::endl;
+			failedCount++;
+		}
+	};
+
+	for (const std::string & text : allDocuments) compareBackends(text, text);
+	const std::string largeDocument = makeLargeDocument();
+	compareBackends("the large document", largeDocument);
+	JsonParser::setParallelParse(64 * 1024, 4);
+	compareBackends("the large document parsed in parts", largeDocument);
+
+	if (failedCount > 0) return 1;
+	std::cout << "Both backends gave the same JSON for " << allDocuments.size() + 2 << " documents." << std::endl;
+	return 0;
+}
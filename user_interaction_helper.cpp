@@ -5,6 +5,8 @@
 
 namespace fs = std::filesystem;
 
+std::mutex consoleMutex;
+
 /**
  * Clears the input stream.
  */
@@ -1,6 +1,10 @@
 #pragma once
 
 #include <filesystem>
+#include <mutex>
+
+//Held while printing from worker threads so messages do not interleave.
+extern std::mutex consoleMutex;
 
 void clearInput();
 
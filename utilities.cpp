@@ -1,6 +1,10 @@
 #include "utilities.h"
 
+#include <cctype>
+#include <charconv>
 #include <fstream>
+#include "json_parser.h"
+#include "perf_counters.h"
 
 using json = nlohmann::json;
 
@@ -155,6 +159,7 @@ int replaceFirstOfX(std::string & text, const char x, const std::string replacem
  * @return The file converted into an std::string object.
  */
 const std::string fetchText(fs::path filePath) {
+	CounterScope counterScope = CounterScope(readCounterStage);
 	std::ifstream textFile;
 	std::stringstream textStream;
 
@@ -166,6 +171,23 @@ const std::string fetchText(fs::path filePath) {
 	return textStream.str();
 }
 
+/**
+ * Loads a text file from the path if it can be opened. Avoids checking if the file exists first.
+ * 
+ * @param filePath The path to load the file from.
+ * @param text Set to the contents of the file.
+ * @return If the file could be opened.
+ */
+bool tryFetchText(fs::path filePath, std::string & text) {
+	CounterScope counterScope = CounterScope(readCounterStage);
+	std::ifstream textFile(filePath, std::ios::binary);
+	if (!textFile.is_open()) return false;
+	std::stringstream textStream;
+	textStream << textFile.rdbuf();
+	text = textStream.str();
+	return true;
+}
+
 /**
  * Loads a JSON file from the path and returns a nlohmann::json object.
  * 
@@ -174,13 +196,27 @@ const std::string fetchText(fs::path filePath) {
  * @return The JSON file converted into a nlohmann::json object.
  */
 const json fetchJson(fs::path filePath, bool valuesHaveNewlines) {
-	std::string jsonString = fetchText(filePath);
-	stripJsonComments(jsonString);
-	if (valuesHaveNewlines) {
-		convertJsonValueNewlinesToBreakout(jsonString);
+	return parseJsonText(fetchText(filePath), valuesHaveNewlines);
+}
+
+/**
+ * Converts JSON text that may contain comments into a nlohmann::json object.
+ * 
+ * @param jsonString The JSON text to convert.
+ * @param valuesHaveNewlines If values have actual newlines in them.
+ * @return The JSON text converted into a nlohmann::json object.
+ */
+const json parseJsonText(std::string jsonString, bool valuesHaveNewlines) {
+	{
+		CounterScope counterScope = CounterScope(stripCommentsCounterStage);
+		stripJsonComments(jsonString);
+		if (valuesHaveNewlines) {
+			convertJsonValueNewlinesToBreakout(jsonString);
+		}
 	}
 	//TODO: Handle conversion failures more gracefully.
-	return json::parse(jsonString);
+	CounterScope counterScope = CounterScope(parseJsonCounterStage);
+	return JsonParser::parse(jsonString);
 }
 
 /**
@@ -201,7 +237,11 @@ const json fetchJson(fs::path filePath) {
  * @return If the file was written.
  */
 const bool writeStringStreamToPath(std::stringstream & stream, std::filesystem::path filePath) {
-	if (fs::exists(filePath.parent_path()) || fs::create_directories(filePath.parent_path())) {
+	CounterScope counterScope = CounterScope(writeCounterStage);
+	//Another thread may create the same folder at the same time.
+	std::error_code error;
+	fs::create_directories(filePath.parent_path(), error);
+	if (fs::is_directory(filePath.parent_path())) {
 		std::ofstream textFile;
 		//TODO: Handle write failures more gracefully.
 		textFile.open(filePath);
@@ -211,3 +251,42 @@ const bool writeStringStreamToPath(std::stringstream & stream, std::filesystem::
 	}
 	return false;
 }
+
+
+/**
+ * Parses a byte size such as "512M" or "1G". Suffixes are binary multiples.
+ * 
+ * @param text The text to parse.
+ * @param bytes Set to the parsed size in bytes, 0 if the text is empty.
+ * @return If the text was a valid size.
+ */
+bool parseByteSize(const std::string text, std::uint64_t & bytes) {
+	bytes = 0;
+	if (text.empty()) return true;
+	std::size_t digits = 0;
+	while (digits < text.length() && std::isdigit(static_cast<unsigned char>(text[digits]))) digits++;
+	if (digits == 0) return false;
+	std::uint64_t value = 0;
+	auto [valueEnd, valueError] = std::from_chars(text.data(), text.data() + digits, value);
+	if (valueError != std::errc()) return false;
+	std::string suffix = text.substr(digits);
+	for (char & character : suffix) character = std::toupper(static_cast<unsigned char>(character));
+	int shift = 0;
+	if (suffix == "" || suffix == "B") {
+		shift = 0;
+	} else if (suffix == "K" || suffix == "KB" || suffix == "KIB") {
+		shift = 10;
+	} else if (suffix == "M" || suffix == "MB" || suffix == "MIB") {
+		shift = 20;
+	} else if (suffix == "G" || suffix == "GB" || suffix == "GIB") {
+		shift = 30;
+	} else if (suffix == "T" || suffix == "TB" || suffix == "TIB") {
+		shift = 40;
+	} else {
+		return false;
+	}
+	//Sizes too large to count in bytes are invalid rather than wrapping around to a small budget.
+	if (value > (UINT64_MAX >> shift)) return false;
+	bytes = value << shift;
+	return true;
+}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <filesystem>
 #include <sstream>
 #include <nlohmann/json.hpp>
@@ -16,8 +17,14 @@ int replaceFirstOfX(std::string & text, const char x, const std::string replacem
 
 const std::string fetchText(std::filesystem::path filePath);
 
+bool tryFetchText(std::filesystem::path filePath, std::string & text);
+
+const nlohmann::json parseJsonText(std::string jsonString, bool valuesHaveNewlines);
+
 const nlohmann::json fetchJson(std::filesystem::path filePath, bool valuesHaveNewlines);
 
 const nlohmann::json fetchJson(std::filesystem::path filePath);
 
 const bool writeStringStreamToPath(std::stringstream & stream, std::filesystem::path filePath);
+
+bool parseByteSize(const std::string text, std::uint64_t & bytes);
@@ -0,0 +1,418 @@
+#include "value_index.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace fs = std::filesystem;
+
+//Index layout, every number little endian:
+//  magic, then the asset, field, value, token and posting counts as 64 bit numbers
+//  assets, a string reference to the intermediary asset path each
+//  fields, a string reference to the name, then the value count, shortest and longest length as 32 bit numbers and total length as 64 bit
+//  values, the asset and field ids as 32 bit numbers, string references to the pointer and text, then the length as 32 bit
+//  tokens sorted by text, a string reference, then the first posting as 64 bit and posting count as 32 bit
+//  postings, value ids as 32 bit numbers, in order for each token
+//  strings, the bytes every string reference points into
+//A string reference is a 64 bit offset into the strings followed by a 32 bit length. Lengths count characters, not bytes.
+const std::string valueIndexMagic = "SBPHVIX1";
+const std::uint64_t valueIndexHeaderSize = 48;
+const std::uint64_t stringReferenceSize = 12;
+const std::uint64_t fieldRecordSize = stringReferenceSize + 20;
+const std::uint64_t valueRecordSize = 8 + stringReferenceSize * 2 + 4;
+const std::uint64_t tokenRecordSize = stringReferenceSize + 12;
+
+namespace {
+	void appendNumber(std::string & section, std::uint64_t value, int byteCount) {
+		for (int i = 0; i < byteCount; i++) section += static_cast<char>((value >> (i * 8)) & 0xff);
+	}
+
+	std::string toLower(std::string_view text) {
+		std::string lowerText = std::string(text);
+		for (char & character : lowerText) {
+			if (character >= 'A' && character <= 'Z') character += 'a' - 'A';
+		}
+		return lowerText;
+	}
+}
+
+ValueIndexWriter::ValueIndexWriter() { }
+
+/**
+ * Records the values extracted from one asset. Safe to call from several threads.
+ * 
+ * @param assetPath The intermediary asset path, using forward slashes.
+ * @param fileExtension The extension of the parse target the values were extracted with, fields are grouped by it.
+ * @param allValues The string values written to the intermediary file.
+ */
+void ValueIndexWriter::addAsset(const std::string & assetPath, const std::string & fileExtension, const std::vector<ExtractedValue> & allValues) {
+	std::vector<ExtractedValue> allNamedValues = allValues;
+	for (ExtractedValue & value : allNamedValues) value.fieldPath = fileExtension + ' ' + value.fieldPath;
+	std::lock_guard<std::mutex> lock(indexMutex);
+	allAssetValues[assetPath] = std::move(allNamedValues);
+}
+
+/**
+ * Tokenises every recorded value and writes the index. Assets are written in path order, so the same values always give the same file.
+ * 
+ * @param indexPath The path the index should be written to.
+ * @return If the index was written.
+ */
+bool ValueIndexWriter::write(fs::path indexPath) {
+	std::string assetSection;
+	std::string valueSection;
+	std::string strings;
+	//Pointers and repeated values are stored once.
+	std::unordered_map<std::string, std::uint64_t> stringOffsets;
+	auto appendString = [&](std::string & section, const std::string & text) {
+		auto [stringOffset, added] = stringOffsets.emplace(text, strings.size());
+		if (added) strings += text;
+		appendNumber(section, stringOffset->second, 8);
+		appendNumber(section, text.size(), 4);
+	};
+
+	struct FieldStats {
+		std::uint32_t valueCount = 0;
+		std::uint32_t minLength = UINT32_MAX;
+		std::uint32_t maxLength = 0;
+		std::uint64_t totalLength = 0;
+	};
+	std::vector<std::string> allFieldNames;
+	std::vector<FieldStats> allFieldStats;
+	std::unordered_map<std::string, std::uint32_t> fieldIds;
+	std::map<std::string, std::vector<std::uint32_t>> allPostings;
+
+	std::uint32_t assetId = 0;
+	std::uint32_t valueId = 0;
+	for (const auto & [assetPath, allValues] : allAssetValues) {
+		appendString(assetSection, assetPath);
+		for (const ExtractedValue & value : allValues) {
+			auto [fieldId, added] = fieldIds.emplace(value.fieldPath, allFieldNames.size());
+			if (added) {
+				allFieldNames.push_back(value.fieldPath);
+				allFieldStats.push_back(FieldStats());
+			}
+			const std::uint32_t length = countCharacters(value.text);
+			FieldStats & fieldStats = allFieldStats[fieldId->second];
+			fieldStats.valueCount++;
+			fieldStats.minLength = std::min(fieldStats.minLength, length);
+			fieldStats.maxLength = std::max(fieldStats.maxLength, length);
+			fieldStats.totalLength += length;
+
+			appendNumber(valueSection, assetId, 4);
+			appendNumber(valueSection, fieldId->second, 4);
+			appendString(valueSection, value.path);
+			appendString(valueSection, value.text);
+			appendNumber(valueSection, length, 4);
+
+			//A word repeated in a value is only listed once.
+			for (const std::string & token : tokeniseValueText(value.text)) {
+				std::vector<std::uint32_t> & postings = allPostings[token];
+				if (postings.empty() || postings.back() != valueId) postings.push_back(valueId);
+			}
+			valueId++;
+		}
+		assetId++;
+	}
+
+	std::string fieldSection;
+	for (std::size_t i = 0; i < allFieldNames.size(); i++) {
+		appendString(fieldSection, allFieldNames[i]);
+		appendNumber(fieldSection, allFieldStats[i].valueCount, 4);
+		appendNumber(fieldSection, allFieldStats[i].minLength, 4);
+		appendNumber(fieldSection, allFieldStats[i].maxLength, 4);
+		appendNumber(fieldSection, allFieldStats[i].totalLength, 8);
+	}
+
+	std::string tokenSection;
+	std::string postingSection;
+	std::uint64_t postingCount = 0;
+	for (const auto & [token, postings] : allPostings) {
+		appendString(tokenSection, token);
+		appendNumber(tokenSection, postingCount, 8);
+		appendNumber(tokenSection, postings.size(), 4);
+		for (std::uint32_t postingValueId : postings) appendNumber(postingSection, postingValueId, 4);
+		postingCount += postings.size();
+	}
+
+	std::string header = valueIndexMagic;
+	appendNumber(header, allAssetValues.size(), 8);
+	appendNumber(header, allFieldNames.size(), 8);
+	appendNumber(header, valueId, 8);
+	appendNumber(header, allPostings.size(), 8);
+	appendNumber(header, postingCount, 8);
+
+	if (!indexPath.parent_path().empty() && !fs::exists(indexPath.parent_path()) && !fs::create_directories(indexPath.parent_path())) {
+		return false;
+	}
+	std::ofstream indexFile = std::ofstream(indexPath, std::ios::binary | std::ios::trunc);
+	if (!indexFile.is_open()) return false;
+	for (const std::string * section : {&header, &assetSection, &fieldSection, &valueSection, &tokenSection, &postingSection, &strings}) {
+		indexFile.write(section->data(), section->size());
+	}
+	return indexFile.good();
+}
+
+//Getters
+
+const std::size_t ValueIndexWriter::getAssetCount() { return allAssetValues.size(); }
+
+ValueIndexReader::ValueIndexReader() { }
+
+/**
+ * Maps an index file. Only the section sizes, assets and fields are checked, values are read and checked as they are looked up.
+ * 
+ * @param indexPath The path of the index.
+ * @return If the file is a complete index, isCorrupt tells if it was there but is not one.
+ */
+bool ValueIndexReader::open(fs::path indexPath) {
+	corrupt = false;
+	if (!indexFile.open(indexPath)) return false;
+	corrupt = true;
+	indexData = indexFile.getView(0, indexFile.getSize());
+	if (indexData.size() < valueIndexHeaderSize || !indexData.starts_with(valueIndexMagic)) return false;
+
+	assetCount = readNumber(8, 8);
+	fieldCount = readNumber(16, 8);
+	valueCount = readNumber(24, 8);
+	tokenCount = readNumber(32, 8);
+	postingCount = readNumber(40, 8);
+	//Ids are 32 bit, and each section has to fit in what is left of the file.
+	if (assetCount > UINT32_MAX || fieldCount > UINT32_MAX || valueCount > UINT32_MAX) return false;
+	std::uint64_t sectionOffset = valueIndexHeaderSize;
+	auto addSection = [&](std::uint64_t recordCount, std::uint64_t recordSize) {
+		if (recordCount > (indexData.size() - sectionOffset) / recordSize) return false;
+		sectionOffset += recordCount * recordSize;
+		return true;
+	};
+	if (!addSection(assetCount, stringReferenceSize)) return false;
+	fieldsOffset = sectionOffset;
+	if (!addSection(fieldCount, fieldRecordSize)) return false;
+	valuesOffset = sectionOffset;
+	if (!addSection(valueCount, valueRecordSize)) return false;
+	tokensOffset = sectionOffset;
+	if (!addSection(tokenCount, tokenRecordSize)) return false;
+	postingsOffset = sectionOffset;
+	if (!addSection(postingCount, 4)) return false;
+	stringsOffset = sectionOffset;
+
+	corrupt = false;
+	for (std::uint64_t assetId = 0; assetId < assetCount && !corrupt; assetId++) readString(valueIndexHeaderSize + assetId * stringReferenceSize);
+	for (std::uint64_t fieldId = 0; fieldId < fieldCount && !corrupt; fieldId++) readString(fieldsOffset + fieldId * fieldRecordSize);
+	return !corrupt;
+}
+
+/**
+ * Reads a number, marking the index corrupt and giving 0 if it is past the end.
+ */
+std::uint64_t ValueIndexReader::readNumber(std::uint64_t offset, int byteCount) {
+	if (offset > indexData.size() || static_cast<std::uint64_t>(byteCount) > indexData.size() - offset) {
+		corrupt = true;
+		return 0;
+	}
+	std::uint64_t value = 0;
+	for (int i = byteCount - 1; i >= 0; i--) value = (value << 8) | static_cast<unsigned char>(indexData[offset + i]);
+	return value;
+}
+
+/**
+ * Reads the string a reference points to, marking the index corrupt and giving an empty string if it is outside the strings.
+ */
+std::string_view ValueIndexReader::readString(std::uint64_t recordOffset) {
+	const std::uint64_t stringOffset = readNumber(recordOffset, 8);
+	const std::uint64_t stringLength = readNumber(recordOffset + 8, 4);
+	const std::uint64_t stringsSize = indexData.size() - stringsOffset;
+	if (stringOffset > stringsSize || stringLength > stringsSize - stringOffset) {
+		corrupt = true;
+		return std::string_view();
+	}
+	return indexData.substr(stringsOffset + stringOffset, stringLength);
+}
+
+std::string_view ValueIndexReader::getTokenText(std::uint64_t tokenId) {
+	return readString(tokensOffset + tokenId * tokenRecordSize);
+}
+
+/**
+ * Finds every value containing a word starting with the prefix.
+ * 
+ * @return The sorted ids of the values.
+ */
+std::vector<std::uint32_t> ValueIndexReader::findPrefixPostings(const std::string & prefix) {
+	//Tokens are sorted, so the matches are a run starting at the first token not before the prefix.
+	std::uint64_t first = 0;
+	std::uint64_t last = tokenCount;
+	while (first < last) {
+		const std::uint64_t middle = first + (last - first) / 2;
+		if (getTokenText(middle) < prefix) {
+			first = middle + 1;
+		} else {
+			last = middle;
+		}
+	}
+	std::vector<std::uint32_t> allValueIds;
+	std::size_t matchedTokens = 0;
+	for (std::uint64_t tokenId = first; tokenId < tokenCount && getTokenText(tokenId).starts_with(prefix); tokenId++) {
+		const std::uint64_t tokenRecord = tokensOffset + tokenId * tokenRecordSize;
+		const std::uint64_t firstPosting = readNumber(tokenRecord + stringReferenceSize, 8);
+		const std::uint64_t postings = readNumber(tokenRecord + stringReferenceSize + 8, 4);
+		if (firstPosting > postingCount || postings > postingCount - firstPosting) {
+			corrupt = true;
+			break;
+		}
+		for (std::uint64_t i = 0; i < postings; i++) {
+			const std::uint64_t valueId = readNumber(postingsOffset + (firstPosting + i) * 4, 4);
+			if (valueId >= valueCount) {
+				corrupt = true;
+				continue;
+			}
+			allValueIds.push_back(static_cast<std::uint32_t>(valueId));
+		}
+		matchedTokens++;
+	}
+	if (matchedTokens > 1) {
+		std::sort(allValueIds.begin(), allValueIds.end());
+		allValueIds.erase(std::unique(allValueIds.begin(), allValueIds.end()), allValueIds.end());
+	}
+	return allValueIds;
+}
+
+/**
+ * Finds the values matching every part of a query. Words narrow the values through the index,
+ * then each value is checked to contain every term as written, ignoring case.
+ * Values out of range are read as empty, so isCorrupt should be checked before using the matches.
+ * 
+ * @param query The words, field, asset and length limits to match.
+ * @return The ids of the matching values, in asset path order.
+ */
+std::vector<std::uint32_t> ValueIndexReader::findValues(const ValueQuery & query) {
+	//Fields whose lengths can not match are skipped without looking at their values.
+	std::vector<bool> allFieldsMatch = std::vector<bool>(fieldCount);
+	for (std::uint32_t fieldId = 0; fieldId < fieldCount; fieldId++) {
+		const IndexedField field = getField(fieldId);
+		allFieldsMatch[fieldId] = field.fieldName.find(query.fieldFragment) != std::string_view::npos && field.maxLength >= query.minLength && field.minLength <= query.maxLength;
+	}
+
+	std::vector<std::uint32_t> allCandidates;
+	bool narrowed = false;
+	std::vector<std::string> allLowerTerms;
+	for (const std::string & term : query.allTerms) {
+		allLowerTerms.push_back(toLower(term));
+		for (const std::string & token : tokeniseValueText(term)) {
+			std::vector<std::uint32_t> allTokenValues = findPrefixPostings(token);
+			if (narrowed) {
+				std::vector<std::uint32_t> allShared;
+				std::set_intersection(allCandidates.begin(), allCandidates.end(), allTokenValues.begin(), allTokenValues.end(), std::back_inserter(allShared));
+				allCandidates = std::move(allShared);
+			} else {
+				allCandidates = std::move(allTokenValues);
+				narrowed = true;
+			}
+		}
+	}
+	if (!narrowed) {
+		allCandidates.resize(valueCount);
+		for (std::uint32_t valueId = 0; valueId < valueCount; valueId++) allCandidates[valueId] = valueId;
+	}
+
+	std::vector<std::uint32_t> allMatches;
+	for (std::uint32_t valueId : allCandidates) {
+		const std::uint64_t valueRecord = valuesOffset + valueId * valueRecordSize;
+		const std::uint64_t fieldId = readNumber(valueRecord + 4, 4);
+		if (fieldId >= fieldCount) {
+			corrupt = true;
+			continue;
+		}
+		if (!allFieldsMatch[fieldId]) continue;
+		const IndexedValue value = getValue(valueId);
+		if (value.length < query.minLength || value.length > query.maxLength) continue;
+		if (value.assetPath.find(query.assetFragment) == std::string_view::npos) continue;
+		if (!allLowerTerms.empty()) {
+			const std::string lowerText = toLower(value.text);
+			if (!std::all_of(allLowerTerms.begin(), allLowerTerms.end(), [&](const std::string & term) { return lowerText.find(term) != std::string::npos; })) continue;
+		}
+		allMatches.push_back(valueId);
+	}
+	return allMatches;
+}
+
+/**
+ * Reads a value, marking the index corrupt and leaving any part that is out of range empty.
+ */
+IndexedValue ValueIndexReader::getValue(std::uint32_t valueId) {
+	IndexedValue value;
+	if (valueId >= valueCount) {
+		corrupt = true;
+		return value;
+	}
+	const std::uint64_t valueRecord = valuesOffset + valueId * valueRecordSize;
+	const std::uint64_t assetId = readNumber(valueRecord, 4);
+	const std::uint64_t fieldId = readNumber(valueRecord + 4, 4);
+	if (assetId >= assetCount || fieldId >= fieldCount) {
+		corrupt = true;
+	} else {
+		value.assetPath = readString(valueIndexHeaderSize + assetId * stringReferenceSize);
+		value.fieldName = readString(fieldsOffset + fieldId * fieldRecordSize);
+	}
+	value.path = readString(valueRecord + 8);
+	value.text = readString(valueRecord + 8 + stringReferenceSize);
+	value.length = static_cast<std::uint32_t>(readNumber(valueRecord + 8 + stringReferenceSize * 2, 4));
+	return value;
+}
+
+IndexedField ValueIndexReader::getField(std::uint32_t fieldId) {
+	IndexedField field;
+	if (fieldId >= fieldCount) {
+		corrupt = true;
+		return field;
+	}
+	const std::uint64_t fieldRecord = fieldsOffset + fieldId * fieldRecordSize;
+	field.fieldName = readString(fieldRecord);
+	field.valueCount = static_cast<std::uint32_t>(readNumber(fieldRecord + stringReferenceSize, 4));
+	field.minLength = static_cast<std::uint32_t>(readNumber(fieldRecord + stringReferenceSize + 4, 4));
+	field.maxLength = static_cast<std::uint32_t>(readNumber(fieldRecord + stringReferenceSize + 8, 4));
+	field.totalLength = readNumber(fieldRecord + stringReferenceSize + 12, 8);
+	return field;
+}
+
+//Getters
+
+const std::uint64_t ValueIndexReader::getAssetCount() { return assetCount; }
+const std::uint64_t ValueIndexReader::getFieldCount() { return fieldCount; }
+const std::uint64_t ValueIndexReader::getValueCount() { return valueCount; }
+const bool ValueIndexReader::isCorrupt() { return corrupt; }
+
+/**
+ * Splits text into lower case words. Letters, digits and any non ASCII characters make up words.
+ */
+std::vector<std::string> tokeniseValueText(std::string_view text) {
+	std::vector<std::string> allTokens;
+	std::string token;
+	for (char character : text) {
+		const unsigned char byte = static_cast<unsigned char>(character);
+		if (byte >= 0x80 || (byte >= '0' && byte <= '9') || (byte >= 'a' && byte <= 'z')) {
+			token += character;
+		} else if (byte >= 'A' && byte <= 'Z') {
+			token += static_cast<char>(byte + ('a' - 'A'));
+		} else if (!token.empty()) {
+			allTokens.push_back(std::move(token));
+			token.clear();
+		}
+	}
+	if (!token.empty()) allTokens.push_back(std::move(token));
+	return allTokens;
+}
+
+/**
+ * Counts the UTF-8 characters in text.
+ */
+std::uint32_t countCharacters(std::string_view text) {
+	return static_cast<std::uint32_t>(std::count_if(text.begin(), text.end(), [](char character) { return (static_cast<unsigned char>(character) & 0xc0) != 0x80; }));
+}
+
+fs::path getValueIndexPath(fs::path intermediaryAssetPath) {
+	fs::path indexPath = intermediaryAssetPath;
+	indexPath += ".index";
+	return indexPath;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.h"
+
+struct ExtractedValue {
+	//The configured pointer the value was found with, before numeric iterator markers are replaced.
+	std::string fieldPath;
+	std::string path;
+	std::string text;
+};
+
+struct IndexedValue {
+	std::string_view assetPath;
+	std::string_view fieldName;
+	std::string_view path;
+	std::string_view text;
+	std::uint32_t length = 0;
+};
+
+struct IndexedField {
+	std::string_view fieldName;
+	std::uint32_t valueCount = 0;
+	std::uint32_t minLength = 0;
+	std::uint32_t maxLength = 0;
+	std::uint64_t totalLength = 0;
+};
+
+struct ValueQuery {
+	//Words every matching value contains, each also matching as a word prefix.
+	std::vector<std::string> allTerms;
+	std::string fieldFragment;
+	std::string assetFragment;
+	std::uint32_t minLength = 0;
+	std::uint32_t maxLength = UINT32_MAX;
+};
+
+class ValueIndexWriter {
+private:
+	std::map<std::string, std::vector<ExtractedValue>> allAssetValues;
+	std::mutex indexMutex;
+public:
+	ValueIndexWriter();
+	void addAsset(const std::string & assetPath, const std::string & fileExtension, const std::vector<ExtractedValue> & allValues);
+	bool write(std::filesystem::path indexPath);
+	//Getters
+	const std::size_t getAssetCount();
+};
+
+class ValueIndexReader {
+private:
+	MappedFile indexFile;
+	std::string_view indexData;
+	std::uint64_t assetCount = 0;
+	std::uint64_t fieldCount = 0;
+	std::uint64_t valueCount = 0;
+	std::uint64_t tokenCount = 0;
+	std::uint64_t postingCount = 0;
+	std::uint64_t fieldsOffset = 0;
+	std::uint64_t valuesOffset = 0;
+	std::uint64_t tokensOffset = 0;
+	std::uint64_t postingsOffset = 0;
+	std::uint64_t stringsOffset = 0;
+	bool corrupt = false;
+
+	std::uint64_t readNumber(std::uint64_t offset, int byteCount);
+	std::string_view readString(std::uint64_t recordOffset);
+	std::string_view getTokenText(std::uint64_t tokenId);
+	std::vector<std::uint32_t> findPrefixPostings(const std::string & prefix);
+public:
+	ValueIndexReader();
+	bool open(std::filesystem::path indexPath);
+	std::vector<std::uint32_t> findValues(const ValueQuery & query);
+	IndexedValue getValue(std::uint32_t valueId);
+	IndexedField getField(std::uint32_t fieldId);
+	//Getters
+	const std::uint64_t getAssetCount();
+	const std::uint64_t getFieldCount();
+	const std::uint64_t getValueCount();
+	const bool isCorrupt();
+};
+
+std::vector<std::string> tokeniseValueText(std::string_view text);
+
+std::uint32_t countCharacters(std::string_view text);
+
+std::filesystem::path getValueIndexPath(std::filesystem::path intermediaryAssetPath);
@@ -0,0 +1,211 @@
+#include "value_intern_table.h"
+
+#include <algorithm>
+#include <charconv>
+#include <iostream>
+#include <numeric>
+#include "content_hash_memo.h"
+#include "user_interaction_helper.h"
+#include "utilities.h"
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+//Key of the object intermediary files use in place of an interned value.
+const std::string internedValueKey = "internedValue";
+
+ValueInternTable::ValueInternTable() { }
+
+/**
+ * Adds a value to the table if an identical value is not already in it. Safe to call from several threads.
+ * 
+ * @param value The value to intern.
+ * @return The id of the value in the table.
+ */
+int ValueInternTable::intern(const json & value) {
+	std::string valueText = value.dump();
+	std::lock_guard<std::mutex> lock(internMutex);
+	auto found = valueIds.find(valueText);
+	if (found != valueIds.end()) {
+		allUseCounts[found->second]++;
+		return found->second;
+	}
+	const int id = allValueTexts.size();
+	valueIds.emplace(valueText, id);
+	allValueTexts.push_back(std::move(valueText));
+	allUseCounts.push_back(1);
+	return id;
+}
+
+/**
+ * Counts another use of values that were already interned, such as by a reused intermediary file.
+ * 
+ * @param allIds The id of every value used, once per use.
+ */
+void ValueInternTable::addUses(const std::vector<int> & allIds) {
+	std::lock_guard<std::mutex> lock(internMutex);
+	for (const int id : allIds) allUseCounts[id]++;
+}
+
+/**
+ * Renumbers the values in order of their text, so the same assets always give the same ids however the threads interning them were scheduled.
+ * Intermediary files written before this need their references renumbered with renumberReferences.
+ */
+void ValueInternTable::sortValues() {
+	std::lock_guard<std::mutex> lock(internMutex);
+	std::vector<int> allOldIds(allValueTexts.size());
+	std::iota(allOldIds.begin(), allOldIds.end(), 0);
+	std::sort(allOldIds.begin(), allOldIds.end(), [&](int first, int second) {
+		return allValueTexts[first] < allValueTexts[second];
+	});
+
+	std::vector<std::string> allSortedTexts;
+	std::vector<int> allSortedUseCounts;
+	allSortedTexts.reserve(allOldIds.size());
+	allSortedUseCounts.reserve(allOldIds.size());
+	sortedIds.assign(allOldIds.size(), 0);
+	for (std::size_t id = 0; id < allOldIds.size(); id++) {
+		const int oldId = allOldIds[id];
+		sortedIds[oldId] = static_cast<int>(id);
+		allSortedTexts.push_back(std::move(allValueTexts[oldId]));
+		allSortedUseCounts.push_back(allUseCounts[oldId]);
+	}
+	allValueTexts = std::move(allSortedTexts);
+	allUseCounts = std::move(allSortedUseCounts);
+	valueIds.clear();
+	for (std::size_t id = 0; id < allValueTexts.size(); id++) valueIds.emplace(allValueTexts[id], static_cast<int>(id));
+}
+
+/**
+ * Replaces the ids of the references in an intermediary file written before the table was sorted with their sorted ids.
+ * 
+ * @param intermediaryText The intermediary text as it was written.
+ * @return The intermediary text with every reference renumbered.
+ */
+std::string ValueInternTable::renumberReferences(const std::string & intermediaryText) {
+	const std::string referenceStart = "{\"" + internedValueKey + "\" : ";
+	std::string renumberedText;
+	renumberedText.reserve(intermediaryText.length());
+	std::size_t copiedEnd = 0;
+	std::size_t referencePosition = intermediaryText.find(referenceStart);
+	while (referencePosition != std::string::npos) {
+		const std::size_t idStart = referencePosition + referenceStart.length();
+		std::size_t idEnd = idStart;
+		while (idEnd < intermediaryText.length() && intermediaryText[idEnd] >= '0' && intermediaryText[idEnd] <= '9') idEnd++;
+		//Only whole references written by the intermediary writer are renumbered.
+		if (idEnd > idStart && idEnd < intermediaryText.length() && intermediaryText[idEnd] == '}') {
+			std::size_t oldId = 0;
+			auto [parsedEnd, parseError] = std::from_chars(intermediaryText.data() + idStart, intermediaryText.data() + idEnd, oldId);
+			if (parseError == std::errc() && oldId < sortedIds.size()) {
+				renumberedText.append(intermediaryText, copiedEnd, idStart - copiedEnd);
+				renumberedText += std::to_string(sortedIds[oldId]);
+				copiedEnd = idEnd;
+			}
+		}
+		referencePosition = intermediaryText.find(referenceStart, idEnd);
+	}
+	renumberedText.append(intermediaryText, copiedEnd, std::string::npos);
+	return renumberedText;
+}
+
+/**
+ * Writes every interned value to a string stream.
+ * 
+ * @param tableText The string stream the table will be written to.
+ */
+void ValueInternTable::writeTable(std::stringstream & tableText) {
+	tableText << "//Values shared by intermediary files. Intermediary values of {\"" << internedValueKey << "\" : id} are replaced with the value of the matching id.\n"
+		<< '{';
+	for (std::size_t id = 0; id < allValueTexts.size(); id++) {
+		if (id > 0) tableText << ",\n";
+		tableText << "\n  //Used " << allUseCounts[id] << (allUseCounts[id] == 1 ? " time" : " times")
+			<< "\n  \"" << id << "\" : " << allValueTexts[id];
+	}
+	tableText << "\n}\n";
+}
+
+/**
+ * Loads a previously written table so references can be resolved.
+ * 
+ * @param tablePath The path to load the table from.
+ * @return If the table was loaded.
+ */
+bool ValueInternTable::loadTable(fs::path tablePath) {
+	if (!fs::exists(tablePath)) return false;
+	//The table is edited by hand, so malformed JSON or keys that are not ids mean it can not be read rather than a crash.
+	json tableJson;
+	try {
+		tableJson = fetchJson(tablePath);
+	} catch (const json::exception & exception) {
+		std::lock_guard<std::mutex> lock(consoleMutex);
+		std::cout << exception.what() << std::endl;
+		return false;
+	}
+	if (!tableJson.is_object()) return false;
+	std::unordered_map<int, json> allLoadedValues;
+	allLoadedValues.reserve(tableJson.size());
+	for (auto & [key, value] : tableJson.items()) {
+		int id = 0;
+		auto [idEnd, idError] = std::from_chars(key.data(), key.data() + key.length(), id);
+		if (idError != std::errc() || idEnd != key.data() + key.length()) {
+			std::lock_guard<std::mutex> lock(consoleMutex);
+			std::cout << "Interned value key \"" << key << "\" is not an id.\n";
+			return false;
+		}
+		allLoadedValues.emplace(id, value);
+	}
+	valuesById = std::move(allLoadedValues);
+	tableHash = hashContent(tableJson.dump());
+	return true;
+}
+
+/**
+ * Replaces every top level reference in an intermediary JSON with its interned value.
+ * References without a matching value are removed.
+ * 
+ * @param intermediaryJson The intermediary JSON to resolve references in.
+ * @return How many references were resolved.
+ */
+int ValueInternTable::resolveReferences(json & intermediaryJson) {
+	if (!intermediaryJson.is_object()) return 0;
+	int totalResolved = 0;
+	for (auto iteration = intermediaryJson.begin(); iteration != intermediaryJson.end();) {
+		if (isReference(iteration.value())) {
+			const int id = iteration.value()[internedValueKey];
+			auto found = valuesById.find(id);
+			if (found != valuesById.end()) {
+				iteration.value() = found->second;
+				totalResolved++;
+			} else {
+				std::lock_guard<std::mutex> lock(consoleMutex);
+				std::cout << "Interned value " << id << " for \"" << iteration.key() << "\" not found, skipping value.\n";
+				iteration = intermediaryJson.erase(iteration);
+				continue;
+			}
+		}
+		++iteration;
+	}
+	return totalResolved;
+}
+
+/**
+ * @param value The value to check.
+ * @return If the value is a reference to an interned value.
+ */
+bool ValueInternTable::isReference(const json & value) {
+	return value.is_object() && value.size() == 1 && value.contains(internedValueKey) && value[internedValueKey].is_number_integer();
+}
+
+const std::size_t ValueInternTable::getValueCount() { return allValueTexts.size(); }
+const std::uint64_t ValueInternTable::getTableHash() { return tableHash; }
+
+/**
+ * @param intermediaryAssetPath The intermediary asset folder.
+ * @return The path of the interned value table that goes with the intermediary assets.
+ */
+fs::path getInternedValuesPath(fs::path intermediaryAssetPath) {
+	fs::path tablePath = intermediaryAssetPath;
+	tablePath += ".interned.json";
+	return tablePath;
+}
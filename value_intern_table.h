@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+class ValueInternTable {
+private:
+	std::unordered_map<std::string, int> valueIds;
+	std::unordered_map<int, nlohmann::json> valuesById;
+	std::vector<std::string> allValueTexts;
+	std::vector<int> allUseCounts;
+	//The id each value had before the table was sorted.
+	std::vector<int> sortedIds;
+	//Hash of the loaded table, so results made with different tables are told apart.
+	std::uint64_t tableHash = 0;
+	std::mutex internMutex;
+public:
+	ValueInternTable();
+	int intern(const nlohmann::json & value);
+	void addUses(const std::vector<int> & allIds);
+	void sortValues();
+	std::string renumberReferences(const std::string & intermediaryText);
+	void writeTable(std::stringstream & tableText);
+	bool loadTable(std::filesystem::path tablePath);
+	int resolveReferences(nlohmann::json & intermediaryJson);
+	static bool isReference(const nlohmann::json & value);
+	//Getters
+	const std::size_t getValueCount();
+	const std::uint64_t getTableHash();
+};
+
+std::filesystem::path getInternedValuesPath(std::filesystem::path intermediaryAssetPath);
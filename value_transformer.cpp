@@ -0,0 +1,369 @@
+#include "value_transformer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <queue>
+#include "utilities.h"
+
+using json = nlohmann::json;
+
+namespace fs = std::filesystem;
+
+namespace {
+	bool isWordCharacter(char character) {
+		const unsigned char byte = static_cast<unsigned char>(character);
+		return byte >= 0x80 || std::isalnum(byte) || byte == '_';
+	}
+
+	//Renumbers the backreferences of a pattern, such as \1, to its capture groups in the combined expression.
+	std::string offsetBackreferences(const std::string & pattern, std::size_t groupOffset) {
+		std::string offsetPattern;
+		bool inClass = false;
+		for (std::size_t i = 0; i < pattern.size(); i++) {
+			const char character = pattern[i];
+			if (character == '\\' && i + 1 < pattern.size()) {
+				//Digits in a class are not backreferences, and \0 is a null character.
+				if (!inClass && pattern[i + 1] >= '1' && pattern[i + 1] <= '9') {
+					std::size_t groupEnd = i + 1;
+					std::size_t group = 0;
+					while (groupEnd < pattern.size() && std::isdigit(static_cast<unsigned char>(pattern[groupEnd])) && group < 100000) group = group * 10 + (pattern[groupEnd++] - '0');
+					offsetPattern += '\\' + std::to_string(groupOffset + group);
+					i = groupEnd - 1;
+				} else {
+					offsetPattern += character;
+					offsetPattern += pattern[++i];
+				}
+				continue;
+			}
+			if (character == '[') inClass = true;
+			if (character == ']') inClass = false;
+			offsetPattern += character;
+		}
+		return offsetPattern;
+	}
+}
+
+ValueTransformer::ValueTransformer() {
+	allNodes.push_back(AutomatonNode());
+	allNodes[0].next.fill(0);
+}
+
+/**
+ * Loads every rule set in a folder, in file name order. Literals from every set are compiled into one automaton,
+ * and regexes sharing a filter into one expression.
+ * 
+ * @param transformsPath The folder of transform configs, a missing folder has no rules.
+ * @return If every config could be loaded.
+ */
+bool ValueTransformer::loadRules(fs::path transformsPath) {
+	if (!fs::is_directory(transformsPath)) return true;
+	std::vector<fs::path> allConfigPaths;
+	for (const auto & directory : fs::directory_iterator(transformsPath)) {
+		if (directory.path().extension() == ".json") allConfigPaths.push_back(directory.path());
+	}
+	std::sort(allConfigPaths.begin(), allConfigPaths.end());
+
+	for (const fs::path & configPath : allConfigPaths) {
+		try {
+			if (!loadRuleSet(fetchJson(configPath), configPath.string())) return false;
+		} catch (const json::exception & exception) {
+			std::cout << "Transform config could not be read:\n"
+				<< configPath.string() << '\n'
+				<< exception.what() << std::endl;
+			return false;
+		}
+	}
+	buildAutomaton();
+	return true;
+}
+
+bool ValueTransformer::loadRuleSet(const json & rulesJson, const std::string & configName) {
+	if (rulesJson.contains("replace")) {
+		for (const json & ruleJson : rulesJson["replace"]) {
+			LiteralReplacement literal;
+			literal.find = ruleJson.value("find", "");
+			literal.replace = ruleJson.value("replace", "");
+			literal.wholeWord = ruleJson.value("wholeWord", false);
+			literal.filter = loadFilter(ruleJson);
+			if (literal.find.empty()) {
+				std::cout << "Transform config " << configName << " has a replacement with nothing to find, it will be ignored.\n";
+				continue;
+			}
+			allLiterals.push_back(literal);
+		}
+	}
+	if (rulesJson.contains("regexReplace")) {
+		for (const json & ruleJson : rulesJson["regexReplace"]) {
+			RegexReplacement regexReplacement;
+			regexReplacement.pattern = ruleJson.value("pattern", "");
+			regexReplacement.replace = ruleJson.value("replace", "");
+			const TransformFilter filter = loadFilter(ruleJson);
+			try {
+				regexReplacement.markCount = std::regex(regexReplacement.pattern).mark_count();
+			} catch (const std::regex_error & error) {
+				std::cout << "Transform config " << configName << " has an invalid regex:\n"
+					<< regexReplacement.pattern << '\n'
+					<< error.what() << std::endl;
+				return false;
+			}
+
+			//Each pattern becomes one capture group of the expression for its filter, with its own groups and backreferences after it.
+			auto regexSet = std::find_if(allRegexSets.begin(), allRegexSets.end(), [&](const RegexReplacementSet & existingSet) {
+				return existingSet.filter.fileExtension == filter.fileExtension && existingSet.filter.field == filter.field;
+			});
+			if (regexSet == allRegexSets.end()) {
+				allRegexSets.push_back(RegexReplacementSet());
+				regexSet = allRegexSets.end() - 1;
+				regexSet->filter = filter;
+			}
+			regexReplacement.groupOffset = regexSet->allReplacements.empty() ? 1 : regexSet->allReplacements.back().groupOffset + regexSet->allReplacements.back().markCount + 1;
+			if (!regexSet->combinedPattern.empty()) regexSet->combinedPattern += '|';
+			regexSet->combinedPattern += '(' + offsetBackreferences(regexReplacement.pattern, regexReplacement.groupOffset) + ')';
+			regexSet->allReplacements.push_back(regexReplacement);
+		}
+	}
+	if (rulesJson.contains("scale")) {
+		for (const json & ruleJson : rulesJson["scale"]) {
+			NumericScaling scaling;
+			scaling.factor = ruleJson.value("factor", 1.0);
+			scaling.offset = ruleJson.value("offset", 0.0);
+			scaling.round = ruleJson.value("round", false);
+			scaling.filter = loadFilter(ruleJson);
+			allScalings.push_back(scaling);
+		}
+	}
+	return true;
+}
+
+TransformFilter ValueTransformer::loadFilter(const json & ruleJson) {
+	TransformFilter filter;
+	filter.fileExtension = ruleJson.value("fileExtension", "");
+	filter.field = ruleJson.value("field", "");
+	return filter;
+}
+
+/**
+ * Builds the literal automaton and compiles the combined regexes.
+ */
+void ValueTransformer::buildAutomaton() {
+	allNodes.resize(1);
+	allNodes[0].next.fill(-1);
+	allNodes[0].allLiteralIds.clear();
+	for (std::size_t literalId = 0; literalId < allLiterals.size(); literalId++) {
+		int node = 0;
+		for (char character : allLiterals[literalId].find) {
+			const unsigned char byte = static_cast<unsigned char>(character);
+			if (allNodes[node].next[byte] < 0) {
+				AutomatonNode child;
+				child.next.fill(-1);
+				child.depth = allNodes[node].depth + 1;
+				allNodes.push_back(child);
+				allNodes[node].next[byte] = static_cast<int>(allNodes.size() - 1);
+			}
+			node = allNodes[node].next[byte];
+		}
+		allNodes[node].allLiteralIds.push_back(literalId);
+	}
+
+	//Breadth first, so every fail link points at a node that is already complete.
+	std::queue<int> pendingNodes;
+	for (int & child : allNodes[0].next) {
+		if (child < 0) {
+			child = 0;
+		} else {
+			pendingNodes.push(child);
+		}
+	}
+	while (!pendingNodes.empty()) {
+		const int node = pendingNodes.front();
+		pendingNodes.pop();
+		const AutomatonNode & failNode = allNodes[allNodes[node].fail];
+		allNodes[node].outputLink = failNode.allLiteralIds.empty() ? failNode.outputLink : allNodes[node].fail;
+		for (int byte = 0; byte < 256; byte++) {
+			const int child = allNodes[node].next[byte];
+			if (child < 0) {
+				allNodes[node].next[byte] = allNodes[allNodes[node].fail].next[byte];
+			} else {
+				allNodes[child].fail = allNodes[allNodes[node].fail].next[byte];
+				pendingNodes.push(child);
+			}
+		}
+	}
+
+	for (RegexReplacementSet & regexSet : allRegexSets) regexSet.combinedRegex = std::regex(regexSet.combinedPattern, std::regex::ECMAScript | std::regex::optimize);
+}
+
+/**
+ * Replaces every literal in one pass over the text. Where matches overlap the one starting first wins, then the longest,
+ * then the one configured first.
+ * 
+ * @return If anything was replaced.
+ */
+bool ValueTransformer::replaceLiterals(std::string & text, const std::string & fileExtension, const std::string & pointer) {
+	if (allLiterals.empty()) return false;
+	struct LiteralMatch {
+		std::size_t start = 0;
+		std::size_t length = 0;
+		std::size_t literalId = 0;
+	};
+	std::vector<LiteralMatch> allMatches;
+	int node = 0;
+	for (std::size_t i = 0; i < text.size(); i++) {
+		node = allNodes[node].next[static_cast<unsigned char>(text[i])];
+		for (int outputNode = allNodes[node].allLiteralIds.empty() ? allNodes[node].outputLink : node; outputNode >= 0; outputNode = allNodes[outputNode].outputLink) {
+			const std::size_t length = allNodes[outputNode].depth;
+			const std::size_t start = i + 1 - length;
+			for (std::size_t literalId : allNodes[outputNode].allLiteralIds) {
+				const LiteralReplacement & literal = allLiterals[literalId];
+				if (!matchesFilter(literal.filter, fileExtension, pointer)) continue;
+				if (literal.wholeWord && ((start > 0 && isWordCharacter(text[start - 1])) || (i + 1 < text.size() && isWordCharacter(text[i + 1])))) continue;
+				allMatches.push_back({start, length, literalId});
+			}
+		}
+	}
+	if (allMatches.empty()) return false;
+
+	std::sort(allMatches.begin(), allMatches.end(), [](const LiteralMatch & a, const LiteralMatch & b) {
+		if (a.start != b.start) return a.start < b.start;
+		if (a.length != b.length) return a.length > b.length;
+		return a.literalId < b.literalId;
+	});
+	std::string replacedText;
+	std::size_t copiedUntil = 0;
+	for (const LiteralMatch & match : allMatches) {
+		if (match.start < copiedUntil) continue;
+		replacedText.append(text, copiedUntil, match.start - copiedUntil);
+		replacedText += allLiterals[match.literalId].replace;
+		copiedUntil = match.start + match.length;
+	}
+	replacedText.append(text, copiedUntil);
+	text = std::move(replacedText);
+	return true;
+}
+
+/**
+ * Runs each combined regex over the text once. Replacements can use $& for the whole match, $1 to $99 for the
+ * pattern's own capture groups and $$ for a dollar sign. Like any ECMAScript alternation, at each position the first
+ * pattern in configured order that matches is used, even if a later one would match more.
+ * 
+ * @return If anything was replaced.
+ */
+bool ValueTransformer::replaceRegexes(std::string & text, const std::string & fileExtension, const std::string & pointer) {
+	bool replaced = false;
+	for (const RegexReplacementSet & regexSet : allRegexSets) {
+		if (!matchesFilter(regexSet.filter, fileExtension, pointer)) continue;
+		std::string replacedText;
+		std::size_t copiedUntil = 0;
+		bool setReplaced = false;
+		for (auto match = std::sregex_iterator(text.begin(), text.end(), regexSet.combinedRegex); match != std::sregex_iterator(); ++match) {
+			//The alternative that matched is the first with its group set.
+			const RegexReplacement * matchedReplacement = nullptr;
+			for (const RegexReplacement & regexReplacement : regexSet.allReplacements) {
+				if ((*match)[regexReplacement.groupOffset].matched) {
+					matchedReplacement = &regexReplacement;
+					break;
+				}
+			}
+			if (matchedReplacement == nullptr) continue;
+
+			replacedText.append(text, copiedUntil, match->position() - copiedUntil);
+			const std::string & replace = matchedReplacement->replace;
+			for (std::size_t i = 0; i < replace.size(); i++) {
+				if (replace[i] != '$' || i + 1 >= replace.size()) {
+					replacedText += replace[i];
+				} else if (replace[i + 1] == '$') {
+					replacedText += '$';
+					i++;
+				} else if (replace[i + 1] == '&') {
+					replacedText += match->str();
+					i++;
+				} else if (std::isdigit(static_cast<unsigned char>(replace[i + 1]))) {
+					std::size_t group = replace[++i] - '0';
+					if (i + 1 < replace.size() && std::isdigit(static_cast<unsigned char>(replace[i + 1]))) group = group * 10 + (replace[++i] - '0');
+					if (group > 0) replacedText += (*match)[matchedReplacement->groupOffset + group].str();
+				} else {
+					replacedText += '$';
+				}
+			}
+			copiedUntil = match->position() + match->length();
+			setReplaced = true;
+		}
+		if (setReplaced) {
+			replacedText.append(text, copiedUntil);
+			text = std::move(replacedText);
+			replaced = true;
+		}
+	}
+	return replaced;
+}
+
+/**
+ * Transforms a value and everything inside it.
+ * 
+ * @return If the value changed.
+ */
+bool ValueTransformer::transformValue(json & value, const std::string & fileExtension, const std::string & pointer) {
+	if (value.is_string()) {
+		std::string text = value.get<std::string>();
+		const bool literalsReplaced = replaceLiterals(text, fileExtension, pointer);
+		const bool regexesReplaced = replaceRegexes(text, fileExtension, pointer);
+		if ((!literalsReplaced && !regexesReplaced) || text == value.get<std::string>()) return false;
+		value = text;
+		return true;
+	} else if (value.is_number()) {
+		bool scaled = false;
+		for (const NumericScaling & scaling : allScalings) {
+			if (!matchesFilter(scaling.filter, fileExtension, pointer)) continue;
+			const double result = value.get<double>() * scaling.factor + scaling.offset;
+			//Integers stay integers.
+			if (scaling.round || value.is_number_integer()) {
+				value = static_cast<std::int64_t>(std::llround(result));
+			} else {
+				value = result;
+			}
+			scaled = true;
+		}
+		return scaled;
+	} else if (value.is_structured()) {
+		bool changed = false;
+		for (json & element : value) changed = transformValue(element, fileExtension, pointer) || changed;
+		return changed;
+	}
+	return false;
+}
+
+/**
+ * Applies every rule to the values of an intermediary file. Safe to call from several threads.
+ * 
+ * @param intermediaryJson The parsed intermediary file, with interned values resolved.
+ * @param fileExtension The file extension of the asset.
+ * @return How many values changed.
+ */
+int ValueTransformer::transformIntermediary(json & intermediaryJson, const std::string & fileExtension) {
+	if (!intermediaryJson.is_object()) return 0;
+	int totalChanged = 0;
+	for (json::iterator iteration = intermediaryJson.begin(); iteration != intermediaryJson.end(); ++iteration) {
+		if (iteration.key() == "patchMakerComment") continue;
+		if (transformValue(iteration.value(), fileExtension, iteration.key())) totalChanged++;
+	}
+	totalTransformedValues += totalChanged;
+	return totalChanged;
+}
+
+bool ValueTransformer::matchesFilter(const TransformFilter & filter, const std::string & fileExtension, const std::string & pointer) {
+	return (filter.fileExtension.empty() || filter.fileExtension == fileExtension) && pointer.find(filter.field) != std::string::npos;
+}
+
+/**
+ * @return If any replacement or scaling is configured.
+ */
+const bool ValueTransformer::hasRules() {
+	return !allLiterals.empty() || !allRegexSets.empty() || !allScalings.empty();
+}
+
+//Getters
+
+const int ValueTransformer::getTransformedValueCount() { return totalTransformedValues; }
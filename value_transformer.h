@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <regex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+struct TransformFilter {
+	//Empty matches every file extension.
+	std::string fileExtension;
+	//Text the intermediary pointer has to contain, empty matches every pointer.
+	std::string field;
+};
+
+struct LiteralReplacement {
+	std::string find;
+	std::string replace;
+	bool wholeWord = false;
+	TransformFilter filter;
+};
+
+struct RegexReplacement {
+	std::string pattern;
+	std::string replace;
+	std::size_t markCount = 0;
+	//First capture group of the pattern in the combined expression.
+	std::size_t groupOffset = 0;
+};
+
+struct RegexReplacementSet {
+	TransformFilter filter;
+	std::string combinedPattern;
+	std::regex combinedRegex;
+	std::vector<RegexReplacement> allReplacements;
+};
+
+struct NumericScaling {
+	double factor = 1;
+	double offset = 0;
+	bool round = false;
+	TransformFilter filter;
+};
+
+class ValueTransformer {
+private:
+	//Aho-Corasick automaton over every literal, with every transition filled in.
+	struct AutomatonNode {
+		std::array<int, 256> next;
+		int fail = 0;
+		//Nearest node along the fail links that ends a literal, -1 if none.
+		int outputLink = -1;
+		int depth = 0;
+		std::vector<std::size_t> allLiteralIds;
+	};
+	std::vector<LiteralReplacement> allLiterals;
+	std::vector<AutomatonNode> allNodes;
+	std::vector<RegexReplacementSet> allRegexSets;
+	std::vector<NumericScaling> allScalings;
+	std::atomic<int> totalTransformedValues = 0;
+
+	bool loadRuleSet(const nlohmann::json & rulesJson, const std::string & configName);
+	void buildAutomaton();
+	bool replaceLiterals(std::string & text, const std::string & fileExtension, const std::string & pointer);
+	bool replaceRegexes(std::string & text, const std::string & fileExtension, const std::string & pointer);
+	bool transformValue(nlohmann::json & value, const std::string & fileExtension, const std::string & pointer);
+	static bool matchesFilter(const TransformFilter & filter, const std::string & fileExtension, const std::string & pointer);
+	static TransformFilter loadFilter(const nlohmann::json & ruleJson);
+public:
+	ValueTransformer();
+	bool loadRules(std::filesystem::path transformsPath);
+	int transformIntermediary(nlohmann::json & intermediaryJson, const std::string & fileExtension);
+	const bool hasRules();
+	//Getters
+	const int getTransformedValueCount();
+};